@@ -1,5 +1,6 @@
+# Links LINK_TARGET, which has to be set before the include, against the libraries of the renderer.
 target_link_libraries(
-     ParallelSplitShadowMapping
+     ${LINK_TARGET}
         glad
         glfw3
         pthread
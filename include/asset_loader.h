@@ -0,0 +1,104 @@
+#pragma once
+
+#include "object.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// Reads OBJ meshes and images on worker threads and streams them to the GPU through a persistently mapped staging
+// ring, so that the GL thread never waits for a file. Objects stay pending until the copies of their data are
+// complete on the GPU. update() has to be called on the GL thread once a frame.
+class AssetLoader final
+{
+public:
+   explicit AssetLoader(int thread_num = 2, GLsizeiptr staging_size = 8 << 20);
+   ~AssetLoader();
+
+   AssetLoader(const AssetLoader&) = delete;
+   AssetLoader(const AssetLoader&&) = delete;
+   AssetLoader& operator=(const AssetLoader&) = delete;
+   AssetLoader& operator=(const AssetLoader&&) = delete;
+
+   // The object has to outlive its loading, and its settings must not change while it is pending.
+   void loadObject(
+      ObjectGL* object,
+      GLenum draw_mode,
+      const std::string& obj_file_path,
+      const std::string& texture_file_path = std::string(),
+      bool is_grayscale = false
+   );
+   void update();
+   [[nodiscard]] bool isIdle() const;
+
+private:
+   struct Request
+   {
+      ObjectGL* Object;
+      GLenum DrawMode;
+      std::string ObjFilePath;
+      std::string TextureFilePath;
+      bool IsGrayscale;
+   };
+
+   struct Result
+   {
+      Request Source;
+      bool Succeeded;
+      ObjectGL::MeshData Mesh;
+      ObjectGL::ImageData Image;
+   };
+
+   enum class Destination { Vertices, Positions, Indices, Texture };
+
+   // A copy from client memory into a buffer or a texture. Buffer copies are split into as many chunks as the free
+   // staging space requires, while an image goes in one piece. The buffer is looked up at copy time, as a geometry
+   // arena may replace its buffers in between.
+   struct Copy
+   {
+      ObjectGL* Object;
+      const uint8_t* Source;
+      GLsizeiptr Size;
+      GLsizeiptr Done;
+      Destination Target;
+      const ObjectGL::ImageData* Image;
+      bool IsLast; // of its object
+   };
+
+   // A contiguous part of the staging ring which the GPU may still be reading.
+   struct Region
+   {
+      GLsizeiptr Begin;
+      GLsizeiptr End;
+      GLsync Fence;
+      std::vector<ObjectGL*> Completed; // objects whose last copy is in this region
+   };
+
+   inline static constexpr GLsizeiptr MinChunkSize = 1 << 16;
+   inline static constexpr GLsizeiptr Alignment = 16;
+
+   bool Stopped;
+   int DecodingNum;
+   GLuint StagingBuffer;
+   uint8_t* StagingData;
+   GLsizeiptr StagingSize;
+   GLsizeiptr Head;
+   GLsizeiptr OpenBegin; // of the region written since the last fence
+   std::vector<ObjectGL*> OpenCompleted;
+   std::vector<std::thread> Workers;
+   mutable std::mutex Mutex;
+   std::condition_variable Condition;
+   std::deque<Request> Requests; // guarded by Mutex
+   std::deque<Result> Results; // guarded by Mutex
+   std::deque<Result> Uploads; // the sources of the queued copies
+   std::deque<Copy> Copies;
+   std::deque<Region> Regions;
+
+   void work();
+   void startUpload(Result&& result);
+   [[nodiscard]] bool allocate(GLsizeiptr min_size, GLsizeiptr max_size, GLsizeiptr& offset, GLsizeiptr& size);
+   void closeRegion();
+   void retireRegions();
+   static void getDestination(const Copy& copy, GLuint& buffer, GLintptr& offset);
+};
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include <freetype/ftstroke.h>
 #include <iostream>
 #include <iomanip>
+#include <array>
 #include <vector>
 #include <string>
 #include <regex>
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "base.h"
+
+// Finds the range of view depths that the visible surfaces of a frame cover, in a compute shader that reduces the
+// depth buffer of the camera. Each frame writes its result to its own part of a persistently mapped buffer, which
+// the CPU reads only once a fence says that the GPU is done with it, so a range arrives a frame or two late and
+// never stalls the frame that asks for it.
+class DepthReducerGL final
+{
+public:
+   explicit DepthReducerGL(int frame_num = 3);
+   ~DepthReducerGL();
+
+   DepthReducerGL(const DepthReducerGL&) = delete;
+   DepthReducerGL(const DepthReducerGL&&) = delete;
+   DepthReducerGL& operator=(const DepthReducerGL&) = delete;
+   DepthReducerGL& operator=(const DepthReducerGL&&) = delete;
+
+   // The depth slices are the view depths that the scene passes map onto consecutive, evenly proportioned parts of
+   // the depth range, which are just the near and far planes when the scene is drawn in one pass. The reduction is
+   // skipped while every part of the buffer still waits for the GPU.
+   void reduce(GLuint program, GLuint depth_texture, const std::vector<float>& depth_slices);
+   // Returns false until a reduction has finished, and keeps the last range of a frame that had no surfaces.
+   [[nodiscard]] bool getDepthRange(float& near, float& far);
+
+private:
+   inline static constexpr GLuint ReductionBlockBinding = 9;
+   inline static constexpr GLuint WorkGroupSize = 16;
+   inline static constexpr GLuint TileSize = 4; // TILE_SIZE in the reduction shader
+
+   // The std430 layout of ReductionBlock.
+   struct ReductionData
+   {
+      GLuint MinDepth;
+      GLuint MaxDepth;
+   };
+
+   struct Frame
+   {
+      GLsync Fence; // nullptr if the part is free
+      std::vector<float> DepthSlices;
+   };
+
+   GLuint Buffer;
+   const uint8_t* Data;
+   GLsizeiptr FrameSize;
+   int FrameIndex; // of the next reduction
+   std::vector<Frame> Frames;
+   bool HasRange;
+   float Near;
+   float Far;
+
+   [[nodiscard]] static float getViewDepth(float window_depth, const std::vector<float>& depth_slices);
+};
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "draw_list.h"
+
+// Culls the instances of objects, or the meshlets of an object with a single instance, against several views at once
+// in a compute shader, and compacts the survivors of each view into indirect commands that are drawn by
+// glMultiDrawElementsIndirectCount. The candidates are uploaded only when the objects change, and a frame sends
+// nothing but the views and one entry per object and view, so the work on the CPU does not grow with the instances.
+class DrawCullerGL final
+{
+public:
+   inline static constexpr int MaxViewNum = 16; // MAX_VIEWS in the culling shader
+
+   DrawCullerGL();
+   ~DrawCullerGL();
+
+   DrawCullerGL(const DrawCullerGL&) = delete;
+   DrawCullerGL(const DrawCullerGL&&) = delete;
+   DrawCullerGL& operator=(const DrawCullerGL&) = delete;
+   DrawCullerGL& operator=(const DrawCullerGL&&) = delete;
+
+   // The object has to be in a geometry arena. Its instances and meshlets are read when it becomes ready, whenever
+   // its geometry version changes, and after invalidate().
+   void addObject(const ObjectGL* object);
+   void invalidate() { CandidatesChanged = true; }
+   // Starts the views of a frame.
+   void clear();
+   // Returns the index of the view, or -1 if there are MaxViewNum views already. The views of a list are submitted
+   // together, and the layer is the one of the shadow map array that a light view draws to.
+   [[nodiscard]] int addView(const glm::mat4& view_projection, bool cull_backfaces, int list, int layer = 0);
+   // The texture is bound to unit 0 unless it is 0.
+   void addDraw(int view, GLuint program, GLuint texture, const ObjectGL* object, int lod, bool position_only);
+   // Builds the draw lists of every view. Returns false if the ring has no room for the views.
+   [[nodiscard]] bool cull(GLuint program, UniformRingGL* ring);
+   void submit(int list) const;
+   // Reads the number of commands of every list and view back from the GPU, so it waits for the culling of the last
+   // frame.
+   void printStatistics() const;
+   [[nodiscard]] size_t getCandidateNum() const { return Candidates.size(); }
+
+private:
+   inline static constexpr GLuint ViewBlockBinding = 3;
+   inline static constexpr GLuint CandidateBlockBinding = 4;
+   inline static constexpr GLuint ObjectViewBlockBinding = 5;
+   inline static constexpr GLuint CommandBlockBinding = 6;
+   inline static constexpr GLuint CulledDrawBlockBinding = 7;
+   inline static constexpr GLuint CountBlockBinding = 8;
+   inline static constexpr GLuint WorkGroupSize = 64;
+
+   // The std140 layout of ViewBlock.
+   struct ViewData
+   {
+      std::array<glm::vec4, 6> Planes;
+      glm::vec4 Eye; // w is 0 if it is the view direction of an orthographic projection
+      glm::uvec4 Flags;
+   };
+   struct ViewBlockData
+   {
+      std::array<ViewData, MaxViewNum> Views;
+      GLuint ViewNum;
+      GLuint CandidateNum;
+   };
+
+   // The std430 layouts of the entries of CandidateBlock, ObjectViewBlock and DrawBlock.
+   struct Candidate
+   {
+      glm::vec4 BoundsMin;
+      glm::vec4 BoundsMax;
+      glm::vec4 Sphere;
+      glm::vec4 Cone;
+      GLuint ObjectIndex;
+      GLuint InstanceIndex;
+      GLuint IndexNum; // 0 for a whole instance
+      GLuint FirstIndex;
+   };
+   enum ObjectViewMode : GLuint { NotDrawn = 0, DrawInstances, DrawMeshlets };
+   struct ObjectView
+   {
+      GLuint IndexNum;
+      GLuint FirstIndex;
+      GLint BaseVertex;
+      GLuint BaseInstance;
+      GLuint Batch;
+      GLuint CommandOffset; // of the batch
+      GLuint Mode;
+      GLuint Padding;
+      glm::vec4 PositionScale;
+      glm::vec4 PositionBias; // w is the layer
+   };
+   struct DrawData
+   {
+      glm::vec4 PositionScale;
+      glm::vec4 PositionBias;
+   };
+
+   // The commands of a batch start at CommandOffset, and at most Capacity of them survive.
+   struct Batch
+   {
+      int List;
+      GLuint Program;
+      GLuint Texture;
+      GLuint VAO;
+      GLenum DrawMode;
+      GLenum IndexType;
+      GLuint CommandOffset;
+      GLuint Capacity;
+   };
+
+   struct ViewTarget
+   {
+      int List;
+      int Layer;
+   };
+
+   struct Draw
+   {
+      int View;
+      size_t ObjectIndex;
+      ObjectView Entry;
+   };
+
+   struct Buffer
+   {
+      GLuint Name;
+      GLsizeiptr Size;
+   };
+
+   bool CandidatesChanged;
+   GLuint CommandAlignment; // in commands, so that the DrawBlock range of a batch can be bound
+   std::vector<const ObjectGL*> Objects;
+   std::vector<bool> ReadyObjects; // when the candidates were built
+   std::vector<uint32_t> ObjectVersions; // when the candidates were built
+   std::vector<GLuint> InstanceCandidateNums;
+   std::vector<GLuint> MeshletCandidateNums;
+   std::vector<Candidate> Candidates;
+   std::vector<ViewData> Views;
+   std::vector<ViewTarget> ViewTargets;
+   std::vector<Draw> Draws;
+   std::vector<Batch> Batches;
+   std::vector<ObjectView> ObjectViews;
+   Buffer CandidateBuffer;
+   Buffer CommandBuffer;
+   Buffer DrawBuffer;
+   Buffer CountBuffer;
+
+   static void reserve(Buffer& buffer, GLsizeiptr size);
+   static void setWorldBounds(Candidate& candidate, const ObjectGL::Bounds& bounds);
+   void updateCandidates();
+};
\ No newline at end of file
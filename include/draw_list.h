@@ -0,0 +1,65 @@
+#pragma once
+
+#include "object.h"
+#include "uniform_ring.h"
+
+// The draws of a pass, grouped into batches of what a single glMultiDrawElementsIndirect has to share: the program,
+// the VAO, the draw mode, the index type and the texture. Every command gets an entry in DrawBlock, which the shaders
+// index with gl_DrawID. The commands and the entries go through the uniform ring, so a list is refilled every pass.
+class DrawListGL final
+{
+public:
+   inline static constexpr GLuint DrawBlockBinding = 3;
+
+   DrawListGL() = default;
+   ~DrawListGL() = default;
+
+   DrawListGL(const DrawListGL&) = delete;
+   DrawListGL(const DrawListGL&&) = delete;
+   DrawListGL& operator=(const DrawListGL&) = delete;
+   DrawListGL& operator=(const DrawListGL&&) = delete;
+
+   // Keeps the memory of the batches for the next pass.
+   void clear();
+   // The object has to be in a geometry arena, and its instances outside the frustum of world_to_clip are left out.
+   // The texture is bound to unit 0 unless it is 0, and the layer is the one of the shadow map array that a light
+   // view draws to.
+   void addObject(
+      GLuint program,
+      GLuint texture,
+      ObjectGL* object,
+      const glm::mat4& world_to_clip,
+      bool cull_backfaces,
+      int lod,
+      bool position_only,
+      int layer = 0
+   );
+   // Returns false if the ring has no room for a batch, whose draws are then skipped.
+   [[nodiscard]] bool submit(UniformRingGL* ring) const;
+   [[nodiscard]] size_t getBatchNum() const;
+   [[nodiscard]] size_t getCommandNum() const;
+   // The instances that the draws to the layer keep, counting a single instance drawn as meshlets once.
+   [[nodiscard]] size_t getInstanceNum(int layer) const;
+
+private:
+   // The std430 layout of an entry of DrawBlock.
+   struct DrawData
+   {
+      glm::vec4 PositionScale; // w is 1 for octahedral-encoded normals
+      glm::vec4 PositionBias; // w is the layer
+   };
+
+   struct Batch
+   {
+      GLuint Program;
+      GLuint Texture;
+      GLuint VAO;
+      GLenum DrawMode;
+      GLenum IndexType;
+      std::vector<DrawElementsIndirectCommand> Commands;
+      std::vector<DrawData> Draws;
+   };
+
+   std::vector<Batch> Batches; // the empty ones are left from earlier passes
+   std::vector<size_t> LayerInstanceNums;
+};
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "base.h"
+
+// The layout of a command in GL_DRAW_INDIRECT_BUFFER for glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand
+{
+   GLuint Count;
+   GLuint InstanceCount;
+   GLuint FirstIndex;
+   GLint BaseVertex;
+   GLuint BaseInstance;
+};
+
+// First-fit suballocation of a range of bytes. Freed blocks merge with their free neighbors, so the free list only
+// holds the holes between live allocations and the tail.
+class FreeListAllocator final
+{
+public:
+   explicit FreeListAllocator(GLsizeiptr capacity);
+
+   // The alignment does not have to be a power of two, as vertex ranges are aligned to their stride.
+   [[nodiscard]] bool allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+   void release(GLintptr offset, GLsizeiptr size);
+   void grow(GLsizeiptr capacity);
+   [[nodiscard]] GLsizeiptr getCapacity() const { return Capacity; }
+   [[nodiscard]] GLsizeiptr getUsedSize() const { return UsedSize; }
+   [[nodiscard]] GLsizeiptr getLargestFreeBlock() const;
+   [[nodiscard]] size_t getFreeBlockNum() const { return FreeBlocks.size(); }
+
+private:
+   GLsizeiptr Capacity;
+   GLsizeiptr UsedSize;
+   std::map<GLintptr, GLsizeiptr> FreeBlocks; // <offset, size>
+};
+
+// Shared buffers that the vertices, indices and instances of many objects are suballocated from, so that the objects
+// with the same vertex layout share one VAO and can be drawn by a single multi-draw call. A buffer that runs out of
+// space is replaced by one twice as large, which keeps the offsets of the existing ranges.
+class GeometryArenaGL final
+{
+public:
+   enum BufferType { VertexBuffer = 0, IndexBuffer, InstanceBuffer, BufferTypeNum };
+
+   struct Range
+   {
+      GLintptr Offset;
+      GLsizeiptr Size;
+
+      Range() : Offset( 0 ), Size( 0 ) {}
+   };
+
+   GeometryArenaGL(
+      GLsizeiptr vertex_buffer_size = 32 << 20,
+      GLsizeiptr index_buffer_size = 16 << 20,
+      GLsizeiptr instance_buffer_size = 1 << 20
+   );
+   ~GeometryArenaGL();
+
+   GeometryArenaGL(const GeometryArenaGL&) = delete;
+   GeometryArenaGL(const GeometryArenaGL&&) = delete;
+   GeometryArenaGL& operator=(const GeometryArenaGL&) = delete;
+   GeometryArenaGL& operator=(const GeometryArenaGL&&) = delete;
+
+   // Returns false, leaving the range empty, if the buffer could not make room for size bytes even after growing.
+   [[nodiscard]] bool allocate(BufferType type, GLsizeiptr size, GLsizeiptr alignment, Range& range);
+   void release(BufferType type, Range& range);
+   // The VAO of a vertex layout reads the vertex buffer at binding 0 with the stride, the instance buffer at
+   // binding 1, and the index buffer. The caller sets the attribute formats, which is harmless to repeat.
+   [[nodiscard]] GLuint getVertexArray(uint32_t layout_key, GLsizei stride, GLsizei instance_stride);
+   [[nodiscard]] GLuint getBuffer(BufferType type) const { return Buffers[type]; }
+   void printStatistics() const;
+
+private:
+   struct VertexArray
+   {
+      GLuint Name;
+      GLsizei Stride;
+      GLsizei InstanceStride;
+   };
+
+   std::array<GLuint, BufferTypeNum> Buffers;
+   std::array<FreeListAllocator, BufferTypeNum> Allocators;
+   std::array<int, BufferTypeNum> GrowthNum;
+   std::map<uint32_t, VertexArray> VertexArrays;
+
+   void createBuffer(BufferType type, GLsizeiptr size);
+   void grow(BufferType type, GLsizeiptr min_size);
+   void bindBuffers(const VertexArray& vertex_array) const;
+};
\ No newline at end of file
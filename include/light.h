@@ -5,8 +5,16 @@
 class LightGL final
 {
 public:
+   inline static constexpr int MaxLightNum = 32; // MAX_LIGHTS of the scene shader
+   inline static constexpr GLuint LightBlockBinding = 0;
+
    LightGL();
-   ~LightGL() = default;
+   ~LightGL();
+
+   LightGL(const LightGL&) = delete;
+   LightGL(const LightGL&&) = delete;
+   LightGL& operator=(const LightGL&) = delete;
+   LightGL& operator=(const LightGL&&) = delete;
 
    [[nodiscard]] bool isLightOn() const;
    void toggleLightSwitch();
@@ -22,12 +30,42 @@ public:
    );
    void activateLight(const int& light_index);
    void deactivateLight(const int& light_index);
-   void transferUniformsToShader(const ShaderGL* shader);
+   // Writes the lights in eye space to the uniform buffer bound to LightBlockBinding, but only if they or the view
+   // have changed since the last call.
+   void updateLightBuffer(const glm::mat4& view_matrix);
    [[nodiscard]] int getTotalLightNum() const { return TotalLightNum; }
    [[nodiscard]] glm::vec4 getLightPosition(int light_index) { return Positions[light_index]; }
+   [[nodiscard]] bool isActivated(int light_index) const { return IsActivated[light_index]; }
+   [[nodiscard]] float getSpotlightCutoffAngle(int light_index) const { return SpotlightCutoffAngles[light_index]; }
 
 private:
+   // The std140 layout of LightBlock in the scene shader.
+   struct LightData
+   {
+      glm::vec4 Position;
+      glm::vec4 AmbientColor;
+      glm::vec4 DiffuseColor;
+      glm::vec4 SpecularColor;
+      glm::vec4 SpotlightDirection; // normalized, w is unused
+      float SpotlightCutoffAngle;
+      float SpotlightFeather;
+      float FallOffRadius;
+      float Padding;
+   };
+   static_assert( sizeof( LightData ) == 96, "LightData must match the std140 layout of LightInfo." );
+
+   struct LightBlock
+   {
+      glm::vec4 GlobalAmbient;
+      int32_t LightNum;
+      int32_t Padding[3];
+      std::array<LightData, MaxLightNum> Lights;
+   };
+
    bool TurnLightOn;
+   bool LightBufferDirty;
+   GLuint LightBuffer;
+   glm::mat4 LightBufferViewMatrix;
    int TotalLightNum;
    glm::vec4 GlobalAmbientColor;
    std::vector<bool> IsActivated;
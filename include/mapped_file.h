@@ -0,0 +1,31 @@
+#pragma once
+
+#include "base.h"
+
+class MappedFile final
+{
+public:
+   explicit MappedFile(const std::string& file_path);
+   ~MappedFile();
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile(const MappedFile&&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&&) = delete;
+
+   [[nodiscard]] bool isOpen() const { return Opened; }
+   [[nodiscard]] const char* begin() const { return Data; }
+   [[nodiscard]] const char* end() const { return Data + Size; }
+   [[nodiscard]] size_t size() const { return Size; }
+
+private:
+   bool Opened;
+   const char* Data;
+   size_t Size;
+#ifdef _WIN32
+   void* FileHandle;
+   void* MappingHandle;
+#else
+   int FileDescriptor;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "base.h"
+
+// Surface parameters in the std140 layout of MaterialBlock in the scene shader.
+struct Material
+{
+   glm::vec4 EmissionColor;
+   glm::vec4 AmbientColor;
+   glm::vec4 DiffuseColor;
+   glm::vec4 SpecularColor;
+   float SpecularExponent;
+   float Padding[3];
+
+   explicit Material(const glm::vec4& diffuse_color = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f)) :
+      EmissionColor( 0.0f, 0.0f, 0.0f, 1.0f ), AmbientColor( 0.2f, 0.2f, 0.2f, 1.0f ), DiffuseColor( diffuse_color ),
+      SpecularColor( 0.0f, 0.0f, 0.0f, 1.0f ), SpecularExponent( 0.0f ), Padding{} {}
+};
+static_assert( sizeof( Material ) == 80, "Material must match the std140 layout of MaterialBlock." );
+
+// Materials written once into a uniform buffer, which stays bound as a whole so that every instance can pick its
+// material by index. A material cannot be changed after it is added.
+class MaterialLibraryGL final
+{
+public:
+   inline static constexpr GLuint MaterialBlockBinding = 2;
+   inline static constexpr int MaxMaterialNum = 64; // MAX_MATERIALS in the scene shader
+
+   MaterialLibraryGL();
+   ~MaterialLibraryGL();
+
+   MaterialLibraryGL(const MaterialLibraryGL&) = delete;
+   MaterialLibraryGL(const MaterialLibraryGL&&) = delete;
+   MaterialLibraryGL& operator=(const MaterialLibraryGL&) = delete;
+   MaterialLibraryGL& operator=(const MaterialLibraryGL&&) = delete;
+
+   // Returns the index of the material, or -1 if the library is full.
+   [[nodiscard]] int addMaterial(const Material& material);
+
+private:
+   GLuint Buffer;
+   int MaterialNum;
+};
\ No newline at end of file
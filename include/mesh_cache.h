@@ -0,0 +1,124 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "vertex_format.h"
+
+// Binary mesh file holding the final interleaved vertex stream, so that a mesh can be handed to the GPU
+// straight from a memory-mapped file. Layout: Header | vertex data | index data | levels of detail, each block
+// 16-byte aligned. The index data holds the index list of every level of detail one after another.
+class MeshCache final
+{
+public:
+   enum LayoutFlag : uint32_t { HasNormals = 1u << 0u, HasTextures = 1u << 1u };
+   enum ProcessingFlag : uint32_t { Optimized = 1u << 0u, Simplified = 1u << 1u };
+
+   // A simplified index list over the same vertices. Level 0 is the original mesh.
+   struct LevelOfDetail
+   {
+      uint64_t IndexOffset; // in indices from the start of the index data
+      uint64_t IndexNum;
+      float Error; // the largest distance of a vertex of level 0 to this level, in the units of the positions
+      uint32_t Reserved;
+   };
+
+   struct Header
+   {
+      char Magic[4];
+      uint32_t Version;
+      uint32_t LayoutFlags;
+      uint32_t VertexStride; // in bytes
+      uint64_t VertexNum;
+      uint64_t VertexDataOffset;
+      uint64_t IndexNum;
+      uint64_t IndexDataOffset;
+      uint32_t IndexSize; // 0 if the mesh is not indexed, otherwise 2 or 4 bytes
+      uint32_t ProcessingFlags;
+      uint32_t PackedVertexFormat; // VertexFormat::pack() of the vertex data
+      glm::vec3 BoundsMin; // bounds of the original positions, which UNorm16 positions are relative to
+      glm::vec3 BoundsMax;
+      uint32_t LodNum; // 0 if the levels of detail were not generated
+      uint64_t LodDataOffset;
+   };
+
+   inline static constexpr char Magic[4] = { 'P', 'S', 'M', 'C' };
+   inline static constexpr uint32_t Version = 5;
+   inline static constexpr int MaxLodNum = 8;
+   inline static constexpr size_t MinLodTriangleNum = 64;
+
+   explicit MeshCache(const std::string& file_path);
+   ~MeshCache() = default;
+
+   [[nodiscard]] bool isValid() const { return Valid; }
+   [[nodiscard]] const Header& getHeader() const { return *reinterpret_cast<const Header*>(File->begin()); }
+   [[nodiscard]] const void* getVertexData() const { return File->begin() + getHeader().VertexDataOffset; }
+   [[nodiscard]] size_t getVertexDataSize() const { return getHeader().VertexNum * getHeader().VertexStride; }
+   [[nodiscard]] const void* getIndexData() const { return File->begin() + getHeader().IndexDataOffset; }
+   [[nodiscard]] size_t getIndexDataSize() const { return getHeader().IndexNum * getHeader().IndexSize; }
+   [[nodiscard]] const LevelOfDetail* getLods() const
+   {
+      return reinterpret_cast<const LevelOfDetail*>(File->begin() + getHeader().LodDataOffset);
+   }
+
+   [[nodiscard]] static uint32_t getVertexStride(uint32_t layout_flags)
+   {
+      uint32_t n = 3;
+      if (layout_flags & HasNormals) n += 3;
+      if (layout_flags & HasTextures) n += 2;
+      return n * static_cast<uint32_t>(sizeof( float ));
+   }
+   [[nodiscard]] static uint32_t getIndexSize(uint64_t vertex_num)
+   {
+      return vertex_num <= uint64_t(std::numeric_limits<uint16_t>::max()) + 1 ? sizeof( uint16_t ) : sizeof( uint32_t );
+   }
+   [[nodiscard]] static std::string getCachePath(const std::string& source_path) { return source_path + ".mesh"; }
+   [[nodiscard]] static bool isUpToDate(const std::string& cache_path, const std::string& source_path);
+   static void interleave(
+      std::vector<float>& data,
+      uint32_t& layout_flags,
+      const std::vector<glm::vec3>& vertices,
+      const std::vector<glm::vec3>& normals,
+      const std::vector<glm::vec2>& textures
+   );
+   static void getBounds(glm::vec3& bounds_min, glm::vec3& bounds_max, const float* data, size_t vertex_num, size_t stride);
+   // Writes header, whose magic, version and data offsets are filled in here, followed by the data blocks.
+   // lods holds header.LodNum entries.
+   static bool write(
+      const std::string& cache_path,
+      Header header,
+      const void* vertex_data,
+      const void* index_data = nullptr,
+      const LevelOfDetail* lods = nullptr
+   );
+   // Reads an OBJ file into a welded, interleaved vertex stream and the triangle indices into it.
+   // With optimize, triangles and vertices are also reordered for the post-transform cache, overdraw and fetch.
+   // With simplify, indices continue with a chain of levels of detail, each with about half the triangles of the
+   // previous one; lods describes them, and is empty otherwise.
+   static bool build(
+      std::vector<float>& vertex_data,
+      std::vector<uint32_t>& indices,
+      std::vector<LevelOfDetail>& lods,
+      uint32_t& layout_flags,
+      const std::string& obj_file_path,
+      bool optimize,
+      bool simplify
+   );
+   static bool convert(
+      const std::string& obj_file_path,
+      const std::string& cache_path,
+      bool optimize = true,
+      bool simplify = true,
+      const VertexFormat& format = VertexFormat()
+   );
+
+private:
+   bool Valid;
+   std::unique_ptr<MappedFile> File;
+
+   [[nodiscard]] static uint64_t alignOffset(uint64_t offset) { return (offset + 15u) & ~uint64_t(15u); }
+   static void buildLods(
+      std::vector<uint32_t>& indices,
+      std::vector<LevelOfDetail>& lods,
+      const std::vector<float>& vertex_data,
+      size_t floats_per_vertex
+   );
+};
\ No newline at end of file
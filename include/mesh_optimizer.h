@@ -0,0 +1,117 @@
+#pragma once
+
+#include "base.h"
+
+// CPU-side mesh processing applied before a mesh is uploaded. Nothing here touches OpenGL.
+// Indexed meshes are triangle lists and positions are the first three floats of every vertex.
+class MeshOptimizer final
+{
+public:
+   struct VertexCacheStatistics
+   {
+      size_t TransformedVertexNum;
+      float ACMR; // average cache miss ratio: transformed vertices per triangle
+      float ATVR; // average transformed vertex ratio: transformed vertices per unique vertex
+
+      VertexCacheStatistics() : TransformedVertexNum( 0 ), ACMR( 0.0f ), ATVR( 0.0f ) {}
+   };
+
+   inline static constexpr int VertexCacheSize = 32;
+
+   MeshOptimizer() = delete;
+
+   // Merges bitwise-identical vertices of an interleaved triangle soup and returns the index of each
+   // original vertex into the welded vertex array.
+   static void weld(
+      std::vector<float>& welded_vertices,
+      std::vector<uint32_t>& indices,
+      const std::vector<float>& vertices,
+      size_t floats_per_vertex
+   );
+
+   // Reorders triangles for post-transform cache locality using Tom Forsyth's linear-speed algorithm.
+   static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_num);
+
+   // Reorders clusters of the cache-optimized triangle order so that outward-facing clusters are drawn first,
+   // while keeping the ACMR within threshold times the original one.
+   static void optimizeOverdraw(
+      std::vector<uint32_t>& indices,
+      const std::vector<float>& vertices,
+      size_t floats_per_vertex,
+      float threshold = 1.05f
+   );
+
+   // Reorders vertices in the order they are first referenced and remaps the indices accordingly.
+   static void optimizeVertexFetch(std::vector<float>& vertices, std::vector<uint32_t>& indices, size_t floats_per_vertex);
+
+   // Collapses edges onto one of their endpoints in the order of the least quadric error until at most
+   // target_index_num indices remain, so the result still refers to the given vertices. Vertices on borders and
+   // attribute seams never move. destinations holds the vertex of indices that each vertex has collapsed onto, or
+   // is filled with the identity if it is empty, and follows the new collapses. Returns the largest distance from
+   // a vertex to the simplified triangles around its destination, which bounds its distance to the simplified
+   // surface, in the units of the positions.
+   static float simplify(
+      std::vector<uint32_t>& simplified,
+      std::vector<uint32_t>& destinations,
+      const std::vector<uint32_t>& indices,
+      const std::vector<float>& vertices,
+      size_t floats_per_vertex,
+      size_t target_index_num
+   );
+
+   // Simulates a FIFO post-transform cache, which is how most GPUs behave for indexed triangle lists.
+   [[nodiscard]] static VertexCacheStatistics analyzeVertexCache(
+      const std::vector<uint32_t>& indices,
+      size_t vertex_num,
+      int cache_size = VertexCacheSize
+   );
+
+private:
+   // Sum of squared distances to a set of planes, weighted by the area of the triangle each plane comes from.
+   struct Quadric
+   {
+      double A00, A11, A22, A01, A02, A12, B0, B1, B2, C, Weight;
+
+      Quadric() : A00( 0.0 ), A11( 0.0 ), A22( 0.0 ), A01( 0.0 ), A02( 0.0 ), A12( 0.0 ), B0( 0.0 ), B1( 0.0 ),
+      B2( 0.0 ), C( 0.0 ), Weight( 0.0 ) {}
+
+      void addPlane(const glm::dvec3& normal, double distance, double weight);
+      void add(const Quadric& other);
+      // The weighted mean squared distance of point to the planes.
+      [[nodiscard]] double getError(const glm::dvec3& point) const;
+   };
+
+   [[nodiscard]] static uint64_t hashVertex(const float* vertex, size_t floats_per_vertex);
+   [[nodiscard]] static float getForsythVertexScore(int cache_position, uint32_t remaining_triangle_num);
+   static void getHardClusterBoundaries(
+      std::vector<uint32_t>& boundaries,
+      const std::vector<uint32_t>& indices,
+      size_t vertex_num
+   );
+   static void getSoftClusterBoundaries(
+      std::vector<uint32_t>& boundaries,
+      const std::vector<uint32_t>& indices,
+      const std::vector<uint32_t>& hard_boundaries,
+      size_t vertex_num,
+      float threshold
+   );
+   static void getLockedVertices(
+      std::vector<bool>& locked,
+      const std::vector<uint32_t>& indices,
+      const std::vector<glm::vec3>& positions
+   );
+   [[nodiscard]] static float getDistanceToTriangle(
+      const glm::vec3& point,
+      const glm::vec3& a,
+      const glm::vec3& b,
+      const glm::vec3& c
+   );
+   [[nodiscard]] static bool flipsTriangle(
+      const std::vector<glm::vec3>& positions,
+      uint32_t a,
+      uint32_t b,
+      uint32_t c,
+      uint32_t moved,
+      const glm::vec3& destination
+   );
+};
\ No newline at end of file
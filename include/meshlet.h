@@ -0,0 +1,83 @@
+#pragma once
+
+#include "base.h"
+
+// A run of at most MaxVertexNum vertices and MaxTriangleNum triangles that is contiguous in the index buffer, so
+// that a surviving meshlet is drawn as a plain index range. The bounds are in object space.
+struct Meshlet
+{
+   uint32_t IndexOffset;
+   uint32_t IndexNum;
+   glm::vec3 BoundsMin;
+   glm::vec3 BoundsMax;
+   glm::vec3 Center;
+   float Radius;
+   glm::vec3 ConeAxis; // the average direction of the triangle normals
+   float ConeCutoff; // sine of the normal cone half angle; 1 when the meshlet can face every direction
+
+   Meshlet() : IndexOffset( 0 ), IndexNum( 0 ), BoundsMin( 0.0f ), BoundsMax( 0.0f ), Center( 0.0f ), Radius( 0.0f ),
+   ConeAxis( 0.0f, 0.0f, 1.0f ), ConeCutoff( 1.0f ) {}
+};
+
+class MeshletBuilder final
+{
+public:
+   inline static constexpr size_t MaxVertexNum = 64;
+   inline static constexpr size_t MaxTriangleNum = 124;
+
+   MeshletBuilder() = delete;
+
+   // Cuts the triangle list into meshlets in its current order, which keeps the post-transform cache order and
+   // is spatially coherent after MeshOptimizer::optimizeVertexCache.
+   static void build(
+      std::vector<Meshlet>& meshlets,
+      const std::vector<uint32_t>& indices,
+      const std::vector<glm::vec3>& positions,
+      size_t max_vertex_num = MaxVertexNum,
+      size_t max_triangle_num = MaxTriangleNum
+   );
+
+private:
+   static void setBounds(Meshlet& meshlet, const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions);
+};
+
+// Culls meshlets against the frustum and, optionally, the view direction of one object-to-clip transform.
+// It needs nothing but the matrix, so it runs without an OpenGL context.
+class MeshletCuller final
+{
+public:
+   struct IndexRange
+   {
+      uint32_t Offset, Count;
+
+      IndexRange(uint32_t offset, uint32_t count) : Offset( offset ), Count( count ) {}
+   };
+
+   explicit MeshletCuller(const glm::mat4& object_to_clip);
+   ~MeshletCuller() = default;
+
+   [[nodiscard]] bool isOrthographic() const { return Orthographic; }
+   [[nodiscard]] const glm::vec3& getEye() const { return Eye; }
+   [[nodiscard]] const std::array<glm::vec4, 6>& getPlanes() const { return Planes; }
+   [[nodiscard]] bool isInsideFrustum(const glm::vec3& bounds_min, const glm::vec3& bounds_max) const;
+   [[nodiscard]] bool isInsideFrustum(const Meshlet& meshlet) const
+   {
+      return isInsideFrustum( meshlet.BoundsMin, meshlet.BoundsMax );
+   }
+   [[nodiscard]] bool isBackFacing(const Meshlet& meshlet) const;
+   [[nodiscard]] bool isVisible(const Meshlet& meshlet, bool cull_backfaces) const
+   {
+      return isInsideFrustum( meshlet ) && !(cull_backfaces && isBackFacing( meshlet ));
+   }
+   // Collects the index ranges of the visible meshlets, merging neighbors. Returns the number of visible meshlets.
+   size_t getVisibleRanges(
+      std::vector<IndexRange>& ranges,
+      const std::vector<Meshlet>& meshlets,
+      bool cull_backfaces
+   ) const;
+
+private:
+   bool Orthographic;
+   glm::vec3 Eye; // the camera position in object space, or the view direction for an orthographic projection
+   std::array<glm::vec4, 6> Planes; // normalized, pointing inward
+};
\ No newline at end of file
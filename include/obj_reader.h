@@ -0,0 +1,112 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <thread>
+#include <atomic>
+
+class ObjReader final
+{
+public:
+   // Zero-based attribute indices of a face corner; -1 when the corner does not reference the attribute.
+   struct Corner
+   {
+      int Vertex, Texture, Normal;
+
+      Corner() : Vertex( -1 ), Texture( -1 ), Normal( -1 ) {}
+      Corner(int vertex, int texture, int normal) : Vertex( vertex ), Texture( texture ), Normal( normal ) {}
+   };
+
+   explicit ObjReader(int thread_num = 0);
+   ~ObjReader() = default;
+
+   [[nodiscard]] bool read(const std::string& file_path);
+   [[nodiscard]] bool read(const char* begin, const char* end);
+   [[nodiscard]] bool hasNormals() const { return FoundNormals; }
+   [[nodiscard]] bool hasTextures() const { return FoundTextures; }
+   [[nodiscard]] int getThreadNum() const { return ThreadNum; }
+   [[nodiscard]] const std::vector<glm::vec3>& getPositions() const { return Positions; }
+   [[nodiscard]] const std::vector<glm::vec3>& getNormals() const { return Normals; }
+   [[nodiscard]] const std::vector<glm::vec2>& getTextures() const { return Textures; }
+   [[nodiscard]] const std::vector<Corner>& getCorners() const { return Corners; }
+   void setThreadNum(int thread_num);
+   void getTriangles(
+      std::vector<glm::vec3>& vertices,
+      std::vector<glm::vec3>& normals,
+      std::vector<glm::vec2>& textures
+   ) const;
+
+   // Runs func(task_index) for every task, spreading the tasks over at most thread_num threads.
+   template<typename Func>
+   static void runInParallel(int task_num, int thread_num, Func&& func)
+   {
+      const int worker_num = std::min( task_num, thread_num ) - 1;
+      if (worker_num <= 0) {
+         for (int i = 0; i < task_num; ++i) func( i );
+         return;
+      }
+
+      std::atomic<int> next_task( 0 );
+      const auto work = [&]()
+      {
+         for (int i = next_task++; i < task_num; i = next_task++) func( i );
+      };
+      std::vector<std::thread> workers;
+      workers.reserve( worker_num );
+      for (int i = 0; i < worker_num; ++i) workers.emplace_back( work );
+      work();
+      for (auto& worker : workers) worker.join();
+   }
+
+private:
+   enum RelativeFlag : uint8_t { RelativeVertex = 1, RelativeTexture = 2, RelativeNormal = 4 };
+
+   // A block of whole lines parsed independently of the others. Negative indices can refer to elements of
+   // preceding chunks, so they are kept relative to the chunk and rebased once all chunk sizes are known.
+   struct Chunk
+   {
+      const char* Begin;
+      const char* End;
+      const char* ErrorPosition;
+      std::vector<glm::vec3> Positions;
+      std::vector<glm::vec3> Normals;
+      std::vector<glm::vec2> Textures;
+      std::vector<Corner> Corners;
+      std::vector<std::pair<size_t, uint8_t>> RelativeCorners; // <corner index, RelativeFlag bits>
+
+      Chunk(const char* begin, const char* end) : Begin( begin ), End( end ), ErrorPosition( nullptr ) {}
+   };
+
+   inline static constexpr size_t MinChunkSize = 1u << 20u;
+
+   bool FoundNormals;
+   bool FoundTextures;
+   int ThreadNum;
+   std::vector<glm::vec3> Positions;
+   std::vector<glm::vec3> Normals;
+   std::vector<glm::vec2> Textures;
+   std::vector<Corner> Corners; // three corners per triangle; polygons are triangulated as fans
+
+   void clear();
+   void splitIntoChunks(std::vector<Chunk>& chunks, const char* begin, const char* end) const;
+   [[nodiscard]] bool mergeChunks(std::vector<Chunk>& chunks);
+   static void parseChunk(Chunk& chunk);
+   [[nodiscard]] static bool parseFace(
+      const char*& ptr,
+      const char* end,
+      Chunk& chunk,
+      std::vector<Corner>& polygon,
+      std::vector<uint8_t>& relative_flags
+   );
+   [[nodiscard]] static bool parseIndex(const char*& ptr, const char* end, int count, int& index, bool& relative);
+   [[nodiscard]] static bool parseFloat(const char*& ptr, const char* end, float& value);
+   static void skipSpaces(const char*& ptr, const char* end)
+   {
+      while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r')) ++ptr;
+   }
+   static void skipLine(const char*& ptr, const char* end)
+   {
+      while (ptr < end && *ptr != '\n') ++ptr;
+      if (ptr < end) ++ptr;
+   }
+};
\ No newline at end of file
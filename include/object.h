@@ -1,20 +1,101 @@
 #pragma once
 
 #include "shader.h"
+#include "mesh_cache.h"
+#include "vertex_layout.h"
+#include "meshlet.h"
+#include "geometry_arena.h"
 
 class ObjectGL final
 {
 public:
-   enum LayoutLocation { VertexLoc = 0, NormalLoc, TextureLoc };
+   enum LayoutLocation { VertexLoc = 0, NormalLoc, TextureLoc, InstanceToWorldLoc, InstanceMaterialLoc = InstanceToWorldLoc + 4 };
+
+   using PositionAttribute = VertexAttribute<VertexLoc, glm::vec3, 3, GL_FLOAT>;
+   using NormalAttribute = VertexAttribute<NormalLoc, glm::vec3, 3, GL_FLOAT>;
+   using TextureAttribute = VertexAttribute<TextureLoc, glm::vec2, 2, GL_FLOAT>;
+   using PositionLayout = VertexLayout<PositionAttribute>;
+   using PositionNormalLayout = VertexLayout<PositionAttribute, NormalAttribute>;
+   using PositionTextureLayout = VertexLayout<PositionAttribute, TextureAttribute>;
+   using PositionNormalTextureLayout = VertexLayout<PositionAttribute, NormalAttribute, TextureAttribute>;
+
+   // The per-instance attributes, which take the binding after the vertex buffer. The matrix spans four locations.
+   struct Instance
+   {
+      glm::mat4 ToWorld;
+      int MaterialIndex;
+
+      Instance() : ToWorld( 1.0f ), MaterialIndex( 0 ) {}
+      Instance(const glm::mat4& to_world, int material_index) : ToWorld( to_world ), MaterialIndex( material_index ) {}
+   };
+
+   // An axis-aligned box in world space.
+   struct Bounds
+   {
+      glm::vec3 Min;
+      glm::vec3 Max;
+   };
+
+   // Objects set by the GL thread are ready at once; AssetLoader keeps its objects pending until they are uploaded.
+   enum class LoadState { Ready, Pending, Failed };
+
+   // The CPU side of an OBJ mesh, which prepareMeshData can fill on any thread. VertexData and IndexData point into
+   // the vectors below or into the mapped cache, so they stay valid when the mesh data is moved.
+   struct MeshData
+   {
+      bool NormalsExist;
+      bool TexturesExist;
+      int VertexStride;
+      GLsizei VertexNum;
+      GLenum IndexType;
+      VertexFormat Format;
+      glm::vec3 BoundsMin;
+      glm::vec3 BoundsMax;
+      const void* VertexData;
+      GLsizeiptr VertexDataSize;
+      const void* IndexData;
+      GLsizeiptr IndexDataSize; // of every level of detail
+      std::vector<GLfloat> FloatVertices;
+      std::vector<uint8_t> EncodedVertices;
+      std::vector<uint32_t> Indices;
+      std::vector<GLushort> ShortIndices;
+      std::vector<uint8_t> Positions; // the position stream if it is separate
+      std::vector<MeshCache::LevelOfDetail> Lods;
+      std::vector<Meshlet> Meshlets;
+      std::unique_ptr<MeshCache> Cache;
+
+      MeshData() :
+         NormalsExist( false ), TexturesExist( false ), VertexStride( 0 ), VertexNum( 0 ),
+         IndexType( GL_UNSIGNED_INT ), BoundsMin( 0.0f ), BoundsMax( 0.0f ), VertexData( nullptr ),
+         VertexDataSize( 0 ), IndexData( nullptr ), IndexDataSize( 0 ) {}
+   };
+
+   // A decoded image whose rows are 4-byte aligned, which matches the default unpack alignment.
+   struct ImageData
+   {
+      int Width;
+      int Height;
+      bool IsGrayscale;
+      std::vector<uint8_t> Pixels;
+
+      ImageData() : Width( 0 ), Height( 0 ), IsGrayscale( false ) {}
+   };
 
    ObjectGL();
    ~ObjectGL();
 
-   void setEmissionColor(const glm::vec4& emission_color);
-   void setAmbientReflectionColor(const glm::vec4& ambient_reflection_color);
-   void setDiffuseReflectionColor(const glm::vec4& diffuse_reflection_color);
-   void setSpecularReflectionColor(const glm::vec4& specular_reflection_color);
-   void setSpecularReflectionExponent(const float& specular_reflection_exponent);
+   void setMeshOptimization(bool optimize) { OptimizeMesh = optimize; }
+   // The vertex format of meshes loaded from OBJ files; the other meshes stay in 32-bit floats.
+   void setVertexFormat(const VertexFormat& format) { RequestedFormat = format; }
+   // Keeps a tightly packed copy of the positions with its own VAO for the passes that read nothing else.
+   void setPositionStream(bool separate) { SeparatePositionStream = separate; }
+   // Splits indexed meshes into meshlets at load time so that drawVisible can skip the culled ones.
+   void setMeshletBuilding(bool build) { BuildMeshlets = build; }
+   // Appends a chain of simplified index lists to OBJ meshes, which drawVisible can draw instead of the original.
+   void setLodGeneration(bool generate) { GenerateLods = generate; }
+   // Suballocates the buffers of the next mesh and of the instances from the arena, which has to outlive this object.
+   // The mesh then shares the VAO of its vertex layout and always has indices.
+   void setGeometryArena(GeometryArenaGL* arena) { Arena = arena; }
    void setObject(GLenum draw_mode, const std::vector<glm::vec3>& vertices);
    void setObject(
       GLenum draw_mode,
@@ -43,6 +124,8 @@ public:
       bool is_grayscale = false
    );
    void setObject(GLenum draw_mode, const std::string& obj_file_path);
+   // Creates the buffers of a prepared mesh. Without upload, their contents are left for the caller to copy.
+   void setObject(GLenum draw_mode, const MeshData& mesh, bool upload = true);
    void setObject(
       GLenum draw_mode,
       const std::string& obj_file_path,
@@ -57,21 +140,134 @@ public:
    int addTexture(const std::string& texture_file_path, bool is_grayscale = false);
    void addTexture(int width, int height, bool is_grayscale = false);
    int addTexture(const uint8_t* image_buffer, int width, int height, bool is_grayscale = false);
-   void transferUniformsToShader(const ShaderGL* shader);
+   // The pixels can also be an offset into the buffer bound to GL_PIXEL_UNPACK_BUFFER.
+   int addTexture(const ImageData& image, const void* pixels);
+   // Reads the mesh cache or builds the mesh from the OBJ file without touching the GL state, so it is safe to call
+   // from any thread while the settings of this object do not change.
+   [[nodiscard]] bool prepareMeshData(MeshData& mesh, const std::string& obj_file_path) const;
+   [[nodiscard]] static bool decodeImage(ImageData& image, const std::string& file_path, bool is_grayscale);
+   void setLoadState(LoadState state) { State = state; }
+   // The number of vertices can only change in a geometry arena, where the ranges of the object are moved.
    void updateDataBuffer(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals);
    void updateDataBuffer(
       const std::vector<glm::vec3>& vertices,
       const std::vector<glm::vec3>& normals,
       const std::vector<glm::vec2>& textures
    );
+   // Only the positions are replaced, and only on an object that keeps its float vertices or has them in floats in
+   // the vertex buffer, which the non-float meshes from the cache and the asset loader do not. The vertices are
+   // stored in the vertex format of the object, and quantized positions are requantized over the new bounds.
    void replaceVertices(const std::vector<glm::vec3>& vertices, bool normals_exist, bool textures_exist);
    void replaceVertices(const std::vector<float>& vertices, bool normals_exist, bool textures_exist);
+   // Replaces the instances that the draws repeat the mesh for. It can be called before the mesh is set, which
+   // otherwise gets a single instance where it is. Without a geometry arena the buffer only grows, and an empty list
+   // draws the mesh nowhere.
+   void setInstances(const std::vector<Instance>& instances);
+   // With a geometry arena, the base vertex depends on whether the bound VAO is the position-only one.
+   void draw(bool position_only = false) const;
+   // Draws the meshlets that survive culling against world_to_clip, or the whole mesh if there are no meshlets.
+   // A level of detail above 0 is drawn whole unless the bounding box is outside of the frustum. Without a geometry
+   // arena, the culling only knows a single transform, so with more than one instance the mesh is drawn whole.
+   void drawVisible(const glm::mat4& world_to_clip, bool cull_backfaces, int lod = 0, bool position_only = false);
+   // Appends what drawVisible would draw as indirect commands, which only an indexed mesh can have. The instances
+   // are culled by their world bounds, and the visible ones are drawn by one command per run of neighbors.
+   void appendDrawCommands(
+      std::vector<DrawElementsIndirectCommand>& commands,
+      const glm::mat4& world_to_clip,
+      bool cull_backfaces,
+      int lod,
+      bool position_only
+   );
+   // The command that draws the level of detail, or the whole mesh, for every instance.
+   [[nodiscard]] DrawElementsIndirectCommand getDrawCommand(int lod, bool position_only) const;
+   // Only the whole mesh of a single instance is split into meshlets for culling.
+   [[nodiscard]] bool isDrawnAsMeshlets(int lod) const
+   {
+      return (lod <= 0 || lod >= static_cast<int>(Lods.size())) && !Meshlets.empty() && getInstanceNum() == 1;
+   }
+   // The coarsest level of detail whose error is at most max_error in object space.
+   [[nodiscard]] int selectLod(float max_error) const;
+   [[nodiscard]] bool isReady() const { return State == LoadState::Ready; }
+   [[nodiscard]] LoadState getLoadState() const { return State; }
    [[nodiscard]] GLuint getVAO() const { return VAO; }
+   [[nodiscard]] GLuint getVBO() const { return Arena != nullptr ? Arena->getBuffer( GeometryArenaGL::VertexBuffer ) : VBO; }
+   [[nodiscard]] GLuint getIBO() const { return Arena != nullptr ? Arena->getBuffer( GeometryArenaGL::IndexBuffer ) : IBO; }
+   [[nodiscard]] GLuint getPositionVBO() const
+   {
+      return Arena != nullptr && PositionRange.Size > 0 ? Arena->getBuffer( GeometryArenaGL::VertexBuffer ) : PositionVBO;
+   }
+   // Where the data of this object starts in the buffers above, which is 0 without a geometry arena.
+   [[nodiscard]] GLintptr getVertexBufferOffset() const { return VertexRange.Offset; }
+   [[nodiscard]] GLintptr getPositionBufferOffset() const { return PositionRange.Offset; }
+   [[nodiscard]] GLintptr getIndexBufferOffset() const { return IndexRange.Offset; }
+   [[nodiscard]] GLuint getPositionVAO() const { return PositionVAO != 0 ? PositionVAO : VAO; }
    [[nodiscard]] GLenum getDrawMode() const { return DrawMode; }
+   [[nodiscard]] GLenum getIndexType() const { return IndexType; }
    [[nodiscard]] GLsizei getVertexNum() const { return VerticesCount; }
+   [[nodiscard]] GLsizei getIndexNum() const { return IndicesCount; }
+   [[nodiscard]] bool isIndexed() const { return IBO != 0 || IndexRange.Size > 0; }
+   [[nodiscard]] const VertexFormat& getVertexFormat() const { return Format; }
+   [[nodiscard]] const glm::vec3& getPositionScale() const { return PositionScale; }
+   [[nodiscard]] const glm::vec3& getPositionBias() const { return PositionBias; }
+   [[nodiscard]] const std::vector<Meshlet>& getMeshlets() const { return Meshlets; }
+   [[nodiscard]] size_t getVisibleMeshletNum() const { return VisibleMeshletNum; }
+   [[nodiscard]] size_t getDrawnTriangleNum() const { return DrawnTriangleNum; }
+   [[nodiscard]] size_t getVisibleInstanceNum() const { return VisibleInstanceNum; }
+   [[nodiscard]] const std::vector<Instance>& getInstances() const { return Instances; }
+   [[nodiscard]] GLsizei getInstanceNum() const { return static_cast<GLsizei>(Instances.size()); }
+   [[nodiscard]] int getLodNum() const { return std::max( static_cast<int>(Lods.size()), 1 ); }
+   [[nodiscard]] float getLodError(int lod) const { return lod > 0 ? Lods[lod].Error : 0.0f; }
+   [[nodiscard]] const glm::vec3& getBoundingBoxMin() const { return BoundingBoxMin; }
+   [[nodiscard]] const glm::vec3& getBoundingBoxMax() const { return BoundingBoxMax; }
+   // The bounds of every instance together and of each one, which follow both the mesh and the instances.
+   [[nodiscard]] const Bounds& getWorldBounds() const { return WorldBounds; }
+   [[nodiscard]] const std::vector<Bounds>& getInstanceWorldBounds() const { return InstanceWorldBounds; }
+   // Changes whenever the bounds, the meshlets, or the instances do, so that a copy of them can be kept up to date.
+   [[nodiscard]] uint32_t getGeometryVersion() const { return GeometryVersion; }
+   // The box that bounds the box from bounds_min to bounds_max after to_world, which is looser than the transformed
+   // box itself.
+   [[nodiscard]] static Bounds transformBounds(
+      const glm::mat4& to_world,
+      const glm::vec3& bounds_min,
+      const glm::vec3& bounds_max
+   );
    [[nodiscard]] GLuint getTextureID(int index) const { return TextureID[index]; }
    [[nodiscard]] int getTextureNum() const { return static_cast<int>(TextureID.size()); }
 
+   // Uploads one stream per attribute of Layout as an interleaved vertex buffer. DataBuffer keeps the vertices for
+   // the bounds and replaceVertices, so the layout has to start with the float position.
+   template<typename Layout, typename... Streams>
+   void setInterleavedObject(GLenum draw_mode, const Streams&... streams)
+   {
+      static_assert(
+         std::is_same_v<typename Layout::template Attribute<0>, PositionAttribute>,
+         "The layout has to start with the float position."
+      );
+
+      DrawMode = draw_mode;
+      Layout::interleave( DataBuffer, streams... );
+      VerticesCount = static_cast<GLsizei>(DataBuffer.size() * sizeof( GLfloat ) / Layout::Stride);
+      prepareVertexBuffer( Layout::Stride, Layout::LocationMask );
+      Layout::setAttributeFormats( VAO );
+   }
+
+   template<typename Layout, typename... Streams>
+   void updateInterleavedData(const Streams&... streams)
+   {
+      assert( VAO != 0 && Format.isFloat32() && VertexStride == Layout::Stride );
+
+      std::vector<GLfloat> vertices;
+      Layout::interleave( vertices, streams... );
+      if (!resizeVertexBuffer( static_cast<GLsizei>(vertices.size() * sizeof( GLfloat ) / Layout::Stride) )) return;
+
+      DataBuffer = std::move( vertices );
+      glNamedBufferSubData(
+         getVBO(), VertexRange.Offset, static_cast<GLsizeiptr>(sizeof( GLfloat ) * DataBuffer.size()), DataBuffer.data()
+      );
+      updatePositionBuffer( DataBuffer.data() );
+      updateVertexBounds( Layout::Stride );
+   }
+
    template<typename T>
    void addShaderStorageBufferObject(const std::string& name, GLuint binding_index, int data_size)
    {
@@ -107,33 +303,104 @@ public:
    }
 
 private:
+   LoadState State;
+   bool OptimizeMesh;
+   bool SeparatePositionStream;
+   bool BuildMeshlets;
+   bool GenerateLods;
+   GeometryArenaGL* Arena;
+   GeometryArenaGL::Range VertexRange;
+   GeometryArenaGL::Range PositionRange;
+   GeometryArenaGL::Range IndexRange;
+   GeometryArenaGL::Range InstanceRange;
+   VertexFormat RequestedFormat;
+   VertexFormat Format;
    std::vector<GLfloat> DataBuffer;
    GLuint VAO;
    GLuint VBO;
+   GLuint IBO;
+   GLuint PositionVAO;
+   GLuint PositionVBO;
+   GLuint InstanceBuffer;
+   GLsizeiptr InstanceBufferSize;
+   GLenum IndexType;
    GLenum DrawMode;
+   GLsizei VertexStride;
    std::vector<GLuint> TextureID;
    std::map<std::string, GLuint> CustomBuffers;
    GLsizei VerticesCount;
-   glm::vec4 EmissionColor;
-   glm::vec4 AmbientReflectionColor; // It is usually set to the same color with DiffuseReflectionColor.
-                                     // Otherwise, it should be in balance with DiffuseReflectionColor.
-   glm::vec4 DiffuseReflectionColor; // the intrinsic color
-   glm::vec4 SpecularReflectionColor;
-   float SpecularReflectionExponent;
-
-   [[nodiscard]] bool prepareTexture2DUsingFreeImage(const std::string& file_path, bool is_grayscale) const;
+   GLsizei IndicesCount;
+   glm::vec3 BoundingBoxMin;
+   glm::vec3 BoundingBoxMax;
+   Bounds WorldBounds;
+   std::vector<Bounds> InstanceWorldBounds;
+   uint32_t GeometryVersion;
+   size_t VisibleMeshletNum; // in the last drawVisible
+   size_t VisibleInstanceNum; // in the last drawVisible
+   size_t DrawnTriangleNum; // in the last drawVisible
+   std::vector<MeshCache::LevelOfDetail> Lods;
+   std::vector<Meshlet> Meshlets;
+   std::vector<MeshletCuller::IndexRange> VisibleRanges;
+   std::vector<GLsizei> VisibleIndexCounts;
+   std::vector<const void*> VisibleIndexOffsets;
+   std::vector<Instance> Instances;
+   std::vector<DrawElementsIndirectCommand> VisibleCommands;
+   glm::vec3 PositionScale; // maps the stored positions back to the object space in the vertex shader
+   glm::vec3 PositionBias;
+
    void prepareTexture(bool normals_exist) const;
-   void prepareVertexBuffer(int n_bytes_per_vertex);
+   // Replaces range with a new one from the arena, and marks the object as failed if there is no room for it.
+   [[nodiscard]] bool reallocate(
+      GeometryArenaGL::BufferType type,
+      GLsizeiptr size,
+      GLsizeiptr alignment,
+      GeometryArenaGL::Range& range
+   );
+   void prepareVertexBuffer(const void* data, GLsizeiptr size, int n_bytes_per_vertex, uint32_t location_mask);
+   void prepareVertexBuffer(int n_bytes_per_vertex, uint32_t location_mask);
+   // Makes sure that DataBuffer holds at least vertex_num float vertices, reading them back from the vertex buffer
+   // the first time if they are in floats there.
+   [[nodiscard]] bool prepareFloatVertices(size_t vertex_num, int step);
+   // Makes room for vertex_num vertices, which only the ranges of a geometry arena can do, along with their
+   // sequential indices. Returns false if the vertices do not fit.
+   [[nodiscard]] bool resizeVertexBuffer(GLsizei vertex_num);
+   // Writes the float vertices to the vertex buffer in the format of the object.
+   void uploadVertices(bool normals_exist, bool textures_exist);
+   void prepareSequentialIndices();
+   [[nodiscard]] uint32_t getLayoutKey(uint32_t location_mask) const { return Format.pack() | location_mask << 24u; }
+   [[nodiscard]] GLint getBaseVertex(bool position_only) const;
+   [[nodiscard]] GLuint getBaseInstance() const { return static_cast<GLuint>(InstanceRange.Offset / sizeof( Instance )); }
+   void drawCommand(const DrawElementsIndirectCommand& command) const;
    void prepareNormal() const;
+   void setPositionDequantization();
+   void setPositionAttribute(GLuint vao) const;
+   void setInstanceAttributes(GLuint vao) const;
+   void updateWorldBounds();
+   // Follows new float vertices in DataBuffer with the bounds, and drops the meshlets and the levels of detail, whose
+   // bounds, cones, and errors were measured on the old positions.
+   void updateVertexBounds(size_t float_stride);
+   [[nodiscard]] glm::mat4 getFirstInstanceToWorld() const
+   {
+      return Instances.empty() ? glm::mat4(1.0f) : Instances.front().ToWorld;
+   }
+   void preparePositionBuffer(const void* data, int n_bytes_per_vertex);
+   void createPositionBuffer(const void* positions, GLsizeiptr size);
+   static void getPositionStream(
+      std::vector<uint8_t>& positions,
+      const void* data,
+      GLsizei vertex_num,
+      int n_bytes_per_vertex,
+      uint position_size
+   );
+   // Copies the positions of the vertices, which are in the format of the object, to the position stream.
+   void updatePositionBuffer(const void* data);
+   static void buildMeshlets(MeshData& mesh, const std::vector<uint32_t>& indices);
+   void prepareIndexBuffer(const void* data, GLsizeiptr size, GLenum index_type, GLsizei index_num);
+   [[nodiscard]] bool loadMeshCache(MeshData& mesh, const std::string& obj_file_path) const;
+   void writeMeshCache(const MeshData& mesh, const std::string& obj_file_path, uint32_t layout_flags) const;
    static void getSquareObject(
       std::vector<glm::vec3>& vertices,
       std::vector<glm::vec3>& normals,
       std::vector<glm::vec2>& textures
    );
-   static bool readObjectFile(
-      std::vector<glm::vec3>& vertices,
-      std::vector<glm::vec3>& normals,
-      std::vector<glm::vec2>& textures,
-      const std::string& file_path
-   );
 };
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "mapped_file.h"
+
+// Binary file holding a linked program as glGetProgramBinary returned it, so that a later run can skip compiling.
+// Layout: Header | program binary. The file is named after a key over the sources and the driver, and a driver
+// may still reject a binary it wrote, in which case the caller compiles the program again.
+class ProgramCache final
+{
+public:
+   struct Header
+   {
+      char Magic[4];
+      uint32_t Version;
+      uint64_t Key;
+      uint32_t BinaryFormat;
+      uint32_t BinarySize; // in bytes
+   };
+
+   inline static constexpr char Magic[4] = { 'P', 'S', 'P', 'B' };
+   inline static constexpr uint32_t Version = 1;
+
+   // The sources already contain the defines of a permutation, so they cover them as well.
+   [[nodiscard]] static uint64_t getKey(const std::vector<std::pair<GLenum, std::string>>& stages);
+   [[nodiscard]] static std::string getCachePath(uint64_t key);
+   [[nodiscard]] static bool load(GLuint program, uint64_t key);
+   static bool write(GLuint program, uint64_t key);
+};
\ No newline at end of file
@@ -12,6 +12,13 @@
 #include "base.h"
 #include "text.h"
 #include "light.h"
+#include "asset_loader.h"
+#include "task_graph.h"
+#include "shader_permutations.h"
+#include "uniform_ring.h"
+#include "material.h"
+#include "draw_culler.h"
+#include "depth_reducer.h"
 
 class RendererGL final
 {
@@ -27,6 +34,63 @@ public:
    void play();
 
 private:
+   // The values of LIGHT_TYPE in the scene shader.
+   enum SceneLightType { NoLight = 0, SwitchedOffLight, DirectionalLight, PointLight, Spotlight };
+
+   // The values of CASCADE_SELECTION in the scene shader.
+   enum CascadeSelection { SelectByPass = 0, SelectPerFragment, BlendPerFragment };
+
+   inline static constexpr int MaxSplitNum = 8; // MAX_SPLITS in the light view and scene shaders
+
+   // The std140 layout of PassBlock in the scene shader. The instances add the transform to the world.
+   struct PassBlockData
+   {
+      glm::mat4 ViewProjectionMatrix;
+      glm::mat4 ViewMatrix;
+      glm::mat4 LightViewProjectionMatrix; // without the crop matrix of a split
+      int32_t ShadowLayer;
+      int32_t Padding[3];
+   };
+
+   // The std140 layout of CascadeBlock, which the light view shader draws every split with and the scene shader
+   // samples them with. A crop matrix only scales and translates, so the scene shader applies it per fragment as a
+   // scale and an offset.
+   struct CascadeBlockData
+   {
+      std::array<glm::mat4, MaxSplitNum> CascadeMatrices;
+      std::array<glm::vec4, MaxSplitNum> CropScales;
+      std::array<glm::vec4, MaxSplitNum> CropOffsets;
+      std::array<glm::vec4, MaxSplitNum / 4> SplitFarPlanes; // the unused ones are the largest float
+      int32_t CascadeNum;
+      float NearPlane;
+      float BlendRange; // the part of a split that fades into the next one
+      int32_t Padding;
+   };
+
+   // An instance that casts and receives shadows, bounded in world space and in the clip space of the light.
+   struct ShadowBounds
+   {
+      ObjectGL::Bounds World;
+      ObjectGL::Bounds Light;
+   };
+
+   // The transforms shared by every draw of a pass.
+   struct PassData
+   {
+      const CameraGL* Camera;
+      glm::mat4 CropMatrix;
+      glm::mat4 View;
+      glm::mat4 ViewProjection; // including the crop matrix
+      glm::mat4 LightViewProjection; // without the crop matrix of a split
+      bool DepthPass;
+      bool HasCasters; // false for a light view that nothing reaches into, which is skipped
+      int ShadowLayer; // that the pass draws to or samples, or -1 if the scene shader selects it per fragment
+      int CullingView; // -1 if the pass is culled on the CPU
+      int CullingList;
+   };
+
+   inline static constexpr GLuint PassBlockBinding = 1;
+   inline static constexpr GLuint CascadeBlockBinding = 4;
    inline static RendererGL* Renderer = nullptr;
    GLFWwindow* Window;
    bool Pause;
@@ -35,25 +99,49 @@ private:
    int ShadowMapSize;
    int SplitNum;
    int ActiveLightIndex;
+   int PcfKernelSize;
+   bool BunnyField; // 10k instances instead of one, to measure instanced drawing
+   bool GpuCulling;
+   bool SingleScenePass; // instead of one scene pass per split
+   bool CascadeBlending;
+   float CascadeBlendRange; // the part of a split that fades into the next one when blending
+   bool TightCrop; // to the receivers and casters of a split instead of its frustum
+   bool SampleDistribution; // splits between the depths that the camera sees instead of its near and far planes
    GLuint FBO;
    GLuint DepthTextureID;
+   GLuint SceneFBO; // which the scene is drawn to, so that its depth can be reduced
+   GLuint SceneColorID;
+   GLuint SceneDepthTextureID;
    glm::ivec2 ClickedPoint;
    std::unique_ptr<TextGL> Texter;
    std::unique_ptr<CameraGL> MainCamera;
    std::unique_ptr<CameraGL> TextCamera;
    std::unique_ptr<CameraGL> LightCamera;
    std::unique_ptr<ShaderGL> TextShader;
-   std::unique_ptr<ShaderGL> SceneShader;
+   std::unique_ptr<ShaderPermutationsGL> SceneShaders;
    std::unique_ptr<ShaderGL> LightViewShader;
+   std::unique_ptr<ShaderGL> CullingShader;
+   std::unique_ptr<ShaderGL> ReductionShader;
+   std::unique_ptr<GeometryArenaGL> Arena; // outlives the objects in it
    std::unique_ptr<ObjectGL> WallObject;
    std::unique_ptr<ObjectGL> BunnyObject;
    std::unique_ptr<LightGL> Lights;
+   std::unique_ptr<AssetLoader> Loader;
+   std::unique_ptr<UniformRingGL> DrawRing;
+   std::unique_ptr<DrawListGL> Draws;
+   std::unique_ptr<DrawListGL> ShadowDraws; // of every split, kept for the statistics
+   std::unique_ptr<DrawCullerGL> Culler;
+   std::unique_ptr<DepthReducerGL> Reducer;
+   std::unique_ptr<MaterialLibraryGL> Materials;
+   std::array<int, 3> WallMaterials;
+   int BunnyMaterial;
    std::vector<float> SplitPositions;
+   std::chrono::steady_clock::time_point StartTime;
 
    void registerCallbacks() const;
    void initialize();
    void writeFrame(const std::string& name) const;
-   void writeDepthTexture(const std::string& name) const;
+   void writeDepthTexture(const std::string& name, int layer) const;
 
    static void printOpenGLInformation();
 
@@ -63,19 +151,60 @@ private:
    static void mouse(GLFWwindow* window, int button, int action, int mods);
    static void mousewheel(GLFWwindow* window, double xoffset, double yoffset);
 
-   void splitViewFrustum();
+   void splitViewFrustum(float near, float far);
    void setLights() const;
    void setWallObject() const;
    void setBunnyObject() const;
+   void setBunnyInstances() const;
    void setDepthFrameBuffer();
+   void setSceneFrameBuffer();
+   void setMaterials();
+   void prepareScene();
    void getSplitFrustum(std::array<glm::vec3, 8>& frustum, float near, float far) const;
    static void getBoundingBox(std::array<glm::vec3, 8>& bounding_box, const std::array<glm::vec3, 8>& points);
-   [[nodiscard]] glm::mat4 calculateLightCropMatrix(std::array<glm::vec3, 8>& bounding_box) const;
+   [[nodiscard]] glm::mat4 getSplitViewProjection(float near, float far) const;
+   // A frame takes the bounds of every object as a whole, so that its cost does not grow with the instances. Only
+   // the statistics can afford per_instance bounds.
+   void getShadowBounds(std::vector<ShadowBounds>& bounds, bool per_instance) const;
+   [[nodiscard]] glm::mat4 calculateLightCropMatrix(
+      const std::array<glm::vec3, 8>& bounding_box,
+      const glm::mat4& split_view_projection,
+      const std::vector<ShadowBounds>& shadow_bounds,
+      bool& has_receivers
+   ) const;
 
-   void drawBoxObject(ShaderGL* shader, const CameraGL* camera) const;
-   void drawBunnyObject(ShaderGL* shader, const CameraGL* camera) const;
-   void drawDepthMapFromLightView(const glm::mat4& light_crop_matrix) const;
-   void drawShadow(const glm::mat4& light_crop_matrix) const;
+   // One level of detail serves every instance, so the bound holds at the nearest point of their world bounds, and
+   // the instances are taken to share the scale of the first one.
+   [[nodiscard]] float getLodErrorBound(
+      const CameraGL* camera,
+      const glm::mat4& crop_matrix,
+      const ObjectGL* object,
+      bool depth_pass
+   ) const;
+   [[nodiscard]] uint64_t getSceneShaderKey(bool use_texture) const;
+   [[nodiscard]] GLuint getSceneProgram(const ObjectGL* object) const;
+   [[nodiscard]] PassData getLightViewPass(const glm::mat4& light_crop_matrix, int split) const;
+   [[nodiscard]] PassData getScenePass(int split) const;
+   [[nodiscard]] bool hasCasters(const PassData& light_view_pass) const;
+   [[nodiscard]] bool bindPassData(const PassData& pass) const;
+   [[nodiscard]] bool bindCascadeData(const std::vector<PassData>& light_view_passes) const;
+   void addDraw(
+      GLuint program,
+      ObjectGL* object,
+      const glm::mat4& object_to_clip,
+      const PassData& pass,
+      int lod,
+      bool cull_backfaces
+   ) const;
+   void addBoxObject(GLuint program, const PassData& pass) const;
+   void addBunnyObject(GLuint program, const PassData& pass) const;
+   void addPassObjects(const PassData& pass) const;
+   void addCullingView(PassData& pass) const;
+   void drawPassObjects(const PassData* passes, size_t pass_num) const;
+   void drawDepthMapsFromLightView(const std::vector<PassData>& passes) const;
+   void drawShadow(const PassData& pass) const;
    void drawText(const std::string& text) const;
-   void render() const;
+   void printDrawStatistics() const;
+   void printShadowMapUsage() const;
+   void render();
 };
\ No newline at end of file
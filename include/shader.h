@@ -2,37 +2,85 @@
 
 #include "base.h"
 #include "camera.h"
+#include "program_cache.h"
 
-class ShaderGL final
+// A uniform name hashed at compile time, so that setting the uniform neither builds nor hashes a string.
+struct UniformName final
 {
-public:
-   struct LightLocationSet
+   uint32_t Hash;
+   const char* Name;
+
+   constexpr explicit UniformName(const char* name) : Hash( hash( name ) ), Name( name ) {}
+
+   // 32-bit FNV-1a
+   [[nodiscard]] static constexpr uint32_t hash(const char* name)
    {
-      GLint LightSwitch, LightPosition;
-      GLint LightAmbient, LightDiffuse, LightSpecular, LightFallOffRadius;
-      GLint SpotlightDirection, SpotlightCutoffAngle, SpotlightFeather;
+      uint32_t h = 2166136261u;
+      while (*name != '\0') {
+         h ^= static_cast<uint8_t>(*name++);
+         h *= 16777619u;
+      }
+      return h;
+   }
+};
 
-      LightLocationSet() : LightSwitch( 0 ), LightPosition( 0 ), LightAmbient( 0 ), LightDiffuse( 0 ),
-      LightSpecular( 0 ), LightFallOffRadius( 0 ), SpotlightDirection( 0 ), SpotlightCutoffAngle( 0 ),
-      SpotlightFeather( 0 ) {}
-   };
+// The uniforms that are set by name.
+namespace Uniform
+{
+   inline constexpr UniformName TextScale( "TextScale" );
+   inline constexpr UniformName LightIndex( "LightIndex" );
+
+   inline constexpr std::array<UniformName, 2> All = { TextScale, LightIndex };
+   [[nodiscard]] constexpr bool areHashesDistinct()
+   {
+      for (size_t i = 0; i < All.size(); ++i) {
+         for (size_t j = i + 1; j < All.size(); ++j) {
+            if (All[i].Hash == All[j].Hash) return false;
+         }
+      }
+      return true;
+   }
+   static_assert( areHashesDistinct(), "Two uniform names have the same hash." );
+}
 
+class ShaderGL final
+{
+public:
    struct LocationSet
    {
       GLint World, View, Projection, ModelViewProjection;
-      GLint MaterialEmission, MaterialAmbient, MaterialDiffuse, MaterialSpecular, MaterialSpecularExponent;
       std::map<GLint, GLint> Texture; // <binding point, texture id>
-      GLint UseLight, LightNum, GlobalAmbient;
-      std::vector<LightLocationSet> Lights;
 
-      LocationSet() : World( 0 ), View( 0 ), Projection( 0 ), ModelViewProjection( 0 ), MaterialEmission( 0 ),
-      MaterialAmbient( 0 ), MaterialDiffuse( 0 ), MaterialSpecular( 0 ), MaterialSpecularExponent( 0 ), UseLight( 0 ),
-      LightNum( 0 ), GlobalAmbient( 0 ) {}
+      // -1 makes glUniform* ignore the uniforms that a program does not have.
+      LocationSet() : World( -1 ), View( -1 ), Projection( -1 ), ModelViewProjection( -1 ) {}
+   };
+
+   // The stages of a program read from their files, which can happen on any thread.
+   struct ShaderSources
+   {
+      std::vector<std::pair<GLenum, std::string>> Stages; // <shader type, source code>
    };
 
    ShaderGL();
    virtual ~ShaderGL();
 
+   // Lets the driver compile on its own threads where GL_KHR_parallel_shader_compile is supported.
+   static void enableParallelCompile();
+   [[nodiscard]] static bool isExtensionSupported(const char* name);
+   static void readShaderSources(
+      ShaderSources& sources,
+      const char* vertex_shader_path,
+      const char* fragment_shader_path,
+      const char* geometry_shader_path = nullptr,
+      const char* tessellation_control_shader_path = nullptr,
+      const char* tessellation_evaluation_shader_path = nullptr
+   );
+   // Issues the compile and link of the program without waiting for them, so that the driver can work on them while
+   // the caller goes on. finishShader waits for the result, reports the errors and releases the shader objects.
+   // A program binary cached by an earlier run is used instead when the driver accepts it.
+   void compileShader(const ShaderSources& sources);
+   bool finishShader();
+
    void setShader(
       const char* vertex_shader_path,
       const char* fragment_shader_path,
@@ -43,103 +91,73 @@ public:
    void setComputeShaders(const char* compute_shader_path);
    void setTextUniformLocations();
    void setLightViewUniformLocations();
-   void setSceneUniformLocations(int light_num);
-   void addUniformLocation(const std::string& name)
-   {
-      CustomLocations[name] = glGetUniformLocation( ShaderProgram, name.c_str() );
-   }
+   void setSceneUniformLocations();
+   void addUniformLocation(const UniformName& name);
    void transferBasicTransformationUniforms(const glm::mat4& to_world, const CameraGL* camera) const;
-   void uniform1i(const char* name, int value) const
+   void uniform1i(const UniformName& name, int value) const
    {
-      glProgramUniform1i( ShaderProgram, CustomLocations.find( name )->second, value );
+      glProgramUniform1i( ShaderProgram, getLocation( name ), value );
    }
-   void uniform1f(const char* name, float value) const
+   void uniform1f(const UniformName& name, float value) const
    {
-      glProgramUniform1f( ShaderProgram, CustomLocations.find( name )->second, value );
+      glProgramUniform1f( ShaderProgram, getLocation( name ), value );
    }
-   void uniform1fv(const char* name, int count, const float* value) const
+   void uniform1fv(const UniformName& name, int count, const float* value) const
    {
-      glProgramUniform1fv( ShaderProgram, CustomLocations.find( name )->second, count, value );
+      glProgramUniform1fv( ShaderProgram, getLocation( name ), count, value );
    }
-   void uniform2fv(const char* name, const glm::vec2& value) const
+   void uniform2fv(const UniformName& name, const glm::vec2& value) const
    {
-      glProgramUniform2fv( ShaderProgram, CustomLocations.find( name )->second, 1, &value[0] );
+      glProgramUniform2fv( ShaderProgram, getLocation( name ), 1, &value[0] );
    }
-   void uniform2fv(const char* name, int count, const float* value) const
+   void uniform2fv(const UniformName& name, int count, const float* value) const
    {
-      glProgramUniform2fv( ShaderProgram, CustomLocations.find( name )->second, count, value );
+      glProgramUniform2fv( ShaderProgram, getLocation( name ), count, value );
    }
-   void uniform3fv(const char* name, const glm::vec3& value) const
+   void uniform3fv(const UniformName& name, const glm::vec3& value) const
    {
-      glProgramUniform3fv( ShaderProgram, CustomLocations.find( name )->second, 1, &value[0] );
+      glProgramUniform3fv( ShaderProgram, getLocation( name ), 1, &value[0] );
    }
-   void uniform4fv(const char* name, const glm::vec4& value) const
+   void uniform4fv(const UniformName& name, const glm::vec4& value) const
    {
-      glProgramUniform4fv( ShaderProgram, CustomLocations.find( name )->second, 1, &value[0] );
+      glProgramUniform4fv( ShaderProgram, getLocation( name ), 1, &value[0] );
    }
-   void uniformMat3fv(const char* name, const glm::mat3& value) const
+   void uniformMat3fv(const UniformName& name, const glm::mat3& value) const
    {
-      glProgramUniformMatrix3fv( ShaderProgram, CustomLocations.find( name )->second, 1, GL_FALSE, &value[0][0] );
+      glProgramUniformMatrix3fv( ShaderProgram, getLocation( name ), 1, GL_FALSE, &value[0][0] );
    }
-   void uniformMat4fv(const char* name, const glm::mat4& value) const
+   void uniformMat4fv(const UniformName& name, const glm::mat4& value) const
    {
-      glProgramUniformMatrix4fv( ShaderProgram, CustomLocations.find( name )->second, 1, GL_FALSE, &value[0][0] );
+      glProgramUniformMatrix4fv( ShaderProgram, getLocation( name ), 1, GL_FALSE, &value[0][0] );
    }
    [[nodiscard]] GLuint getShaderProgram() const { return ShaderProgram; }
-   [[nodiscard]] GLint getLocation(const std::string& name) const { return CustomLocations.find( name )->second; }
-   [[nodiscard]] GLint getMaterialEmissionLocation() const { return Location.MaterialEmission; }
-   [[nodiscard]] GLint getMaterialAmbientLocation() const { return Location.MaterialAmbient; }
-   [[nodiscard]] GLint getMaterialDiffuseLocation() const { return Location.MaterialDiffuse; }
-   [[nodiscard]] GLint getMaterialSpecularLocation() const { return Location.MaterialSpecular; }
-   [[nodiscard]] GLint getMaterialSpecularExponentLocation() const { return Location.MaterialSpecularExponent; }
-   [[nodiscard]] GLint getLightAvailabilityLocation() const { return Location.UseLight; }
-   [[nodiscard]] GLint getLightNumLocation() const { return Location.LightNum; }
-   [[nodiscard]] GLint getGlobalAmbientLocation() const { return Location.GlobalAmbient; }
-   [[nodiscard]] GLint getLightSwitchLocation(int light_index) const
-   {
-      return Location.Lights[light_index].LightSwitch;
-   }
-   [[nodiscard]] GLint getLightPositionLocation(int light_index) const
-   {
-      return Location.Lights[light_index].LightPosition;
-   }
-   [[nodiscard]] GLint getLightAmbientLocation(int light_index) const
+   [[nodiscard]] GLint getLocation(const UniformName& name) const
    {
-      return Location.Lights[light_index].LightAmbient;
-   }
-   [[nodiscard]] GLint getLightDiffuseLocation(int light_index) const
-   {
-      return Location.Lights[light_index].LightDiffuse;
-   }
-   [[nodiscard]] GLint getLightSpecularLocation(int light_index) const
-   {
-      return Location.Lights[light_index].LightSpecular;
-   }
-   [[nodiscard]] GLint getLightSpotlightDirectionLocation(int light_index) const
-   {
-      return Location.Lights[light_index].SpotlightDirection;
-   }
-   [[nodiscard]] GLint getLightSpotlightCutoffAngleLocation(int light_index) const
-   {
-      return Location.Lights[light_index].SpotlightCutoffAngle;
-   }
-   [[nodiscard]] GLint getLightSpotlightFeatherLocation(int light_index) const
-   {
-      return Location.Lights[light_index].SpotlightFeather;
-   }
-   [[nodiscard]] GLint getLightFallOffRadiusLocation(int light_index) const
-   {
-      return Location.Lights[light_index].LightFallOffRadius;
+      // A program has a handful of these, so a scan beats any hashing.
+      for (const auto& uniform : CustomLocations) {
+         if (uniform.Hash == name.Hash) return uniform.Location;
+      }
+      return -1;
    }
 
 protected:
+   struct CustomLocation
+   {
+      uint32_t Hash;
+      GLint Location;
+      const char* Name;
+   };
+
    GLuint ShaderProgram;
    LocationSet Location;
-   std::unordered_map<std::string, GLint> CustomLocations;
+   std::vector<CustomLocation> CustomLocations;
+   std::vector<std::pair<GLenum, GLuint>> PendingShaders; // <shader type, shader> until finishShader
+   uint64_t CacheKey; // of the program being compiled, 0 if it came from the cache
 
    static void readShaderFile(std::string& shader_contents, const char* shader_path);
    [[nodiscard]] static std::string getShaderTypeString(GLenum shader_type);
    [[nodiscard]] static bool checkCompileError(GLenum shader_type, const GLuint& shader);
+   [[nodiscard]] static bool checkLinkError(GLuint program);
    [[nodiscard]] static GLuint getCompiledShader(GLenum shader_type, const char* shader_path);
    void setBasicTransformationUniforms();
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "shader.h"
+
+#include <functional>
+
+// Variants of one program specialized by #defines, so that whatever a draw does not use is compiled out instead of
+// being branched on per fragment. A variant is compiled on its first use and is looked up by a key packing the
+// values of its defines, so that choosing one per draw takes no string work.
+class ShaderPermutationsGL final
+{
+public:
+   struct Define
+   {
+      std::string Name;
+      int Bits; // of the key, which the values have to fit in
+   };
+
+   ShaderPermutationsGL(std::vector<Define> defines, std::function<void(ShaderGL*)> set_uniform_locations);
+   ~ShaderPermutationsGL() = default;
+
+   ShaderPermutationsGL(const ShaderPermutationsGL&) = delete;
+   ShaderPermutationsGL(const ShaderPermutationsGL&&) = delete;
+   ShaderPermutationsGL& operator=(const ShaderPermutationsGL&) = delete;
+   ShaderPermutationsGL& operator=(const ShaderPermutationsGL&&) = delete;
+
+   void setSources(ShaderGL::ShaderSources&& sources);
+   // The values are in the order of the defines.
+   [[nodiscard]] uint64_t getKey(std::initializer_list<int> values) const;
+   // Issues the compile of a variant without waiting for it, which lets the likely ones be prepared ahead.
+   void compileVariant(uint64_t key);
+   ShaderGL* getVariant(uint64_t key);
+   [[nodiscard]] size_t getVariantNum() const { return Variants.size(); }
+
+private:
+   struct Variant
+   {
+      std::unique_ptr<ShaderGL> Shader;
+      bool Finished;
+   };
+
+   std::vector<Define> Defines;
+   std::function<void(ShaderGL*)> SetUniformLocations;
+   ShaderGL::ShaderSources Sources;
+   std::unordered_map<uint64_t, Variant> Variants;
+
+   [[nodiscard]] std::string getDefineBlock(uint64_t key) const;
+};
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "base.h"
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Runs a set of tasks as soon as the tasks they depend on are done. Worker tasks are spread over a thread pool,
+// while main tasks run on the thread that calls run(), which has to own the GL context. Among the ready tasks of a
+// thread, the one added first runs first. The start and end of every task are recorded for the timeline.
+class TaskGraph final
+{
+public:
+   enum class Thread { Main, Worker };
+
+   TaskGraph() = default;
+   ~TaskGraph() = default;
+
+   int addTask(
+      const std::string& name,
+      Thread thread,
+      std::function<void()> function,
+      const std::vector<int>& dependencies = {}
+   );
+   void run(int thread_num = 0);
+   void printTimeline() const;
+   // Writes the timeline in the Trace Event Format, which chrome://tracing and Perfetto can open.
+   [[nodiscard]] bool exportTimeline(const std::string& file_path) const;
+   // The chain of tasks that determined the end of the run, from the first one to the last one. A task on the chain
+   // either waited for a dependency or for its thread.
+   void getCriticalPath(std::vector<int>& path) const;
+   [[nodiscard]] double getElapsedTime() const; // in milliseconds
+
+private:
+   using Clock = std::chrono::steady_clock;
+
+   struct Task
+   {
+      std::string Name;
+      Thread RunOn;
+      std::function<void()> Function;
+      std::vector<int> Dependencies;
+      std::vector<int> Dependents;
+      int RemainingDependencyNum;
+      int ThreadIndex; // 0 for the main thread
+      Clock::time_point Start;
+      Clock::time_point End;
+   };
+
+   std::vector<Task> Tasks;
+   Clock::time_point RunStart;
+   std::mutex Mutex;
+   std::condition_variable Condition;
+   std::vector<int> ReadyMainTasks; // guarded by Mutex, in the order of addition
+   std::vector<int> ReadyWorkerTasks;
+   int FinishedTaskNum;
+
+   [[nodiscard]] double toMilliseconds(const Clock::time_point& time) const
+   {
+      return std::chrono::duration<double, std::milli>(time - RunStart).count();
+   }
+   [[nodiscard]] static int popFirst(std::vector<int>& ready);
+   void execute(int task_index, int thread_index);
+   void work(int thread_index);
+};
\ No newline at end of file
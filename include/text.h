@@ -39,6 +39,8 @@ public:
       return static_cast<float>(value) * converter;
    }
    [[nodiscard]] const ObjectGL* getGlyphObject() const { return GlyphObject.get(); }
+   // Opens the font without any GL call, so that it can be done on another thread before initialize().
+   void loadFont();
    void initialize();
    void getGlyphsFromText(std::vector<Glyph*>& glyphs, const std::string& text);
 
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "base.h"
+
+// A persistently mapped buffer that per-draw blocks and indirect commands are written into once and bound from by
+// range. It is split into one part per frame in flight, and a part is reused only when the GPU has finished the frame
+// that used it.
+class UniformRingGL final
+{
+public:
+   explicit UniformRingGL(GLsizeiptr frame_size = 4 << 20, int frame_num = 3);
+   ~UniformRingGL();
+
+   UniformRingGL(const UniformRingGL&) = delete;
+   UniformRingGL(const UniformRingGL&&) = delete;
+   UniformRingGL& operator=(const UniformRingGL&) = delete;
+   UniformRingGL& operator=(const UniformRingGL&&) = delete;
+
+   // Waits only if the CPU is a whole ring of frames ahead of the GPU.
+   void beginFrame();
+   void endFrame();
+   // Copies the data into this frame's part, or returns false when the part is full.
+   [[nodiscard]] bool write(const void* data, GLsizeiptr size, GLintptr& offset);
+   // Writes a uniform or shader storage block and binds it.
+   [[nodiscard]] bool bind(GLenum target, GLuint binding, const void* data, GLsizeiptr size);
+   [[nodiscard]] GLuint getBuffer() const { return Buffer; }
+
+private:
+   GLuint Buffer;
+   uint8_t* Data;
+   GLsizeiptr FrameSize;
+   GLsizeiptr Alignment;
+   int FrameIndex;
+   GLsizeiptr Head; // in the part of FrameIndex
+   std::vector<GLsync> Fences; // of the last frame that used each part
+};
\ No newline at end of file
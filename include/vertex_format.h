@@ -0,0 +1,87 @@
+#pragma once
+
+#include "base.h"
+
+// Storage formats of the vertex attributes in a GPU vertex buffer. Every attribute starts 4-byte aligned.
+//  - positions: 32-bit float, half float, or 16-bit unsigned normalized over the mesh bounds, which the vertex
+//    shader maps back with PositionScale and PositionBias
+//  - normals: 32-bit float, octahedral-encoded 16-bit signed normalized pair, or 10_10_10_2 signed normalized
+//  - texture coordinates: 32-bit float or half float
+struct VertexFormat
+{
+   enum class PositionType : uint8_t { Float32 = 0, Float16, UNorm16 };
+   enum class NormalType : uint8_t { Float32 = 0, Octahedral16, SNorm10 };
+   enum class TextureType : uint8_t { Float32 = 0, Float16 };
+
+   PositionType Position;
+   NormalType Normal;
+   TextureType Texture;
+
+   VertexFormat() : Position( PositionType::Float32 ), Normal( NormalType::Float32 ), Texture( TextureType::Float32 ) {}
+   VertexFormat(PositionType position, NormalType normal, TextureType texture) :
+      Position( position ), Normal( normal ), Texture( texture ) {}
+
+   [[nodiscard]] static VertexFormat getCompactFormat()
+   {
+      return { PositionType::UNorm16, NormalType::Octahedral16, TextureType::Float16 };
+   }
+   [[nodiscard]] static VertexFormat unpack(uint32_t packed)
+   {
+      return {
+         static_cast<PositionType>(packed & 0xFFu),
+         static_cast<NormalType>((packed >> 8u) & 0xFFu),
+         static_cast<TextureType>((packed >> 16u) & 0xFFu)
+      };
+   }
+   [[nodiscard]] uint32_t pack() const
+   {
+      return static_cast<uint32_t>(Position) | static_cast<uint32_t>(Normal) << 8u | static_cast<uint32_t>(Texture) << 16u;
+   }
+   [[nodiscard]] bool isFloat32() const { return pack() == 0; }
+   [[nodiscard]] bool operator==(const VertexFormat& other) const { return pack() == other.pack(); }
+   [[nodiscard]] bool operator!=(const VertexFormat& other) const { return pack() != other.pack(); }
+
+   [[nodiscard]] uint32_t getPositionSize() const { return Position == PositionType::Float32 ? 12 : 8; }
+   [[nodiscard]] uint32_t getNormalSize() const { return Normal == NormalType::Float32 ? 12 : 4; }
+   [[nodiscard]] uint32_t getTextureSize() const { return Texture == TextureType::Float32 ? 8 : 4; }
+   [[nodiscard]] uint32_t getNormalOffset() const { return getPositionSize(); }
+   [[nodiscard]] uint32_t getTextureOffset(bool normals_exist) const
+   {
+      return getPositionSize() + (normals_exist ? getNormalSize() : 0);
+   }
+   [[nodiscard]] uint32_t getStride(bool normals_exist, bool textures_exist) const
+   {
+      return getTextureOffset( normals_exist ) + (textures_exist ? getTextureSize() : 0);
+   }
+
+   // Converts an interleaved float stream of position[3], normal[3], texture[2] (the last two optional) into this
+   // format. Positions are quantized over [bounds_min, bounds_max].
+   void encode(
+      std::vector<uint8_t>& encoded,
+      const std::vector<float>& vertices,
+      bool normals_exist,
+      bool textures_exist,
+      const glm::vec3& bounds_min,
+      const glm::vec3& bounds_max
+   ) const;
+
+   // Prints the maximum and RMS error of the quantized positions relative to the bounding box diagonal, and the
+   // maximum angular error of the normals, by decoding what encode produced.
+   void reportError(
+      const std::string& name,
+      const std::vector<uint8_t>& encoded,
+      const std::vector<float>& vertices,
+      bool normals_exist,
+      bool textures_exist,
+      const glm::vec3& bounds_min,
+      const glm::vec3& bounds_max
+   ) const;
+
+   [[nodiscard]] glm::vec3 decodePosition(
+      const uint8_t* vertex,
+      const glm::vec3& bounds_min,
+      const glm::vec3& bounds_max
+   ) const;
+   [[nodiscard]] static glm::vec2 encodeOctahedral(const glm::vec3& normal);
+   [[nodiscard]] static glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+};
\ No newline at end of file
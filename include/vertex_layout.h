@@ -0,0 +1,95 @@
+#pragma once
+
+#include "base.h"
+#include <cstring>
+#include <tuple>
+
+// One attribute of an interleaved vertex: the CPU-side element type that is copied as is, and how OpenGL reads it.
+template<GLuint AttributeLocation, typename T, GLint ComponentNum, GLenum ComponentType, GLboolean Normalize = GL_FALSE>
+struct VertexAttribute
+{
+   using Type = T;
+
+   inline static constexpr GLuint Location = AttributeLocation;
+   inline static constexpr GLint Size = ComponentNum;
+   inline static constexpr GLenum ComponentTypeEnum = ComponentType;
+   inline static constexpr GLboolean Normalized = Normalize;
+
+   static_assert( sizeof( T ) % 4 == 0, "Every attribute must keep the next one 4-byte aligned." );
+};
+
+// Interleaved vertex layout whose stride and attribute offsets are fixed at compile time. Each attribute comes
+// from its own stream, e.g. VertexLayout<Position, Normal>::interleave( buffer, positions, normals ).
+template<typename... Attributes>
+struct VertexLayout
+{
+   template<size_t Index>
+   using Attribute = std::tuple_element_t<Index, std::tuple<Attributes...>>;
+
+   inline static constexpr size_t AttributeNum = sizeof...(Attributes);
+   inline static constexpr GLsizei Stride = static_cast<GLsizei>((sizeof( typename Attributes::Type ) + ...));
+   inline static constexpr uint32_t LocationMask = ((1u << Attributes::Location) | ...);
+   inline static constexpr std::array<GLuint, AttributeNum> Offsets = []()
+   {
+      constexpr std::array<size_t, AttributeNum> sizes = { sizeof( typename Attributes::Type )... };
+      std::array<GLuint, AttributeNum> offsets{};
+      GLuint offset = 0;
+      for (size_t i = 0; i < AttributeNum; ++i) {
+         offsets[i] = offset;
+         offset += static_cast<GLuint>(sizes[i]);
+      }
+      return offsets;
+   }();
+
+   // Resizes buffer once and fills it vertex by vertex; the copies are fixed-size, so they compile to plain moves.
+   template<typename T, typename... Streams>
+   static void interleave(std::vector<T>& buffer, const Streams&... streams)
+   {
+      static_assert( sizeof...(Streams) == AttributeNum, "There must be one stream per attribute." );
+      static_assert(
+         (std::is_same_v<typename Streams::value_type, typename Attributes::Type> && ...),
+         "The stream types must match the attribute types."
+      );
+      static_assert( Stride % sizeof( T ) == 0, "The buffer element must divide the stride." );
+
+      const size_t vertex_num = std::min( { streams.size()... } );
+      buffer.resize( vertex_num * Stride / sizeof( T ) );
+      interleaveVertices(
+         reinterpret_cast<uint8_t*>(buffer.data()), vertex_num, std::index_sequence_for<Attributes...>{}, streams...
+      );
+   }
+
+   static void setAttributeFormats(GLuint vao, GLuint binding_index = 0)
+   {
+      (setAttributeFormat<Attributes>( vao, binding_index ), ...);
+   }
+
+   template<typename A>
+   static void setAttributeFormat(GLuint vao, GLuint binding_index)
+   {
+      constexpr GLuint offset = Offsets[getIndex<A>()];
+      glVertexArrayAttribFormat( vao, A::Location, A::Size, A::ComponentTypeEnum, A::Normalized, offset );
+      glEnableVertexArrayAttrib( vao, A::Location );
+      glVertexArrayAttribBinding( vao, A::Location, binding_index );
+   }
+
+private:
+   template<typename A>
+   [[nodiscard]] static constexpr size_t getIndex()
+   {
+      constexpr std::array<bool, AttributeNum> matches = { std::is_same_v<A, Attributes>... };
+      for (size_t i = 0; i < AttributeNum; ++i) {
+         if (matches[i]) return i;
+      }
+      return AttributeNum;
+   }
+
+   template<size_t... Indices, typename... Streams>
+   static void interleaveVertices(uint8_t* out, size_t vertex_num, std::index_sequence<Indices...>, const Streams&... streams)
+   {
+      for (size_t i = 0; i < vertex_num; ++i) {
+         (std::memcpy( out + Offsets[Indices], &streams[i], sizeof( typename Attributes::Type ) ), ...);
+         out += Stride;
+      }
+   }
+};
\ No newline at end of file
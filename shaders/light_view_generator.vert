@@ -1,16 +1,43 @@
 #version 460
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
 
-uniform mat4 WorldMatrix;
-uniform mat4 ViewMatrix;
-uniform mat4 ProjectionMatrix;
-uniform mat4 ModelViewProjectionMatrix;
-uniform mat4 LightCropMatrix;
+#define MAX_SPLITS 8
+
+// The light view of every split, including its crop matrix, for the layer of the shadow map array it draws to. The
+// rest of the block is read by the scene shader.
+layout (std140, binding = 4) uniform CascadeBlock
+{
+   mat4 CascadeMatrices[MAX_SPLITS];
+};
+
+// One entry per command of the multi-draw. Compact vertex formats store positions relative to the mesh bounds and
+// normals octahedral-encoded.
+struct DrawInfo
+{
+   vec4 PositionScale; // w is 1 for octahedral-encoded normals
+   vec4 PositionBias; // w is the layer of the shadow map array
+};
+layout (std430, binding = 3) readonly buffer DrawBlock
+{
+   DrawInfo Draws[];
+};
 
 layout (location = 0) in vec3 v_position;
 layout (location = 1) in vec3 v_normal;
 layout (location = 2) in vec2 v_tex_coord;
+layout (location = 3) in mat4 i_to_world;
+
+// Read by light_view_generator.geom where the vertex shader cannot choose the layer.
+flat out int layer;
 
 void main()
 {
-   gl_Position = LightCropMatrix * ModelViewProjectionMatrix * vec4(v_position, 1.0f);
+   const DrawInfo draw = Draws[gl_DrawID];
+   vec3 position = v_position * draw.PositionScale.xyz + draw.PositionBias.xyz;
+   layer = int(draw.PositionBias.w);
+#if defined(GL_ARB_shader_viewport_layer_array) || defined(GL_AMD_vertex_shader_layer)
+   gl_Layer = layer;
+#endif
+   gl_Position = CascadeMatrices[layer] * i_to_world * vec4(position, 1.0f);
 }
\ No newline at end of file
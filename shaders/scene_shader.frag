@@ -1,47 +1,89 @@
 #version 460
 
+// ShaderPermutationsGL puts the defines of a variant right after the #version line, and these defaults only apply
+// when the shader is compiled on its own.
+#ifndef USE_TEXTURE
+#define USE_TEXTURE 0
+#endif
+// 0: lighting off, 1: the light is switched off, 2: directional light, 3: point light, 4: spotlight
+#ifndef LIGHT_TYPE
+#define LIGHT_TYPE 2
+#endif
+#ifndef PCF_KERNEL_SIZE
+#define PCF_KERNEL_SIZE 1
+#endif
+// 0: the split of the pass, 1: the split of the fragment, 2: the split of the fragment, blended into the next one
+#ifndef CASCADE_SELECTION
+#define CASCADE_SELECTION 1
+#endif
+
 #define MAX_LIGHTS 32
+#define MAX_MATERIALS 64
+#define MAX_SPLITS 8
 
+// Positions and directions are in eye space already.
 struct LightInfo
 {
-   int LightSwitch;
    vec4 Position;
    vec4 AmbientColor;
    vec4 DiffuseColor;
    vec4 SpecularColor;
-   vec3 SpotlightDirection;
+   vec4 SpotlightDirection;
    float SpotlightCutoffAngle;
    float SpotlightFeather;
    float FallOffRadius;
 };
-uniform LightInfo Lights[MAX_LIGHTS];
+layout (std140, binding = 0) uniform LightBlock
+{
+   vec4 GlobalAmbient;
+   int LightNum;
+   LightInfo Lights[MAX_LIGHTS];
+};
 
-struct MateralInfo {
+struct MaterialInfo
+{
    vec4 EmissionColor;
    vec4 AmbientColor;
    vec4 DiffuseColor;
    vec4 SpecularColor;
    float SpecularExponent;
 };
-uniform MateralInfo Material;
+layout (std140, binding = 2) uniform MaterialBlock
+{
+   MaterialInfo Materials[MAX_MATERIALS];
+};
 
 layout (binding = 0) uniform sampler2D BaseTexture;
-layout (binding = 1) uniform sampler2DShadow DepthMap;
-uniform int UseTexture;
+layout (binding = 1) uniform sampler2DArrayShadow DepthMap;
 
-uniform int UseLight;
-uniform int LightIndex;
-uniform int LightNum;
-uniform vec4 GlobalAmbient;
+layout (std140, binding = 1) uniform PassBlock
+{
+   mat4 ViewProjectionMatrix;
+   mat4 ViewMatrix;
+   mat4 LightViewProjectionMatrix;
+   int ShadowLayer;
+};
+
+// The splits of the main camera and the crop matrices of their layers.
+layout (std140, binding = 4) uniform CascadeBlock
+{
+   mat4 CascadeMatrices[MAX_SPLITS];
+   vec4 CropScales[MAX_SPLITS];
+   vec4 CropOffsets[MAX_SPLITS];
+   vec4 SplitFarPlanes[MAX_SPLITS / 4]; // the unused ones are the largest float
+   int CascadeNum;
+   float NearPlane;
+   float BlendRange;
+};
 
-uniform mat4 ViewMatrix;
-uniform mat4 ProjectionMatrix;
+uniform int LightIndex;
 
 in vec3 position_in_ec;
 in vec3 normal_in_ec;
 in vec2 tex_coord;
+flat in int material_index;
 
-in vec4 depth_map_coord;
+in vec4 position_in_light_cc;
 
 layout (location = 0) out vec4 final_color;
 
@@ -49,11 +91,6 @@ const float zero = 0.0f;
 const float one = 1.0f;
 const float half_pi = 1.57079632679489661923132169163975144f;
 
-bool IsPointLight(in vec4 light_position)
-{
-   return light_position.w != zero;
-}
-
 float getAttenuation(in vec3 light_vector, in int light_index)
 {
    float squared_distance = dot( light_vector, light_vector );
@@ -66,11 +103,7 @@ float getAttenuation(in vec3 light_vector, in int light_index)
 
 float getSpotlightFactor(in vec3 normalized_light_vector, in int light_index)
 {
-   if (Lights[light_index].SpotlightCutoffAngle >= 180.0f) return one;
-
-   vec4 direction_in_ec = transpose( inverse( ViewMatrix ) ) * vec4(Lights[light_index].SpotlightDirection, zero);
-   vec3 normalized_direction = normalize( direction_in_ec.xyz );
-   float factor = dot( -normalized_light_vector, normalized_direction );
+   float factor = dot( -normalized_light_vector, Lights[light_index].SpotlightDirection.xyz );
    float cutoff_angle = radians( clamp( Lights[light_index].SpotlightCutoffAngle, zero, 90.0f ) );
    if (factor >= cos( cutoff_angle )) {
       float normalized_angle = acos( factor ) * half_pi / cutoff_angle;
@@ -81,57 +114,109 @@ float getSpotlightFactor(in vec3 normalized_light_vector, in int light_index)
    return zero;
 }
 
-float getShadowFactor()
+float getShadowFactor(in int layer)
 {
+   const float bias_for_shadow_acne = 0.005f;
+   const float w = position_in_light_cc.w;
+   const vec3 position = position_in_light_cc.xyz * CropScales[layer].xyz + CropOffsets[layer].xyz * w;
+   const vec4 depth_map_coord = vec4(0.5f * (position + w) - vec3(zero, zero, bias_for_shadow_acne * w), w);
    if (zero <= depth_map_coord.x && depth_map_coord.x <= depth_map_coord.w &&
        zero <= depth_map_coord.y && depth_map_coord.y <= depth_map_coord.w &&
        zero < depth_map_coord.w) {
-      return textureProj( DepthMap, depth_map_coord );
+      // An array of shadow maps has no projective lookup, so the coordinates are divided here.
+      const vec3 coord = depth_map_coord.xyz / depth_map_coord.w;
+#if PCF_KERNEL_SIZE > 1
+      const int radius = PCF_KERNEL_SIZE / 2;
+      vec2 texel_size = one / vec2(textureSize( DepthMap, 0 ).xy);
+      float lit = zero;
+      for (int y = -radius; y <= radius; ++y) {
+         for (int x = -radius; x <= radius; ++x) {
+            lit += texture( DepthMap, vec4(coord.xy + vec2(x, y) * texel_size, float(layer), coord.z) );
+         }
+      }
+      return lit / float(PCF_KERNEL_SIZE * PCF_KERNEL_SIZE);
+#else
+      return texture( DepthMap, vec4(coord.xy, float(layer), coord.z) );
+#endif
    }
    return one;
 }
 
+float getCascadeShadowFactor()
+{
+#if CASCADE_SELECTION == 0
+   return getShadowFactor( ShadowLayer );
+#else
+   // The splits are sorted, so the split of the fragment is the number of far planes in front of it.
+   const float depth = -position_in_ec.z;
+   float passed = zero;
+   for (int i = 0; i < MAX_SPLITS / 4; ++i) {
+      passed += dot( vec4(greaterThan( vec4(depth), SplitFarPlanes[i] )), vec4(one) );
+   }
+   const int split = min( int(passed), CascadeNum - 1 );
+   float shadow = getShadowFactor( split );
+#if CASCADE_SELECTION == 2
+   // The last part of a split fades into the next one, so that the change of resolution leaves no seam.
+   if (split < CascadeNum - 1) {
+      const float far = SplitFarPlanes[split / 4][split % 4];
+      const float near = split > 0 ? SplitFarPlanes[(split - 1) / 4][(split - 1) % 4] : NearPlane;
+      const float t = (depth - far) / (BlendRange * (far - near)) + one;
+      if (t > zero) shadow = mix( shadow, getShadowFactor( split + 1 ), t );
+   }
+#endif
+   return shadow;
+#endif
+}
+
 vec4 calculateLightingEquation()
 {
-   vec4 color = Material.EmissionColor + GlobalAmbient * Material.AmbientColor;
+   const MaterialInfo material = Materials[material_index];
+   vec4 color = material.EmissionColor + GlobalAmbient * material.AmbientColor;
+#if LIGHT_TYPE == 1
+   return color;
+#else
+   vec4 light_position_in_ec = Lights[LightIndex].Position;
 
-   if (Lights[LightIndex].LightSwitch == 0) return color;
-      
-   vec4 light_position_in_ec = ViewMatrix * Lights[LightIndex].Position;
-      
-   float final_effect_factor = one;
+#if LIGHT_TYPE == 2
+   const float final_effect_factor = one;
+   vec3 light_vector = normalize( light_position_in_ec.xyz );
+#else
    vec3 light_vector = light_position_in_ec.xyz - position_in_ec;
-   if (IsPointLight( light_position_in_ec )) {
-      float attenuation = getAttenuation( light_vector, LightIndex );
-
-      light_vector = normalize( light_vector );
-      float spotlight_factor = getSpotlightFactor( light_vector, LightIndex );
-      final_effect_factor = attenuation * spotlight_factor;
-   }
-   else light_vector = normalize( light_position_in_ec.xyz );
-   
+   float final_effect_factor = getAttenuation( light_vector, LightIndex );
+   light_vector = normalize( light_vector );
+#if LIGHT_TYPE == 4
+   final_effect_factor *= getSpotlightFactor( light_vector, LightIndex );
+#endif
    if (final_effect_factor <= zero) return color;
+#endif
 
-   vec4 local_color = Lights[LightIndex].AmbientColor * Material.AmbientColor;
+   vec4 local_color = Lights[LightIndex].AmbientColor * material.AmbientColor;
 
    float diffuse_intensity = max( dot( normal_in_ec, light_vector ), zero );
-   local_color += diffuse_intensity * Lights[LightIndex].DiffuseColor * Material.DiffuseColor;
+   local_color += diffuse_intensity * Lights[LightIndex].DiffuseColor * material.DiffuseColor;
 
    vec3 halfway_vector = normalize( light_vector - normalize( position_in_ec ) );
    float specular_intensity = max( dot( normal_in_ec, halfway_vector ), zero );
    local_color += 
-      pow( specular_intensity, Material.SpecularExponent ) * 
-      Lights[LightIndex].SpecularColor * Material.SpecularColor;
+      pow( specular_intensity, material.SpecularExponent ) * 
+      Lights[LightIndex].SpecularColor * material.SpecularColor;
 
-   color += local_color * final_effect_factor * getShadowFactor();
+   color += local_color * final_effect_factor * getCascadeShadowFactor();
    return color;
+#endif
 }
 
 void main()
 {
-   if (UseTexture == 0) final_color = vec4(one);
-   else final_color = texture( BaseTexture, tex_coord );
-
-   if (UseLight != 0) final_color *= calculateLightingEquation();
-   else final_color *= Material.DiffuseColor;
+#if USE_TEXTURE
+   final_color = texture( BaseTexture, tex_coord );
+#else
+   final_color = vec4(one);
+#endif
+
+#if LIGHT_TYPE != 0
+   final_color *= calculateLightingEquation();
+#else
+   final_color *= Materials[material_index].DiffuseColor;
+#endif
 }
\ No newline at end of file
@@ -1,39 +1,67 @@
 #version 460
 
-uniform mat4 WorldMatrix;
-uniform mat4 ViewMatrix;
-uniform mat4 ProjectionMatrix;
-uniform mat4 ModelViewProjectionMatrix;
-uniform mat4 LightViewProjectionMatrix;
+// Written for every pass into the uniform ring. The transform to the world comes with each instance, and the crop
+// matrix of the split that a fragment samples is applied in the fragment shader.
+layout (std140, binding = 1) uniform PassBlock
+{
+   mat4 ViewProjectionMatrix;
+   mat4 ViewMatrix;
+   mat4 LightViewProjectionMatrix;
+   int ShadowLayer;
+};
+
+// One entry per command of the multi-draw. Compact vertex formats store positions relative to the mesh bounds and
+// normals octahedral-encoded.
+struct DrawInfo
+{
+   vec4 PositionScale; // w is 1 for octahedral-encoded normals
+   vec4 PositionBias; // w is the layer of the shadow map array in the light view
+};
+layout (std430, binding = 3) readonly buffer DrawBlock
+{
+   DrawInfo Draws[];
+};
 
 layout (location = 0) in vec3 v_position;
 layout (location = 1) in vec3 v_normal;
 layout (location = 2) in vec2 v_tex_coord;
+layout (location = 3) in mat4 i_to_world;
+layout (location = 7) in int i_material_index;
 
 out vec3 position_in_ec;
 out vec3 normal_in_ec;
 out vec2 tex_coord;
+flat out int material_index;
+
+out vec4 position_in_light_cc;
 
-out vec4 depth_map_coord;
+vec3 decodeOctahedral(vec2 encoded)
+{
+   vec3 n = vec3(encoded, 1.0f - abs( encoded.x ) - abs( encoded.y ));
+   float t = max( -n.z, 0.0f );
+   n.x += n.x >= 0.0f ? -t : t;
+   n.y += n.y >= 0.0f ? -t : t;
+   return normalize( n );
+}
 
 void main()
 {   
-   vec4 e_position = ViewMatrix * WorldMatrix * vec4(v_position, 1.0f);
-   // As ViewMatrix * WorldMatrix is rigid body transformation,
-   // transpose( inverse( ViewMatrix * WorldMatrix ) ) is equal to ViewMatrix * WorldMatrix.
+   const DrawInfo draw = Draws[gl_DrawID];
+   vec3 position = v_position * draw.PositionScale.xyz + draw.PositionBias.xyz;
+   vec3 normal = draw.PositionScale.w != 0.0f ? decodeOctahedral( v_normal.xy ) : v_normal;
+   vec4 w_position = i_to_world * vec4(position, 1.0f);
+   mat4 model_view = ViewMatrix * i_to_world;
+   vec4 e_position = ViewMatrix * w_position;
+   // As model_view is rigid body transformation with a uniform scale,
+   // transpose( inverse( model_view ) ) is equal to model_view up to the scale, which normalize() removes.
    // So it is possible to avoid the costly operation to calculate the tranformation for normals.
-   vec4 e_normal = ViewMatrix * WorldMatrix * vec4(v_normal, 0.0f);
+   vec4 e_normal = model_view * vec4(normal, 0.0f);
    position_in_ec = e_position.xyz;
    normal_in_ec = normalize( e_normal.xyz );
 
    tex_coord = v_tex_coord;
+   material_index = i_material_index;
+   position_in_light_cc = LightViewProjectionMatrix * w_position;
 
-   const float bias_for_shadow_acne = 0.005f;
-   vec4 position_in_light_cc = LightViewProjectionMatrix * WorldMatrix * vec4(v_position, 1.0f);
-   depth_map_coord.x = 0.5f * (position_in_light_cc.x + position_in_light_cc.w);
-   depth_map_coord.y = 0.5f * (position_in_light_cc.y + position_in_light_cc.w);
-   depth_map_coord.z = 0.5f * (position_in_light_cc.z + position_in_light_cc.w) - bias_for_shadow_acne * position_in_light_cc.w;
-   depth_map_coord.w = position_in_light_cc.w;
-
-   gl_Position = ModelViewProjectionMatrix * vec4(v_position, 1.0f);
+   gl_Position = ViewProjectionMatrix * w_position;
 }
\ No newline at end of file
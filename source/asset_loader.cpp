@@ -0,0 +1,248 @@
+#include "asset_loader.h"
+#include <cstring>
+
+AssetLoader::AssetLoader(int thread_num, GLsizeiptr staging_size) :
+   Stopped( false ), DecodingNum( 0 ), StagingBuffer( 0 ), StagingData( nullptr ), StagingSize( staging_size ),
+   Head( 0 ), OpenBegin( 0 )
+{
+   // Coherent writes through the mapping are visible to the copies issued after them without any flush.
+   constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+   glCreateBuffers( 1, &StagingBuffer );
+   glNamedBufferStorage( StagingBuffer, StagingSize, nullptr, flags );
+   StagingData = static_cast<uint8_t*>(glMapNamedBufferRange( StagingBuffer, 0, StagingSize, flags ));
+
+   Workers.reserve( std::max( thread_num, 1 ) );
+   for (int i = 0; i < std::max( thread_num, 1 ); ++i) Workers.emplace_back( &AssetLoader::work, this );
+}
+
+AssetLoader::~AssetLoader()
+{
+   {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Stopped = true;
+   }
+   Condition.notify_all();
+   for (auto& worker : Workers) worker.join();
+
+   for (const auto& region : Regions) glDeleteSync( region.Fence );
+   if (StagingBuffer != 0) {
+      glUnmapNamedBuffer( StagingBuffer );
+      glDeleteBuffers( 1, &StagingBuffer );
+   }
+}
+
+void AssetLoader::loadObject(
+   ObjectGL* object,
+   GLenum draw_mode,
+   const std::string& obj_file_path,
+   const std::string& texture_file_path,
+   bool is_grayscale
+)
+{
+   object->setLoadState( ObjectGL::LoadState::Pending );
+   {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Requests.push_back( { object, draw_mode, obj_file_path, texture_file_path, is_grayscale } );
+   }
+   Condition.notify_one();
+}
+
+bool AssetLoader::isIdle() const
+{
+   std::lock_guard<std::mutex> lock(Mutex);
+   return Requests.empty() && DecodingNum == 0 && Results.empty() && Copies.empty() && Regions.empty();
+}
+
+void AssetLoader::work()
+{
+   while (true) {
+      Result result;
+      {
+         std::unique_lock<std::mutex> lock(Mutex);
+         Condition.wait( lock, [this]() { return Stopped || !Requests.empty(); } );
+         if (Stopped) return;
+
+         result.Source = std::move( Requests.front() );
+         Requests.pop_front();
+         DecodingNum++;
+      }
+
+      const Request& request = result.Source;
+      result.Succeeded = request.Object->prepareMeshData( result.Mesh, request.ObjFilePath );
+      if (!result.Succeeded) std::cerr << "Could not load " << request.ObjFilePath << "\n";
+      else if (!request.TextureFilePath.empty()) {
+         result.Succeeded = ObjectGL::decodeImage( result.Image, request.TextureFilePath, request.IsGrayscale );
+         if (!result.Succeeded) std::cerr << "Could not read image file " << request.TextureFilePath << "\n";
+      }
+
+      std::lock_guard<std::mutex> lock(Mutex);
+      Results.push_back( std::move( result ) );
+      DecodingNum--;
+   }
+}
+
+void AssetLoader::startUpload(Result&& result)
+{
+   ObjectGL* object = result.Source.Object;
+   if (!result.Succeeded) {
+      object->setLoadState( ObjectGL::LoadState::Failed );
+      return;
+   }
+
+   // The buffers are created empty here and filled by the copies, which read from the result kept in Uploads.
+   object->setObject( result.Source.DrawMode, result.Mesh, false );
+   if (object->getLoadState() == ObjectGL::LoadState::Failed) {
+      std::cerr << "Could not make room for " << result.Source.ObjFilePath << " in the geometry arena\n";
+      return;
+   }
+   Uploads.push_back( std::move( result ) );
+   const ObjectGL::MeshData& mesh = Uploads.back().Mesh;
+   const ObjectGL::ImageData& image = Uploads.back().Image;
+   Copies.push_back(
+      {
+         object, static_cast<const uint8_t*>(mesh.VertexData), mesh.VertexDataSize, 0, Destination::Vertices, nullptr,
+         false
+      }
+   );
+   if (!mesh.Positions.empty()) {
+      Copies.push_back(
+         {
+            object, mesh.Positions.data(), static_cast<GLsizeiptr>(mesh.Positions.size()), 0,
+            Destination::Positions, nullptr, false
+         }
+      );
+   }
+   if (mesh.IndexDataSize > 0) {
+      Copies.push_back(
+         {
+            object, static_cast<const uint8_t*>(mesh.IndexData), mesh.IndexDataSize, 0, Destination::Indices, nullptr,
+            false
+         }
+      );
+   }
+   if (!image.Pixels.empty()) {
+      Copies.push_back(
+         {
+            object, image.Pixels.data(), static_cast<GLsizeiptr>(image.Pixels.size()), 0, Destination::Texture, &image,
+            false
+         }
+      );
+   }
+   Copies.back().IsLast = true;
+}
+
+void AssetLoader::getDestination(const Copy& copy, GLuint& buffer, GLintptr& offset)
+{
+   switch (copy.Target) {
+      case Destination::Vertices:
+         buffer = copy.Object->getVBO();
+         offset = copy.Object->getVertexBufferOffset();
+         break;
+      case Destination::Positions:
+         buffer = copy.Object->getPositionVBO();
+         offset = copy.Object->getPositionBufferOffset();
+         break;
+      case Destination::Indices:
+         buffer = copy.Object->getIBO();
+         offset = copy.Object->getIndexBufferOffset();
+         break;
+      default:
+         buffer = 0;
+         offset = 0;
+         break;
+   }
+}
+
+bool AssetLoader::allocate(GLsizeiptr min_size, GLsizeiptr max_size, GLsizeiptr& offset, GLsizeiptr& size)
+{
+   // The GPU may still read everything from the tail up to the head. The free space is [Head, StagingSize) and then
+   // [0, tail) until the head wraps around, and [Head, tail) after that.
+   GLsizeiptr end = StagingSize;
+   if (Regions.empty() && OpenBegin == Head) Head = OpenBegin = 0;
+   else {
+      const GLsizeiptr tail = Regions.empty() ? OpenBegin : Regions.front().Begin;
+      if (Head > tail && StagingSize - Head < min_size) {
+         closeRegion();
+         Head = OpenBegin = 0;
+      }
+      if (Head <= tail) end = tail;
+   }
+   if (end - Head < min_size) return false;
+
+   offset = Head;
+   size = std::min( max_size, end - Head );
+   Head = std::min( (offset + size + Alignment - 1) / Alignment * Alignment, end );
+   return true;
+}
+
+void AssetLoader::closeRegion()
+{
+   if (Head == OpenBegin && OpenCompleted.empty()) return;
+
+   Regions.push_back( { OpenBegin, Head, glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 ), std::move( OpenCompleted ) } );
+   OpenCompleted.clear();
+   OpenBegin = Head;
+}
+
+void AssetLoader::retireRegions()
+{
+   while (!Regions.empty()) {
+      const Region& region = Regions.front();
+      if (glClientWaitSync( region.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 ) == GL_TIMEOUT_EXPIRED) break;
+
+      glDeleteSync( region.Fence );
+      for (auto* object : region.Completed) object->setLoadState( ObjectGL::LoadState::Ready );
+      Regions.pop_front();
+   }
+}
+
+void AssetLoader::update()
+{
+   retireRegions();
+
+   std::deque<Result> results;
+   {
+      std::lock_guard<std::mutex> lock(Mutex);
+      results.swap( Results );
+   }
+   for (auto& result : results) startUpload( std::move( result ) );
+
+   // At most one ring of data goes through per frame, so a large mesh is spread over several frames.
+   GLsizeiptr budget = StagingSize;
+   while (!Copies.empty() && budget > 0) {
+      Copy& copy = Copies.front();
+      const GLsizeiptr remaining = copy.Size - copy.Done;
+      GLsizeiptr offset = 0, size = remaining;
+      if (copy.Image != nullptr && copy.Size > StagingSize) {
+         // An image larger than the whole ring cannot be staged at once.
+         copy.Object->addTexture( *copy.Image, copy.Source );
+      }
+      else if (copy.Image != nullptr) {
+         if (!allocate( remaining, remaining, offset, size )) break;
+
+         std::memcpy( StagingData + offset, copy.Source, size );
+         glBindBuffer( GL_PIXEL_UNPACK_BUFFER, StagingBuffer );
+         copy.Object->addTexture( *copy.Image, reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)) );
+         glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+      }
+      else {
+         if (!allocate( std::min( remaining, MinChunkSize ), remaining, offset, size )) break;
+
+         GLuint buffer;
+         GLintptr base;
+         getDestination( copy, buffer, base );
+         std::memcpy( StagingData + offset, copy.Source + copy.Done, size );
+         glCopyNamedBufferSubData( StagingBuffer, buffer, offset, base + copy.Done, size );
+      }
+      copy.Done += size;
+      budget -= size;
+      if (copy.Done < copy.Size) continue;
+
+      if (copy.IsLast) {
+         OpenCompleted.emplace_back( copy.Object );
+         Uploads.pop_front();
+      }
+      Copies.pop_front();
+   }
+   closeRegion();
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "depth_reducer.h"
+#include <cstring>
+
+DepthReducerGL::DepthReducerGL(int frame_num) :
+   Buffer( 0 ), Data( nullptr ), FrameSize( 256 ), FrameIndex( 0 ), Frames( std::max( frame_num, 1 ) ),
+   HasRange( false ), Near( 0.0f ), Far( 0.0f )
+{
+   GLint storage_alignment = 0;
+   glGetIntegerv( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment );
+   FrameSize = std::max( FrameSize, static_cast<GLsizeiptr>(storage_alignment) );
+   for (auto& frame : Frames) frame.Fence = nullptr;
+
+   // The reduction writes through the GPU, and the coherent mapping lets the CPU read it after the fence without
+   // mapping it again.
+   constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+   const GLsizeiptr size = FrameSize * static_cast<GLsizeiptr>(Frames.size());
+   glCreateBuffers( 1, &Buffer );
+   glNamedBufferStorage( Buffer, size, nullptr, flags );
+   Data = static_cast<const uint8_t*>(glMapNamedBufferRange( Buffer, 0, size, flags ));
+}
+
+DepthReducerGL::~DepthReducerGL()
+{
+   for (const auto& frame : Frames) {
+      if (frame.Fence != nullptr) glDeleteSync( frame.Fence );
+   }
+   if (Buffer != 0) {
+      glUnmapNamedBuffer( Buffer );
+      glDeleteBuffers( 1, &Buffer );
+   }
+}
+
+float DepthReducerGL::getViewDepth(float window_depth, const std::vector<float>& depth_slices)
+{
+   // Each slice is projected with its own near and far planes onto its part of the depth range.
+   const float n = depth_slices.front();
+   const float f = depth_slices.back();
+   for (size_t i = 0; i + 1 < depth_slices.size(); ++i) {
+      const float a = depth_slices[i];
+      const float b = depth_slices[i + 1];
+      const float high = (b - n) / (f - n);
+      if (window_depth > high && i + 2 < depth_slices.size()) continue;
+
+      const float low = (a - n) / (f - n);
+      const float t = glm::clamp( (window_depth - low) / (high - low), 0.0f, 1.0f );
+      return a * b / (b - t * (b - a));
+   }
+   return f;
+}
+
+void DepthReducerGL::reduce(GLuint program, GLuint depth_texture, const std::vector<float>& depth_slices)
+{
+   Frame& frame = Frames[FrameIndex];
+   if (frame.Fence != nullptr || depth_slices.size() < 2) return;
+
+   const auto offset = static_cast<GLintptr>(FrameIndex) * FrameSize;
+   const ReductionData cleared{ 0xFFFFFFFFu, 0u };
+   glClearNamedBufferSubData(
+      Buffer, GL_RG32UI, offset, sizeof( ReductionData ), GL_RG_INTEGER, GL_UNSIGNED_INT, &cleared
+   );
+   glBindBufferRange( GL_SHADER_STORAGE_BUFFER, ReductionBlockBinding, Buffer, offset, sizeof( ReductionData ) );
+
+   GLint width = 0, height = 0;
+   glGetTextureLevelParameteriv( depth_texture, 0, GL_TEXTURE_WIDTH, &width );
+   glGetTextureLevelParameteriv( depth_texture, 0, GL_TEXTURE_HEIGHT, &height );
+   constexpr GLuint pixels_per_group = WorkGroupSize * TileSize;
+   glBindTextureUnit( 0, depth_texture );
+   glUseProgram( program );
+   glDispatchCompute(
+      (static_cast<GLuint>(width) + pixels_per_group - 1) / pixels_per_group,
+      (static_cast<GLuint>(height) + pixels_per_group - 1) / pixels_per_group,
+      1
+   );
+   glMemoryBarrier( GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT );
+   frame.Fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+   frame.DepthSlices = depth_slices;
+   FrameIndex = (FrameIndex + 1) % static_cast<int>(Frames.size());
+}
+
+bool DepthReducerGL::getDepthRange(float& near, float& far)
+{
+   // The fences signal in order, so the walk from the oldest reduction stops at the first one still running.
+   for (size_t i = 0; i < Frames.size(); ++i) {
+      const int index = (FrameIndex + static_cast<int>(i)) % static_cast<int>(Frames.size());
+      Frame& frame = Frames[index];
+      if (frame.Fence == nullptr) continue;
+      const GLenum status = glClientWaitSync( frame.Fence, 0, 0 );
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+      glDeleteSync( frame.Fence );
+      frame.Fence = nullptr;
+      ReductionData result{};
+      std::memcpy( &result, Data + static_cast<GLsizeiptr>(index) * FrameSize, sizeof( ReductionData ) );
+      if (result.MinDepth > result.MaxDepth) continue;
+
+      float min_depth, max_depth;
+      std::memcpy( &min_depth, &result.MinDepth, sizeof( float ) );
+      std::memcpy( &max_depth, &result.MaxDepth, sizeof( float ) );
+      Near = getViewDepth( min_depth, frame.DepthSlices );
+      Far = getViewDepth( max_depth, frame.DepthSlices );
+      HasRange = true;
+   }
+   near = Near;
+   far = Far;
+   return HasRange;
+}
\ No newline at end of file
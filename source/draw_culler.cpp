@@ -0,0 +1,292 @@
+#include "draw_culler.h"
+
+DrawCullerGL::DrawCullerGL() :
+   CandidatesChanged( true ), CommandAlignment( 1 ), CandidateBuffer{}, CommandBuffer{}, DrawBuffer{}, CountBuffer{}
+{
+   GLint storage_alignment = 0;
+   glGetIntegerv( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment );
+   CommandAlignment = std::max( static_cast<GLuint>(storage_alignment) / static_cast<GLuint>(sizeof( DrawData )), 1u );
+
+   // Every block is bound as a whole, which an empty buffer cannot be.
+   for (Buffer* buffer : { &CandidateBuffer, &CommandBuffer, &DrawBuffer, &CountBuffer }) reserve( *buffer, 1024 );
+}
+
+DrawCullerGL::~DrawCullerGL()
+{
+   for (const Buffer* buffer : { &CandidateBuffer, &CommandBuffer, &DrawBuffer, &CountBuffer }) {
+      if (buffer->Name != 0) glDeleteBuffers( 1, &buffer->Name );
+   }
+}
+
+void DrawCullerGL::reserve(Buffer& buffer, GLsizeiptr size)
+{
+   if (size <= buffer.Size) return;
+
+   // The old contents are either uploaded again or rewritten by the next culling.
+   if (buffer.Name != 0) glDeleteBuffers( 1, &buffer.Name );
+   buffer.Size = std::max( size, buffer.Size * 2 );
+   glCreateBuffers( 1, &buffer.Name );
+   glNamedBufferStorage( buffer.Name, buffer.Size, nullptr, GL_DYNAMIC_STORAGE_BIT );
+}
+
+void DrawCullerGL::addObject(const ObjectGL* object)
+{
+   Objects.emplace_back( object );
+   ReadyObjects.emplace_back( false );
+   ObjectVersions.emplace_back( object->getGeometryVersion() );
+   InstanceCandidateNums.emplace_back( 0 );
+   MeshletCandidateNums.emplace_back( 0 );
+   CandidatesChanged = true;
+}
+
+void DrawCullerGL::setWorldBounds(Candidate& candidate, const ObjectGL::Bounds& bounds)
+{
+   candidate.BoundsMin = glm::vec4(bounds.Min, 1.0f);
+   candidate.BoundsMax = glm::vec4(bounds.Max, 1.0f);
+}
+
+void DrawCullerGL::updateCandidates()
+{
+   Candidates.clear();
+   for (size_t i = 0; i < Objects.size(); ++i) {
+      const ObjectGL* object = Objects[i];
+      ReadyObjects[i] = object->isReady();
+      ObjectVersions[i] = object->getGeometryVersion();
+      InstanceCandidateNums[i] = 0;
+      MeshletCandidateNums[i] = 0;
+      if (!ReadyObjects[i]) continue;
+
+      const std::vector<ObjectGL::Instance>& instances = object->getInstances();
+      const std::vector<ObjectGL::Bounds>& instance_bounds = object->getInstanceWorldBounds();
+      const auto instance_num = static_cast<GLuint>(object->getInstanceNum());
+      for (GLuint j = 0; j < instance_num; ++j) {
+         Candidate candidate{};
+         setWorldBounds( candidate, instance_bounds[j] );
+         candidate.Cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+         candidate.ObjectIndex = static_cast<GLuint>(i);
+         candidate.InstanceIndex = j;
+         Candidates.emplace_back( candidate );
+      }
+      InstanceCandidateNums[i] = instance_num;
+      if (!object->isDrawnAsMeshlets( 0 )) continue;
+
+      const glm::mat4 to_world = instances.empty() ? glm::mat4(1.0f) : instances.front().ToWorld;
+      const glm::mat3 to_world_normal = glm::transpose( glm::inverse( glm::mat3(to_world) ) );
+      const float scale = std::max(
+         {
+            glm::length( glm::vec3(to_world[0]) ),
+            glm::length( glm::vec3(to_world[1]) ),
+            glm::length( glm::vec3(to_world[2]) )
+         }
+      );
+      for (const auto& meshlet : object->getMeshlets()) {
+         Candidate candidate{};
+         setWorldBounds( candidate, ObjectGL::transformBounds( to_world, meshlet.BoundsMin, meshlet.BoundsMax ) );
+         candidate.Sphere = glm::vec4(glm::vec3(to_world * glm::vec4(meshlet.Center, 1.0f)), meshlet.Radius * scale);
+         candidate.Cone = glm::vec4(glm::normalize( to_world_normal * meshlet.ConeAxis ), meshlet.ConeCutoff);
+         candidate.ObjectIndex = static_cast<GLuint>(i);
+         candidate.IndexNum = meshlet.IndexNum;
+         candidate.FirstIndex = meshlet.IndexOffset;
+         Candidates.emplace_back( candidate );
+      }
+      MeshletCandidateNums[i] = static_cast<GLuint>(object->getMeshlets().size());
+   }
+
+   const auto size = static_cast<GLsizeiptr>(sizeof( Candidate ) * Candidates.size());
+   reserve( CandidateBuffer, size );
+   if (size > 0) glNamedBufferSubData( CandidateBuffer.Name, 0, size, Candidates.data() );
+   CandidatesChanged = false;
+}
+
+void DrawCullerGL::clear()
+{
+   // The capacities of the batches depend on the candidates, so they are brought up to date first.
+   bool changed = CandidatesChanged;
+   for (size_t i = 0; i < Objects.size() && !changed; ++i) {
+      changed = Objects[i]->isReady() != ReadyObjects[i] || Objects[i]->getGeometryVersion() != ObjectVersions[i];
+   }
+   if (changed) updateCandidates();
+
+   Views.clear();
+   ViewTargets.clear();
+   Draws.clear();
+   Batches.clear();
+}
+
+int DrawCullerGL::addView(const glm::mat4& view_projection, bool cull_backfaces, int list, int layer)
+{
+   if (Views.size() >= MaxViewNum) return -1;
+
+   const MeshletCuller culler(view_projection);
+   ViewData view{};
+   view.Planes = culler.getPlanes();
+   view.Eye = glm::vec4(culler.getEye(), culler.isOrthographic() ? 0.0f : 1.0f);
+   view.Flags.x = cull_backfaces ? 1 : 0;
+   Views.emplace_back( view );
+   ViewTargets.push_back( { list, layer } );
+   return static_cast<int>(Views.size()) - 1;
+}
+
+void DrawCullerGL::addDraw(
+   int view,
+   GLuint program,
+   GLuint texture,
+   const ObjectGL* object,
+   int lod,
+   bool position_only
+)
+{
+   const auto object_index = static_cast<size_t>(std::distance(
+      Objects.begin(), std::find( Objects.begin(), Objects.end(), object )
+   ));
+   if (view < 0 || object_index == Objects.size() || !ReadyObjects[object_index]) return;
+
+   const bool meshlets = object->isDrawnAsMeshlets( lod );
+   const GLuint candidate_num = meshlets ? MeshletCandidateNums[object_index] : InstanceCandidateNums[object_index];
+   const GLuint vao = position_only ? object->getPositionVAO() : object->getVAO();
+   const GLenum index_type = object->getIndexType();
+   const ViewTarget& target = ViewTargets[view];
+   auto batch = std::find_if(
+      Batches.begin(), Batches.end(), [&](const Batch& b) {
+         return b.List == target.List && b.Program == program && b.Texture == texture && b.VAO == vao &&
+            b.DrawMode == object->getDrawMode() && b.IndexType == index_type;
+      }
+   );
+   if (batch == Batches.end()) {
+      Batches.push_back( { target.List, program, texture, vao, object->getDrawMode(), index_type, 0, 0 } );
+      batch = std::prev( Batches.end() );
+   }
+   batch->Capacity += candidate_num;
+
+   const DrawElementsIndirectCommand command = object->getDrawCommand( lod, position_only );
+   const bool octahedral_normal = object->getVertexFormat().Normal == VertexFormat::NormalType::Octahedral16;
+   ObjectView entry{};
+   entry.IndexNum = command.Count;
+   entry.FirstIndex = command.FirstIndex;
+   entry.BaseVertex = command.BaseVertex;
+   entry.BaseInstance = command.BaseInstance;
+   entry.Batch = static_cast<GLuint>(std::distance( Batches.begin(), batch ));
+   entry.Mode = meshlets ? DrawMeshlets : DrawInstances;
+   entry.PositionScale = glm::vec4(object->getPositionScale(), octahedral_normal ? 1.0f : 0.0f);
+   entry.PositionBias = glm::vec4(object->getPositionBias(), static_cast<float>(target.Layer));
+   Draws.push_back( { view, object_index, entry } );
+}
+
+bool DrawCullerGL::cull(GLuint program, UniformRingGL* ring)
+{
+   // Each batch starts where the range of its DrawBlock entries can be bound.
+   GLuint command_num = 0;
+   for (auto& batch : Batches) {
+      batch.CommandOffset = (command_num + CommandAlignment - 1) / CommandAlignment * CommandAlignment;
+      command_num = batch.CommandOffset + batch.Capacity;
+   }
+   reserve( CommandBuffer, static_cast<GLsizeiptr>(sizeof( DrawElementsIndirectCommand ) * command_num) );
+   reserve( DrawBuffer, static_cast<GLsizeiptr>(sizeof( DrawData ) * command_num) );
+   const auto count_size = static_cast<GLsizeiptr>(sizeof( GLuint ) * (MaxViewNum + Batches.size()));
+   reserve( CountBuffer, count_size );
+   if (Batches.empty()) return true;
+
+   glClearNamedBufferSubData( CountBuffer.Name, GL_R32UI, 0, count_size, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr );
+   if (Candidates.empty()) return true;
+
+   ObjectViews.assign( Objects.size() * Views.size(), ObjectView{} );
+   for (const auto& draw : Draws) {
+      ObjectView& entry = ObjectViews[draw.ObjectIndex * Views.size() + draw.View];
+      entry = draw.Entry;
+      entry.CommandOffset = Batches[entry.Batch].CommandOffset;
+   }
+
+   ViewBlockData view_block{};
+   std::copy( Views.begin(), Views.end(), view_block.Views.begin() );
+   view_block.ViewNum = static_cast<GLuint>(Views.size());
+   view_block.CandidateNum = static_cast<GLuint>(Candidates.size());
+   if (!ring->bind( GL_UNIFORM_BUFFER, ViewBlockBinding, &view_block, sizeof( ViewBlockData ) ) ||
+       !ring->bind(
+          GL_SHADER_STORAGE_BUFFER, ObjectViewBlockBinding, ObjectViews.data(),
+          static_cast<GLsizeiptr>(sizeof( ObjectView ) * ObjectViews.size())
+       )) return false;
+
+   glBindBufferBase( GL_SHADER_STORAGE_BUFFER, CandidateBlockBinding, CandidateBuffer.Name );
+   glBindBufferBase( GL_SHADER_STORAGE_BUFFER, CommandBlockBinding, CommandBuffer.Name );
+   glBindBufferBase( GL_SHADER_STORAGE_BUFFER, CulledDrawBlockBinding, DrawBuffer.Name );
+   glBindBufferBase( GL_SHADER_STORAGE_BUFFER, CountBlockBinding, CountBuffer.Name );
+   glUseProgram( program );
+   glDispatchCompute(
+      (view_block.CandidateNum + WorkGroupSize - 1) / WorkGroupSize, view_block.ViewNum, 1
+   );
+   // The commands and counts are read as draw parameters, and the entries of DrawBlock by the vertex shaders.
+   glMemoryBarrier( GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+   return true;
+}
+
+void DrawCullerGL::submit(int list) const
+{
+   glBindBuffer( GL_DRAW_INDIRECT_BUFFER, CommandBuffer.Name );
+   glBindBuffer( GL_PARAMETER_BUFFER, CountBuffer.Name );
+   GLuint program = 0;
+   for (size_t i = 0; i < Batches.size(); ++i) {
+      const Batch& batch = Batches[i];
+      if (batch.List != list || batch.Capacity == 0) continue;
+
+      if (batch.Program != program) {
+         program = batch.Program;
+         glUseProgram( program );
+      }
+      if (batch.Texture != 0) glBindTextureUnit( 0, batch.Texture );
+      glBindVertexArray( batch.VAO );
+      glBindBufferRange(
+         GL_SHADER_STORAGE_BUFFER, DrawListGL::DrawBlockBinding, DrawBuffer.Name,
+         static_cast<GLintptr>(sizeof( DrawData ) * batch.CommandOffset),
+         static_cast<GLsizeiptr>(sizeof( DrawData ) * batch.Capacity)
+      );
+      glMultiDrawElementsIndirectCount(
+         batch.DrawMode,
+         batch.IndexType,
+         reinterpret_cast<const void*>(sizeof( DrawElementsIndirectCommand ) * batch.CommandOffset),
+         static_cast<GLintptr>(sizeof( GLuint ) * (MaxViewNum + i)),
+         static_cast<GLsizei>(batch.Capacity),
+         0
+      );
+   }
+}
+
+void DrawCullerGL::printStatistics() const
+{
+   // The counts of the views come before the ones of the batches.
+   std::vector<GLuint> view_counts(MaxViewNum, 0), counts(Batches.size(), 0);
+   if (!counts.empty()) {
+      glGetNamedBufferSubData(
+         CountBuffer.Name, 0, static_cast<GLsizeiptr>(sizeof( GLuint ) * MaxViewNum), view_counts.data()
+      );
+      glGetNamedBufferSubData(
+         CountBuffer.Name, static_cast<GLintptr>(sizeof( GLuint ) * MaxViewNum),
+         static_cast<GLsizeiptr>(sizeof( GLuint ) * counts.size()), counts.data()
+      );
+   }
+
+   std::stringstream text;
+   text << "GPU culling of " << Candidates.size() << " candidates\n";
+   std::vector<int> lists;
+   for (const auto& target : ViewTargets) {
+      if (std::find( lists.begin(), lists.end(), target.List ) == lists.end()) lists.emplace_back( target.List );
+   }
+   for (const int list : lists) {
+      GLuint tested = 0, drawn = 0, batch_num = 0;
+      for (size_t i = 0; i < Batches.size(); ++i) {
+         if (Batches[i].List != list) continue;
+         tested += Batches[i].Capacity;
+         drawn += counts[i];
+         batch_num++;
+      }
+      const auto view_num = std::count_if(
+         ViewTargets.begin(), ViewTargets.end(), [list](const ViewTarget& target) { return target.List == list; }
+      );
+      text << " - list " << list << " of " << view_num << " views: " << drawn << " of " << tested << " commands in "
+         << batch_num << " multi-draws\n";
+      for (size_t i = 0; i < ViewTargets.size(); ++i) {
+         if (ViewTargets[i].List != list) continue;
+         text << "    view " << i << " to layer " << ViewTargets[i].Layer << ": " << view_counts[i] << " commands\n";
+      }
+   }
+   std::cout << text.str();
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "draw_list.h"
+
+void DrawListGL::clear()
+{
+   for (auto& batch : Batches) {
+      batch.Commands.clear();
+      batch.Draws.clear();
+   }
+   LayerInstanceNums.clear();
+}
+
+void DrawListGL::addObject(
+   GLuint program,
+   GLuint texture,
+   ObjectGL* object,
+   const glm::mat4& world_to_clip,
+   bool cull_backfaces,
+   int lod,
+   bool position_only,
+   int layer
+)
+{
+   const GLuint vao = position_only ? object->getPositionVAO() : object->getVAO();
+   const GLenum index_type = object->getIndexType();
+   auto batch = std::find_if(
+      Batches.begin(), Batches.end(), [&](const Batch& b) {
+         return b.Program == program && b.Texture == texture && b.VAO == vao &&
+            b.DrawMode == object->getDrawMode() && b.IndexType == index_type;
+      }
+   );
+   if (batch == Batches.end()) {
+      Batches.push_back( { program, texture, vao, object->getDrawMode(), index_type, {}, {} } );
+      batch = std::prev( Batches.end() );
+   }
+
+   object->appendDrawCommands( batch->Commands, world_to_clip, cull_backfaces, lod, position_only );
+   if (static_cast<int>(LayerInstanceNums.size()) <= layer) LayerInstanceNums.resize( layer + 1, 0 );
+   if (layer >= 0) LayerInstanceNums[layer] += object->getVisibleInstanceNum();
+   const bool octahedral_normal = object->getVertexFormat().Normal == VertexFormat::NormalType::Octahedral16;
+   const DrawData data{
+      glm::vec4(object->getPositionScale(), octahedral_normal ? 1.0f : 0.0f),
+      glm::vec4(object->getPositionBias(), static_cast<float>(layer))
+   };
+   batch->Draws.resize( batch->Commands.size(), data );
+}
+
+bool DrawListGL::submit(UniformRingGL* ring) const
+{
+   bool submitted = true;
+   GLuint program = 0;
+   for (const auto& batch : Batches) {
+      if (batch.Commands.empty()) continue;
+
+      GLintptr command_offset;
+      const auto command_size = static_cast<GLsizeiptr>(sizeof( DrawElementsIndirectCommand ) * batch.Commands.size());
+      const auto draw_size = static_cast<GLsizeiptr>(sizeof( DrawData ) * batch.Draws.size());
+      if (!ring->write( batch.Commands.data(), command_size, command_offset ) ||
+          !ring->bind( GL_SHADER_STORAGE_BUFFER, DrawBlockBinding, batch.Draws.data(), draw_size )) {
+         submitted = false;
+         continue;
+      }
+
+      if (batch.Program != program) {
+         program = batch.Program;
+         glUseProgram( program );
+      }
+      if (batch.Texture != 0) glBindTextureUnit( 0, batch.Texture );
+      glBindVertexArray( batch.VAO );
+      glBindBuffer( GL_DRAW_INDIRECT_BUFFER, ring->getBuffer() );
+      glMultiDrawElementsIndirect(
+         batch.DrawMode,
+         batch.IndexType,
+         reinterpret_cast<const void*>(static_cast<uintptr_t>(command_offset)),
+         static_cast<GLsizei>(batch.Commands.size()),
+         0
+      );
+   }
+   return submitted;
+}
+
+size_t DrawListGL::getBatchNum() const
+{
+   return static_cast<size_t>(std::count_if(
+      Batches.begin(), Batches.end(), [](const Batch& batch) { return !batch.Commands.empty(); }
+   ));
+}
+
+size_t DrawListGL::getCommandNum() const
+{
+   size_t command_num = 0;
+   for (const auto& batch : Batches) command_num += batch.Commands.size();
+   return command_num;
+}
+
+size_t DrawListGL::getInstanceNum(int layer) const
+{
+   return layer >= 0 && layer < static_cast<int>(LayerInstanceNums.size()) ? LayerInstanceNums[layer] : 0;
+}
\ No newline at end of file
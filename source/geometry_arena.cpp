@@ -0,0 +1,182 @@
+#include "geometry_arena.h"
+
+FreeListAllocator::FreeListAllocator(GLsizeiptr capacity) : Capacity( capacity ), UsedSize( 0 )
+{
+   if (Capacity > 0) FreeBlocks[0] = Capacity;
+}
+
+bool FreeListAllocator::allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+{
+   alignment = std::max( alignment, static_cast<GLsizeiptr>(1) );
+   for (auto it = FreeBlocks.begin(); it != FreeBlocks.end(); ++it) {
+      const GLintptr begin = it->first;
+      const GLintptr end = it->first + it->second;
+      const GLintptr aligned = (begin + alignment - 1) / alignment * alignment;
+      if (aligned + size > end) continue;
+
+      // The padding in front stays free, and so does whatever is left behind.
+      FreeBlocks.erase( it );
+      if (aligned > begin) FreeBlocks[begin] = aligned - begin;
+      if (aligned + size < end) FreeBlocks[aligned + size] = end - (aligned + size);
+      UsedSize += size;
+      offset = aligned;
+      return true;
+   }
+   return false;
+}
+
+void FreeListAllocator::release(GLintptr offset, GLsizeiptr size)
+{
+   if (size <= 0) return;
+
+   GLintptr begin = offset;
+   GLsizeiptr merged_size = size;
+   auto next = FreeBlocks.lower_bound( offset );
+   if (next != FreeBlocks.end() && next->first == offset + size) {
+      merged_size += next->second;
+      next = FreeBlocks.erase( next );
+   }
+   if (next != FreeBlocks.begin()) {
+      auto previous = std::prev( next );
+      if (previous->first + previous->second == offset) {
+         begin = previous->first;
+         merged_size += previous->second;
+         FreeBlocks.erase( previous );
+      }
+   }
+   FreeBlocks[begin] = merged_size;
+   UsedSize -= size;
+}
+
+void FreeListAllocator::grow(GLsizeiptr capacity)
+{
+   if (capacity <= Capacity) return;
+
+   const GLintptr old_end = Capacity;
+   Capacity = capacity;
+   UsedSize += capacity - old_end;
+   release( old_end, capacity - old_end );
+}
+
+GLsizeiptr FreeListAllocator::getLargestFreeBlock() const
+{
+   GLsizeiptr largest = 0;
+   for (const auto& block : FreeBlocks) largest = std::max( largest, block.second );
+   return largest;
+}
+
+GeometryArenaGL::GeometryArenaGL(
+   GLsizeiptr vertex_buffer_size,
+   GLsizeiptr index_buffer_size,
+   GLsizeiptr instance_buffer_size
+) :
+   Buffers{}, Allocators{
+      FreeListAllocator( vertex_buffer_size ),
+      FreeListAllocator( index_buffer_size ),
+      FreeListAllocator( instance_buffer_size )
+   }, GrowthNum{}
+{
+   createBuffer( VertexBuffer, vertex_buffer_size );
+   createBuffer( IndexBuffer, index_buffer_size );
+   createBuffer( InstanceBuffer, instance_buffer_size );
+}
+
+GeometryArenaGL::~GeometryArenaGL()
+{
+   for (const auto& vertex_array : VertexArrays) glDeleteVertexArrays( 1, &vertex_array.second.Name );
+   for (const auto& buffer : Buffers) {
+      if (buffer != 0) glDeleteBuffers( 1, &buffer );
+   }
+}
+
+void GeometryArenaGL::createBuffer(BufferType type, GLsizeiptr size)
+{
+   glCreateBuffers( 1, &Buffers[type] );
+   glNamedBufferStorage( Buffers[type], size, nullptr, GL_DYNAMIC_STORAGE_BIT );
+}
+
+void GeometryArenaGL::grow(BufferType type, GLsizeiptr min_size)
+{
+   FreeListAllocator& allocator = Allocators[type];
+   GLsizeiptr capacity = std::max( allocator.getCapacity(), static_cast<GLsizeiptr>(1) );
+   while (capacity - allocator.getCapacity() < min_size) capacity *= 2;
+
+   // The copy keeps every offset, so only the VAOs have to be pointed at the new buffer.
+   const GLuint old_buffer = Buffers[type];
+   createBuffer( type, capacity );
+   glCopyNamedBufferSubData( old_buffer, Buffers[type], 0, 0, allocator.getCapacity() );
+   glDeleteBuffers( 1, &old_buffer );
+   allocator.grow( capacity );
+   GrowthNum[type]++;
+   for (const auto& vertex_array : VertexArrays) bindBuffers( vertex_array.second );
+}
+
+bool GeometryArenaGL::allocate(BufferType type, GLsizeiptr size, GLsizeiptr alignment, Range& range)
+{
+   range = Range();
+   if (size <= 0) return true;
+
+   if (!Allocators[type].allocate( size, alignment, range.Offset )) {
+      grow( type, size + alignment );
+      if (!Allocators[type].allocate( size, alignment, range.Offset )) {
+         std::cerr << "Could not allocate " << size << " bytes from a geometry buffer of "
+            << Allocators[type].getCapacity() << " bytes\n";
+         range = Range();
+         return false;
+      }
+   }
+   range.Size = size;
+   return true;
+}
+
+void GeometryArenaGL::release(BufferType type, Range& range)
+{
+   Allocators[type].release( range.Offset, range.Size );
+   range = Range();
+}
+
+void GeometryArenaGL::bindBuffers(const VertexArray& vertex_array) const
+{
+   glVertexArrayVertexBuffer( vertex_array.Name, 0, Buffers[VertexBuffer], 0, vertex_array.Stride );
+   glVertexArrayVertexBuffer( vertex_array.Name, 1, Buffers[InstanceBuffer], 0, vertex_array.InstanceStride );
+   glVertexArrayBindingDivisor( vertex_array.Name, 1, 1 );
+   glVertexArrayElementBuffer( vertex_array.Name, Buffers[IndexBuffer] );
+}
+
+GLuint GeometryArenaGL::getVertexArray(uint32_t layout_key, GLsizei stride, GLsizei instance_stride)
+{
+   const auto it = VertexArrays.find( layout_key );
+   if (it != VertexArrays.end()) {
+      assert( it->second.Stride == stride && it->second.InstanceStride == instance_stride );
+      return it->second.Name;
+   }
+
+   VertexArray vertex_array{ 0, stride, instance_stride };
+   glCreateVertexArrays( 1, &vertex_array.Name );
+   bindBuffers( vertex_array );
+   VertexArrays[layout_key] = vertex_array;
+   return vertex_array.Name;
+}
+
+void GeometryArenaGL::printStatistics() const
+{
+   constexpr std::array<const char*, BufferTypeNum> names = { "vertex", "index", "instance" };
+   std::stringstream text;
+   text << std::fixed << std::setprecision( 1 );
+   text << "Geometry arena (" << VertexArrays.size() << " vertex layouts)\n";
+   for (int i = 0; i < BufferTypeNum; ++i) {
+      const FreeListAllocator& allocator = Allocators[i];
+      const GLsizeiptr free_size = allocator.getCapacity() - allocator.getUsedSize();
+      // The share of the free space that a single allocation cannot use, 0% if it is all in one block.
+      const double fragmentation = free_size > 0 ?
+         100.0 * (1.0 - static_cast<double>(allocator.getLargestFreeBlock()) / static_cast<double>(free_size)) : 0.0;
+      text << " - " << std::left << std::setw( 8 ) << names[i] << std::right
+         << std::setw( 9 ) << static_cast<double>(allocator.getUsedSize()) / 1024.0 << " / "
+         << static_cast<double>(allocator.getCapacity()) / 1024.0 << " KB used ("
+         << 100.0 * static_cast<double>(allocator.getUsedSize()) / static_cast<double>(allocator.getCapacity())
+         << "%), " << allocator.getFreeBlockNum() << " free blocks, largest "
+         << static_cast<double>(allocator.getLargestFreeBlock()) / 1024.0 << " KB, fragmentation "
+         << fragmentation << "%, grown " << GrowthNum[i] << " times\n";
+   }
+   std::cout << text.str();
+}
\ No newline at end of file
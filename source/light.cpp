@@ -1,10 +1,16 @@
 #include "light.h"
 
 LightGL::LightGL() :
-   TurnLightOn( true ), GlobalAmbientColor( 0.2f, 0.2f, 0.2f, 1.0f ), TotalLightNum( 0 )
+   TurnLightOn( true ), LightBufferDirty( true ), LightBuffer( 0 ), LightBufferViewMatrix( 1.0f ),
+   GlobalAmbientColor( 0.2f, 0.2f, 0.2f, 1.0f ), TotalLightNum( 0 )
 {
 }
 
+LightGL::~LightGL()
+{
+   if (LightBuffer != 0) glDeleteBuffers( 1, &LightBuffer );
+}
+
 bool LightGL::isLightOn() const
 {
    return TurnLightOn;
@@ -26,6 +32,11 @@ void LightGL::addLight(
    float falloff_radius
 )
 {
+   if (TotalLightNum >= MaxLightNum) {
+      std::cerr << "Could not add more than " << MaxLightNum << " lights\n";
+      return;
+   }
+
    Positions.emplace_back( light_position );
 
    AmbientColors.emplace_back( ambient_color );
@@ -40,6 +51,7 @@ void LightGL::addLight(
    IsActivated.emplace_back( true );
 
    TotalLightNum = static_cast<int>(Positions.size());
+   LightBufferDirty = true;
 }
 
 void LightGL::activateLight(const int& light_index)
@@ -54,21 +66,33 @@ void LightGL::deactivateLight(const int& light_index)
    IsActivated[light_index] = false;
 }
 
-void LightGL::transferUniformsToShader(const ShaderGL* shader)
+void LightGL::updateLightBuffer(const glm::mat4& view_matrix)
 {
-   glUniform1i( shader->getLightAvailabilityLocation(), TurnLightOn ? 1 : 0 );
-   glUniform1i( shader->getLightNumLocation(), static_cast<GLint>(TotalLightNum) );
-   glUniform4fv( shader->getGlobalAmbientLocation(), 1, &GlobalAmbientColor[0] );
+   if (LightBuffer == 0) {
+      glCreateBuffers( 1, &LightBuffer );
+      glNamedBufferStorage( LightBuffer, sizeof( LightBlock ), nullptr, GL_DYNAMIC_STORAGE_BIT );
+      glBindBufferBase( GL_UNIFORM_BUFFER, LightBlockBinding, LightBuffer );
+   }
+   if (!LightBufferDirty && view_matrix == LightBufferViewMatrix) return;
 
+   LightBlock block{};
+   block.GlobalAmbient = GlobalAmbientColor;
+   block.LightNum = TotalLightNum;
+   const glm::mat3 normal_matrix = glm::transpose( glm::inverse( glm::mat3(view_matrix) ) );
    for (int i = 0; i < TotalLightNum; ++i) {
-      glUniform1i( shader->getLightSwitchLocation( i ), IsActivated[0] ? 1 : 0 );
-      glUniform4fv( shader->getLightPositionLocation( i ), 1, &Positions[i][0] );
-      glUniform4fv( shader->getLightAmbientLocation( i ), 1, &AmbientColors[i][0] );
-      glUniform4fv( shader->getLightDiffuseLocation( i ), 1, &DiffuseColors[i][0] );
-      glUniform4fv( shader->getLightSpecularLocation( i ), 1, &SpecularColors[i][0] );
-      glUniform3fv( shader->getLightSpotlightDirectionLocation( i ), 1, &SpotlightDirections[i][0] );
-      glUniform1f( shader->getLightSpotlightCutoffAngleLocation( i ), SpotlightCutoffAngles[i] );
-      glUniform1f( shader->getLightSpotlightFeatherLocation( i ), SpotlightFeathers[i] );
-      glUniform1f( shader->getLightFallOffRadiusLocation( i ), FallOffRadii[i] );
+      LightData& light = block.Lights[i];
+      light.Position = view_matrix * Positions[i];
+      light.AmbientColor = AmbientColors[i];
+      light.DiffuseColor = DiffuseColors[i];
+      light.SpecularColor = SpecularColors[i];
+      light.SpotlightDirection = glm::vec4(glm::normalize( normal_matrix * SpotlightDirections[i] ), 0.0f);
+      light.SpotlightCutoffAngle = SpotlightCutoffAngles[i];
+      light.SpotlightFeather = SpotlightFeathers[i];
+      light.FallOffRadius = FallOffRadii[i];
    }
+   // Only the lights in use go to the GPU.
+   const auto size = static_cast<GLsizeiptr>(offsetof( LightBlock, Lights ) + TotalLightNum * sizeof( LightData ));
+   glNamedBufferSubData( LightBuffer, 0, size, &block );
+   LightBufferViewMatrix = view_matrix;
+   LightBufferDirty = false;
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& file_path) :
+   Opened( false ), Data( nullptr ), Size( 0 ), FileHandle( INVALID_HANDLE_VALUE ), MappingHandle( nullptr )
+{
+   FileHandle = CreateFileA(
+      file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+   );
+   if (FileHandle == INVALID_HANDLE_VALUE) return;
+
+   LARGE_INTEGER file_size;
+   if (!GetFileSizeEx( FileHandle, &file_size )) return;
+
+   Size = static_cast<size_t>(file_size.QuadPart);
+   Opened = true;
+   if (Size == 0) return;
+
+   MappingHandle = CreateFileMappingA( FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+   if (MappingHandle == nullptr) {
+      Opened = false;
+      return;
+   }
+   Data = static_cast<const char*>(MapViewOfFile( MappingHandle, FILE_MAP_READ, 0, 0, 0 ));
+   if (Data == nullptr) Opened = false;
+}
+
+MappedFile::~MappedFile()
+{
+   if (Data != nullptr) UnmapViewOfFile( Data );
+   if (MappingHandle != nullptr) CloseHandle( MappingHandle );
+   if (FileHandle != INVALID_HANDLE_VALUE) CloseHandle( FileHandle );
+}
+#else
+MappedFile::MappedFile(const std::string& file_path) :
+   Opened( false ), Data( nullptr ), Size( 0 ), FileDescriptor( -1 )
+{
+   FileDescriptor = open( file_path.c_str(), O_RDONLY );
+   if (FileDescriptor < 0) return;
+
+   struct stat file_status{};
+   if (fstat( FileDescriptor, &file_status ) != 0) return;
+
+   Size = static_cast<size_t>(file_status.st_size);
+   Opened = true;
+   if (Size == 0) return;
+
+   void* data = mmap( nullptr, Size, PROT_READ, MAP_PRIVATE, FileDescriptor, 0 );
+   if (data == MAP_FAILED) {
+      Opened = false;
+      return;
+   }
+   // The readers walk the file front to back, so let the kernel read ahead aggressively.
+   madvise( data, Size, MADV_SEQUENTIAL );
+   Data = static_cast<const char*>(data);
+}
+
+MappedFile::~MappedFile()
+{
+   if (Data != nullptr) munmap( const_cast<char*>(Data), Size );
+   if (FileDescriptor >= 0) close( FileDescriptor );
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include "material.h"
+
+MaterialLibraryGL::MaterialLibraryGL() : Buffer( 0 ), MaterialNum( 0 )
+{
+   // The std140 stride of an array of materials is their size, as it is a multiple of 16 bytes.
+   glCreateBuffers( 1, &Buffer );
+   glNamedBufferStorage( Buffer, sizeof( Material ) * MaxMaterialNum, nullptr, GL_DYNAMIC_STORAGE_BIT );
+   glBindBufferBase( GL_UNIFORM_BUFFER, MaterialBlockBinding, Buffer );
+}
+
+MaterialLibraryGL::~MaterialLibraryGL()
+{
+   if (Buffer != 0) glDeleteBuffers( 1, &Buffer );
+}
+
+int MaterialLibraryGL::addMaterial(const Material& material)
+{
+   if (MaterialNum >= MaxMaterialNum) {
+      std::cerr << "Could not add more than " << MaxMaterialNum << " materials\n";
+      return -1;
+   }
+
+   glNamedBufferSubData( Buffer, sizeof( Material ) * MaterialNum, sizeof( Material ), &material );
+   return MaterialNum++;
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "mesh_cache.h"
+#include "obj_reader.h"
+#include "mesh_optimizer.h"
+#include <cstring>
+
+MeshCache::MeshCache(const std::string& file_path) :
+   Valid( false ), File( std::make_unique<MappedFile>( file_path ) )
+{
+   if (!File->isOpen() || File->size() < sizeof( Header )) return;
+
+   const Header& header = getHeader();
+   if (std::memcmp( header.Magic, Magic, sizeof( Magic ) ) != 0 || header.Version != Version) return;
+   if (header.IndexSize != 0 && header.IndexSize != 2 && header.IndexSize != 4) return;
+
+   const uint64_t vertex_data_end = header.VertexDataOffset + header.VertexNum * header.VertexStride;
+   const uint64_t index_data_end = header.IndexDataOffset + header.IndexNum * header.IndexSize;
+   const uint64_t lod_data_end = header.LodDataOffset + header.LodNum * sizeof( LevelOfDetail );
+   if (vertex_data_end > File->size() || index_data_end > File->size()) return;
+   if (header.LodNum > 0 && lod_data_end > File->size()) return;
+
+   const LevelOfDetail* lods = getLods();
+   for (uint32_t i = 0; i < header.LodNum; ++i) {
+      if (lods[i].IndexOffset + lods[i].IndexNum > header.IndexNum) return;
+   }
+   Valid = true;
+}
+
+bool MeshCache::isUpToDate(const std::string& cache_path, const std::string& source_path)
+{
+   std::error_code error;
+   const auto cache_time = std::filesystem::last_write_time( cache_path, error );
+   if (error) return false;
+   const auto source_time = std::filesystem::last_write_time( source_path, error );
+   return !error && cache_time >= source_time;
+}
+
+void MeshCache::interleave(
+   std::vector<float>& data,
+   uint32_t& layout_flags,
+   const std::vector<glm::vec3>& vertices,
+   const std::vector<glm::vec3>& normals,
+   const std::vector<glm::vec2>& textures
+)
+{
+   const bool normals_exist = !normals.empty();
+   const bool textures_exist = !textures.empty();
+   layout_flags = (normals_exist ? HasNormals : 0u) | (textures_exist ? HasTextures : 0u);
+
+   data.resize( vertices.size() * getVertexStride( layout_flags ) / sizeof( float ) );
+   float* ptr = data.data();
+   for (size_t i = 0; i < vertices.size(); ++i) {
+      *ptr++ = vertices[i].x;
+      *ptr++ = vertices[i].y;
+      *ptr++ = vertices[i].z;
+      if (normals_exist) {
+         *ptr++ = normals[i].x;
+         *ptr++ = normals[i].y;
+         *ptr++ = normals[i].z;
+      }
+      if (textures_exist) {
+         *ptr++ = textures[i].x;
+         *ptr++ = textures[i].y;
+      }
+   }
+}
+
+void MeshCache::getBounds(glm::vec3& bounds_min, glm::vec3& bounds_max, const float* data, size_t vertex_num, size_t stride)
+{
+   bounds_min = glm::vec3(std::numeric_limits<float>::max());
+   bounds_max = glm::vec3(std::numeric_limits<float>::lowest());
+   const size_t step = stride / sizeof( float );
+   for (size_t i = 0; i < vertex_num; ++i) {
+      const glm::vec3 position(data[i * step], data[i * step + 1], data[i * step + 2]);
+      bounds_min = glm::min( bounds_min, position );
+      bounds_max = glm::max( bounds_max, position );
+   }
+}
+
+bool MeshCache::write(
+   const std::string& cache_path,
+   Header header,
+   const void* vertex_data,
+   const void* index_data,
+   const LevelOfDetail* lods
+)
+{
+   std::memcpy( header.Magic, Magic, sizeof( Magic ) );
+   header.Version = Version;
+   if (index_data == nullptr) {
+      header.IndexNum = 0;
+      header.IndexSize = 0;
+   }
+   if (index_data == nullptr || lods == nullptr) header.LodNum = 0;
+   const uint64_t vertex_data_size = header.VertexNum * header.VertexStride;
+   const uint64_t index_data_size = header.IndexNum * header.IndexSize;
+   header.VertexDataOffset = alignOffset( sizeof( Header ) );
+   header.IndexDataOffset = alignOffset( header.VertexDataOffset + vertex_data_size );
+   header.LodDataOffset = alignOffset( header.IndexDataOffset + index_data_size );
+
+   // Write next to the destination and rename it, so that a reader never maps a half-written file.
+   const std::string temporary_path = cache_path + ".tmp";
+   std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+   if (!file.is_open()) return false;
+
+   constexpr char padding[16] = {};
+   file.write( reinterpret_cast<const char*>(&header), sizeof( Header ) );
+   file.write( padding, static_cast<std::streamsize>(header.VertexDataOffset - sizeof( Header )) );
+   file.write( static_cast<const char*>(vertex_data), static_cast<std::streamsize>(vertex_data_size) );
+   if (header.IndexNum > 0) {
+      const uint64_t vertex_data_end = header.VertexDataOffset + vertex_data_size;
+      file.write( padding, static_cast<std::streamsize>(header.IndexDataOffset - vertex_data_end) );
+      file.write( static_cast<const char*>(index_data), static_cast<std::streamsize>(index_data_size) );
+   }
+   if (header.LodNum > 0) {
+      const uint64_t index_data_end = header.IndexDataOffset + index_data_size;
+      file.write( padding, static_cast<std::streamsize>(header.LodDataOffset - index_data_end) );
+      file.write( reinterpret_cast<const char*>(lods), static_cast<std::streamsize>(header.LodNum * sizeof( LevelOfDetail )) );
+   }
+   file.close();
+   if (!file) return false;
+
+   std::error_code error;
+   std::filesystem::rename( temporary_path, cache_path, error );
+   if (error) {
+      std::error_code ignored;
+      std::filesystem::remove( temporary_path, ignored );
+      return false;
+   }
+   return true;
+}
+
+void MeshCache::buildLods(
+   std::vector<uint32_t>& indices,
+   std::vector<LevelOfDetail>& lods,
+   const std::vector<float>& vertex_data,
+   size_t floats_per_vertex
+)
+{
+   // Each level simplifies the previous one, and the destinations carry every vertex of the original mesh along
+   // the chain, so the error of each level is measured against the original mesh.
+   const size_t vertex_num = vertex_data.size() / floats_per_vertex;
+   lods.clear();
+   lods.push_back( { 0, indices.size(), 0.0f, 0 } );
+   std::vector<uint32_t> previous(indices), simplified, destinations;
+   while (static_cast<int>(lods.size()) < MaxLodNum) {
+      const size_t target_index_num = previous.size() / 6 * 3;
+      if (target_index_num / 3 < MinLodTriangleNum) break;
+
+      const float error = MeshOptimizer::simplify(
+         simplified, destinations, previous, vertex_data, floats_per_vertex, target_index_num
+      );
+      if (simplified.size() * 10 > previous.size() * 9) break;
+
+      MeshOptimizer::optimizeVertexCache( simplified, vertex_num );
+      lods.push_back( { indices.size(), simplified.size(), error, 0 } );
+      indices.insert( indices.end(), simplified.begin(), simplified.end() );
+      previous.swap( simplified );
+   }
+}
+
+bool MeshCache::build(
+   std::vector<float>& vertex_data,
+   std::vector<uint32_t>& indices,
+   std::vector<LevelOfDetail>& lods,
+   uint32_t& layout_flags,
+   const std::string& obj_file_path,
+   bool optimize,
+   bool simplify
+)
+{
+   std::vector<glm::vec3> vertices, normals;
+   std::vector<glm::vec2> textures;
+   ObjReader reader;
+   if (!reader.read( obj_file_path )) return false;
+   reader.getTriangles( vertices, normals, textures );
+
+   std::vector<float> triangles;
+   interleave( triangles, layout_flags, vertices, normals, textures );
+   const size_t floats_per_vertex = getVertexStride( layout_flags ) / sizeof( float );
+   MeshOptimizer::weld( vertex_data, indices, triangles, floats_per_vertex );
+   lods.clear();
+   if (!optimize && !simplify) return true;
+
+   std::stringstream report;
+   report << std::fixed << std::setprecision( 3 );
+   const size_t vertex_num = vertex_data.size() / floats_per_vertex;
+   if (optimize) {
+      const MeshOptimizer::VertexCacheStatistics before = MeshOptimizer::analyzeVertexCache( indices, vertex_num );
+      MeshOptimizer::optimizeVertexCache( indices, vertex_num );
+      MeshOptimizer::optimizeOverdraw( indices, vertex_data, floats_per_vertex );
+      const MeshOptimizer::VertexCacheStatistics after = MeshOptimizer::analyzeVertexCache( indices, vertex_num );
+      report << "Optimized " << obj_file_path
+         << ": ACMR " << before.ACMR << " -> " << after.ACMR << ", ATVR " << before.ATVR << " -> " << after.ATVR << "\n";
+   }
+   if (simplify) {
+      buildLods( indices, lods, vertex_data, floats_per_vertex );
+      report << "Simplified " << obj_file_path << ":" << std::scientific << std::setprecision( 2 );
+      for (size_t i = 0; i < lods.size(); ++i) {
+         report << (i == 0 ? " " : ", ") << lods[i].IndexNum / 3 << " triangles (error " << lods[i].Error << ")";
+      }
+      report << "\n";
+   }
+   // After simplification, so that every level is remapped with the vertices.
+   if (optimize) MeshOptimizer::optimizeVertexFetch( vertex_data, indices, floats_per_vertex );
+   std::cout << report.str();
+   return true;
+}
+
+bool MeshCache::convert(
+   const std::string& obj_file_path,
+   const std::string& cache_path,
+   bool optimize,
+   bool simplify,
+   const VertexFormat& format
+)
+{
+   uint32_t layout_flags = 0;
+   std::vector<float> vertex_data;
+   std::vector<uint32_t> indices;
+   std::vector<LevelOfDetail> lods;
+   if (!build( vertex_data, indices, lods, layout_flags, obj_file_path, optimize, simplify )) return false;
+
+   const bool normals_exist = (layout_flags & HasNormals) != 0;
+   const bool textures_exist = (layout_flags & HasTextures) != 0;
+   Header header{};
+   header.LayoutFlags = layout_flags;
+   header.VertexStride = format.getStride( normals_exist, textures_exist );
+   header.VertexNum = vertex_data.size() * sizeof( float ) / getVertexStride( layout_flags );
+   header.IndexNum = indices.size();
+   header.IndexSize = getIndexSize( header.VertexNum );
+   header.ProcessingFlags = (optimize ? Optimized : 0u) | (simplify ? Simplified : 0u);
+   header.PackedVertexFormat = format.pack();
+   header.LodNum = static_cast<uint32_t>(lods.size());
+   getBounds( header.BoundsMin, header.BoundsMax, vertex_data.data(), header.VertexNum, getVertexStride( layout_flags ) );
+
+   const void* vertex_bytes = vertex_data.data();
+   std::vector<uint8_t> encoded;
+   if (!format.isFloat32()) {
+      format.encode( encoded, vertex_data, normals_exist, textures_exist, header.BoundsMin, header.BoundsMax );
+      format.reportError(
+         obj_file_path, encoded, vertex_data, normals_exist, textures_exist, header.BoundsMin, header.BoundsMax
+      );
+      vertex_bytes = encoded.data();
+   }
+
+   if (header.IndexSize == sizeof( uint16_t )) {
+      const std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+      return write( cache_path, header, vertex_bytes, short_indices.data(), lods.data() );
+   }
+   return write( cache_path, header, vertex_bytes, indices.data(), lods.data() );
+}
\ No newline at end of file
@@ -0,0 +1,649 @@
+#include "mesh_optimizer.h"
+#include <cstring>
+#include <numeric>
+#include <limits>
+
+uint64_t MeshOptimizer::hashVertex(const float* vertex, size_t floats_per_vertex)
+{
+   // FNV-1a over the raw bits taken a word at a time, so -0 and +0 are different vertices just like in the
+   // welding comparison.
+   uint64_t hash = 14695981039346656037ull;
+   for (size_t i = 0; i < floats_per_vertex; ++i) {
+      uint32_t bits;
+      std::memcpy( &bits, vertex + i, sizeof( bits ) );
+      hash ^= bits;
+      hash *= 1099511628211ull;
+   }
+   return hash ^ (hash >> 32u);
+}
+
+void MeshOptimizer::weld(
+   std::vector<float>& welded_vertices,
+   std::vector<uint32_t>& indices,
+   const std::vector<float>& vertices,
+   size_t floats_per_vertex
+)
+{
+   const size_t vertex_num = vertices.size() / floats_per_vertex;
+   const size_t vertex_size = floats_per_vertex * sizeof( float );
+   welded_vertices.clear();
+   welded_vertices.reserve( vertices.size() );
+   indices.resize( vertex_num );
+
+   // Open addressing with linear probing; the table is kept at most half full.
+   constexpr uint32_t empty = std::numeric_limits<uint32_t>::max();
+   size_t table_size = 1;
+   while (table_size < vertex_num * 2) table_size <<= 1u;
+   std::vector<uint32_t> table(table_size, empty);
+   const size_t mask = table_size - 1;
+
+   uint32_t welded_num = 0;
+   for (size_t i = 0; i < vertex_num; ++i) {
+      const float* vertex = vertices.data() + i * floats_per_vertex;
+      size_t slot = hashVertex( vertex, floats_per_vertex ) & mask;
+      while (table[slot] != empty) {
+         const float* candidate = welded_vertices.data() + static_cast<size_t>(table[slot]) * floats_per_vertex;
+         if (std::memcmp( candidate, vertex, vertex_size ) == 0) break;
+         slot = (slot + 1) & mask;
+      }
+      if (table[slot] == empty) {
+         table[slot] = welded_num++;
+         welded_vertices.insert( welded_vertices.end(), vertex, vertex + floats_per_vertex );
+      }
+      indices[i] = table[slot];
+   }
+   welded_vertices.shrink_to_fit();
+}
+
+float MeshOptimizer::getForsythVertexScore(int cache_position, uint32_t remaining_triangle_num)
+{
+   constexpr float cache_decay_power = 1.5f;
+   constexpr float last_triangle_score = 0.75f;
+   constexpr float valence_boost_scale = 2.0f;
+   constexpr float valence_boost_power = 0.5f;
+   if (remaining_triangle_num == 0) return -1.0f;
+
+   float score = 0.0f;
+   if (cache_position >= 0) {
+      // The vertices of the triangle just added get a fixed score, so that the next one does not simply
+      // continue in the same direction, which would be bad for strip-like walks.
+      if (cache_position < 3) score = last_triangle_score;
+      else {
+         const float scaler = 1.0f / static_cast<float>(VertexCacheSize - 3);
+         score = std::pow( 1.0f - static_cast<float>(cache_position - 3) * scaler, cache_decay_power );
+      }
+   }
+   // Vertices with few triangles left are boosted, so that they are finished off instead of being left behind.
+   score += valence_boost_scale * std::pow( static_cast<float>(remaining_triangle_num), -valence_boost_power );
+   return score;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_num)
+{
+   const size_t triangle_num = indices.size() / 3;
+   if (triangle_num == 0) return;
+
+   // Vertex to triangle adjacency in compressed rows.
+   std::vector<uint32_t> remaining(vertex_num, 0);
+   for (const auto& index : indices) remaining[index]++;
+   std::vector<uint32_t> offsets(vertex_num + 1, 0);
+   for (size_t i = 0; i < vertex_num; ++i) offsets[i + 1] = offsets[i] + remaining[i];
+   std::vector<uint32_t> adjacency(indices.size());
+   std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+   for (size_t t = 0; t < triangle_num; ++t) {
+      for (size_t k = 0; k < 3; ++k) adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+   }
+
+   // Scores are looked up instead of evaluated with pow for every update.
+   constexpr uint32_t max_valence = 64;
+   std::array<std::array<float, max_valence + 1>, VertexCacheSize + 1> score_table{};
+   for (int p = -1; p < VertexCacheSize; ++p) {
+      for (uint32_t v = 0; v <= max_valence; ++v) score_table[p + 1][v] = getForsythVertexScore( p, v );
+   }
+   const auto get_score = [&](int cache_position, uint32_t valence)
+   {
+      return score_table[cache_position + 1][std::min( valence, max_valence )];
+   };
+
+   std::vector<int> cache_positions(vertex_num, -1);
+   std::vector<float> vertex_scores(vertex_num);
+   for (size_t i = 0; i < vertex_num; ++i) vertex_scores[i] = get_score( -1, remaining[i] );
+   std::vector<float> triangle_scores(triangle_num);
+   std::vector<uint8_t> emitted(triangle_num, 0);
+   for (size_t t = 0; t < triangle_num; ++t) {
+      triangle_scores[t] =
+         vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+   }
+
+   std::vector<uint32_t> optimized;
+   optimized.reserve( indices.size() );
+   std::array<uint32_t, VertexCacheSize + 3> cache{};
+   std::array<uint32_t, VertexCacheSize + 3> new_cache{};
+   int cache_count = 0;
+   size_t scan_cursor = 0;
+   auto best_triangle = static_cast<uint32_t>(std::max_element( triangle_scores.begin(), triangle_scores.end() ) - triangle_scores.begin());
+   while (true) {
+      if (best_triangle == std::numeric_limits<uint32_t>::max()) {
+         // Nothing adjacent to the cache is left, so restart from the first triangle not emitted yet.
+         while (scan_cursor < triangle_num && emitted[scan_cursor] != 0) ++scan_cursor;
+         if (scan_cursor == triangle_num) break;
+         best_triangle = static_cast<uint32_t>(scan_cursor);
+      }
+
+      const uint32_t* triangle = &indices[best_triangle * 3];
+      optimized.insert( optimized.end(), triangle, triangle + 3 );
+      emitted[best_triangle] = 1;
+
+      // Push the triangle vertices to the front of the LRU cache.
+      int new_count = 0;
+      for (int k = 0; k < 3; ++k) {
+         if (std::find( new_cache.begin(), new_cache.begin() + new_count, triangle[k] ) == new_cache.begin() + new_count) {
+            new_cache[new_count++] = triangle[k];
+         }
+      }
+      for (int i = 0; i < cache_count; ++i) {
+         const uint32_t v = cache[i];
+         if (v != triangle[0] && v != triangle[1] && v != triangle[2]) new_cache[new_count++] = v;
+      }
+      cache_count = std::min( new_count, VertexCacheSize );
+      std::swap( cache, new_cache );
+
+      // Detach the triangle from its vertices.
+      for (int k = 0; k < 3; ++k) {
+         const uint32_t v = triangle[k];
+         uint32_t* begin = &adjacency[offsets[v]];
+         uint32_t* end = begin + remaining[v];
+         uint32_t* it = std::find( begin, end, best_triangle );
+         std::swap( *it, *(end - 1) );
+         remaining[v]--;
+      }
+      for (int i = VertexCacheSize; i < new_count; ++i) {
+         const uint32_t v = cache[i];
+         cache_positions[v] = -1;
+         vertex_scores[v] = get_score( -1, remaining[v] );
+      }
+
+      // Rescore the cached vertices and the triangles around them, and pick the best one for the next step.
+      for (int i = 0; i < cache_count; ++i) {
+         const uint32_t v = cache[i];
+         cache_positions[v] = i;
+         vertex_scores[v] = get_score( i, remaining[v] );
+      }
+      best_triangle = std::numeric_limits<uint32_t>::max();
+      float best_score = -1.0f;
+      for (int i = 0; i < cache_count; ++i) {
+         const uint32_t v = cache[i];
+         for (uint32_t j = offsets[v]; j < offsets[v] + remaining[v]; ++j) {
+            const uint32_t t = adjacency[j];
+            const float score =
+               vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+            triangle_scores[t] = score;
+            if (score > best_score) {
+               best_score = score;
+               best_triangle = t;
+            }
+         }
+      }
+   }
+   indices.swap( optimized );
+}
+
+MeshOptimizer::VertexCacheStatistics MeshOptimizer::analyzeVertexCache(
+   const std::vector<uint32_t>& indices,
+   size_t vertex_num,
+   int cache_size
+)
+{
+   VertexCacheStatistics statistics;
+   if (indices.empty() || vertex_num == 0) return statistics;
+
+   // A vertex is in the cache if it was pushed within the last cache_size pushes.
+   std::vector<size_t> pushed_time(vertex_num, 0);
+   size_t time = cache_size + 1;
+   for (const auto& index : indices) {
+      if (time - pushed_time[index] > static_cast<size_t>(cache_size)) {
+         pushed_time[index] = time++;
+         statistics.TransformedVertexNum++;
+      }
+   }
+   statistics.ACMR = static_cast<float>(statistics.TransformedVertexNum) / static_cast<float>(indices.size() / 3);
+   statistics.ATVR = static_cast<float>(statistics.TransformedVertexNum) / static_cast<float>(vertex_num);
+   return statistics;
+}
+
+void MeshOptimizer::getHardClusterBoundaries(
+   std::vector<uint32_t>& boundaries,
+   const std::vector<uint32_t>& indices,
+   size_t vertex_num
+)
+{
+   // A triangle whose vertices all miss the cache does not benefit from its predecessors, so the sequence
+   // can be cut there without changing the cache behavior.
+   std::vector<size_t> pushed_time(vertex_num, 0);
+   size_t time = VertexCacheSize + 1;
+   const size_t triangle_num = indices.size() / 3;
+   for (size_t t = 0; t < triangle_num; ++t) {
+      int misses = 0;
+      for (size_t k = 0; k < 3; ++k) {
+         const uint32_t v = indices[t * 3 + k];
+         if (time - pushed_time[v] > static_cast<size_t>(VertexCacheSize)) {
+            pushed_time[v] = time++;
+            misses++;
+         }
+      }
+      if (t == 0 || misses == 3) boundaries.emplace_back( static_cast<uint32_t>(t) );
+   }
+   boundaries.emplace_back( static_cast<uint32_t>(triangle_num) );
+}
+
+void MeshOptimizer::getSoftClusterBoundaries(
+   std::vector<uint32_t>& boundaries,
+   const std::vector<uint32_t>& indices,
+   const std::vector<uint32_t>& hard_boundaries,
+   size_t vertex_num,
+   float threshold
+)
+{
+   // Hard clusters are split further where restarting with a cold cache keeps the cluster ACMR within threshold.
+   std::vector<size_t> pushed_time(vertex_num, 0);
+   size_t time = VertexCacheSize + 1;
+   for (size_t c = 0; c + 1 < hard_boundaries.size(); ++c) {
+      const uint32_t begin = hard_boundaries[c];
+      const uint32_t end = hard_boundaries[c + 1];
+
+      size_t cluster_misses = 0;
+      time += VertexCacheSize + 1;
+      for (uint32_t t = begin; t < end; ++t) {
+         for (size_t k = 0; k < 3; ++k) {
+            const uint32_t v = indices[t * 3 + k];
+            if (time - pushed_time[v] > static_cast<size_t>(VertexCacheSize)) {
+               pushed_time[v] = time++;
+               cluster_misses++;
+            }
+         }
+      }
+      const float cluster_threshold = threshold * static_cast<float>(cluster_misses) / static_cast<float>(end - begin);
+
+      boundaries.emplace_back( begin );
+      time += VertexCacheSize + 1;
+      size_t misses = 0;
+      uint32_t start = begin;
+      for (uint32_t t = begin; t < end; ++t) {
+         for (size_t k = 0; k < 3; ++k) {
+            const uint32_t v = indices[t * 3 + k];
+            if (time - pushed_time[v] > static_cast<size_t>(VertexCacheSize)) {
+               pushed_time[v] = time++;
+               misses++;
+            }
+         }
+         const auto acmr = static_cast<float>(misses) / static_cast<float>(t - start + 1);
+         if (t + 1 < end && acmr <= cluster_threshold) {
+            boundaries.emplace_back( t + 1 );
+            start = t + 1;
+            misses = 0;
+            time += VertexCacheSize + 1;
+         }
+      }
+   }
+   boundaries.emplace_back( hard_boundaries.back() );
+}
+
+void MeshOptimizer::optimizeOverdraw(
+   std::vector<uint32_t>& indices,
+   const std::vector<float>& vertices,
+   size_t floats_per_vertex,
+   float threshold
+)
+{
+   const size_t vertex_num = vertices.size() / floats_per_vertex;
+   if (indices.empty() || vertex_num == 0) return;
+
+   std::vector<uint32_t> hard_boundaries, boundaries;
+   getHardClusterBoundaries( hard_boundaries, indices, vertex_num );
+   getSoftClusterBoundaries( boundaries, indices, hard_boundaries, vertex_num, threshold );
+
+   const auto get_position = [&](uint32_t v)
+   {
+      const float* p = vertices.data() + v * floats_per_vertex;
+      return glm::vec3(p[0], p[1], p[2]);
+   };
+
+   // Sort clusters by how much they face away from the mesh center, so that the outer shell is drawn first and
+   // the early depth test rejects more of what lies behind it.
+   glm::vec3 mesh_centroid(0.0f);
+   for (size_t v = 0; v < vertex_num; ++v) mesh_centroid += get_position( static_cast<uint32_t>(v) );
+   mesh_centroid /= static_cast<float>(vertex_num);
+
+   const size_t cluster_num = boundaries.size() - 1;
+   std::vector<float> sort_keys(cluster_num);
+   for (size_t c = 0; c < cluster_num; ++c) {
+      glm::vec3 centroid(0.0f), area_normal(0.0f);
+      float area = 0.0f;
+      for (uint32_t t = boundaries[c]; t < boundaries[c + 1]; ++t) {
+         const glm::vec3 p0 = get_position( indices[t * 3] );
+         const glm::vec3 p1 = get_position( indices[t * 3 + 1] );
+         const glm::vec3 p2 = get_position( indices[t * 3 + 2] );
+         const glm::vec3 normal = glm::cross( p1 - p0, p2 - p0 );
+         const float triangle_area = glm::length( normal );
+         centroid += (p0 + p1 + p2) * (triangle_area / 3.0f);
+         area_normal += normal;
+         area += triangle_area;
+      }
+      centroid = area > 0.0f ? centroid / area : get_position( indices[boundaries[c] * 3] );
+      const float normal_length = glm::length( area_normal );
+      const glm::vec3 normal = normal_length > 0.0f ? area_normal / normal_length : glm::vec3(0.0f);
+      sort_keys[c] = glm::dot( centroid - mesh_centroid, normal );
+   }
+
+   std::vector<uint32_t> order(cluster_num);
+   std::iota( order.begin(), order.end(), 0u );
+   std::stable_sort( order.begin(), order.end(), [&sort_keys](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; } );
+
+   std::vector<uint32_t> sorted;
+   sorted.reserve( indices.size() );
+   for (const auto& c : order) {
+      sorted.insert( sorted.end(), indices.begin() + boundaries[c] * 3, indices.begin() + boundaries[c + 1] * 3 );
+   }
+   indices.swap( sorted );
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<float>& vertices, std::vector<uint32_t>& indices, size_t floats_per_vertex)
+{
+   const size_t vertex_num = vertices.size() / floats_per_vertex;
+   constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+   std::vector<uint32_t> remap(vertex_num, unused);
+   uint32_t next = 0;
+   for (auto& index : indices) {
+      if (remap[index] == unused) remap[index] = next++;
+      index = remap[index];
+   }
+
+   // Vertices no index refers to are dropped.
+   std::vector<float> reordered(static_cast<size_t>(next) * floats_per_vertex);
+   for (size_t v = 0; v < vertex_num; ++v) {
+      if (remap[v] == unused) continue;
+      std::copy_n( vertices.begin() + v * floats_per_vertex, floats_per_vertex, reordered.begin() + remap[v] * floats_per_vertex );
+   }
+   vertices.swap( reordered );
+}
+
+void MeshOptimizer::Quadric::addPlane(const glm::dvec3& normal, double distance, double weight)
+{
+   A00 += weight * normal.x * normal.x;
+   A11 += weight * normal.y * normal.y;
+   A22 += weight * normal.z * normal.z;
+   A01 += weight * normal.x * normal.y;
+   A02 += weight * normal.x * normal.z;
+   A12 += weight * normal.y * normal.z;
+   B0 += weight * normal.x * distance;
+   B1 += weight * normal.y * distance;
+   B2 += weight * normal.z * distance;
+   C += weight * distance * distance;
+   Weight += weight;
+}
+
+void MeshOptimizer::Quadric::add(const Quadric& other)
+{
+   A00 += other.A00;
+   A11 += other.A11;
+   A22 += other.A22;
+   A01 += other.A01;
+   A02 += other.A02;
+   A12 += other.A12;
+   B0 += other.B0;
+   B1 += other.B1;
+   B2 += other.B2;
+   C += other.C;
+   Weight += other.Weight;
+}
+
+double MeshOptimizer::Quadric::getError(const glm::dvec3& point) const
+{
+   if (Weight <= 0.0) return 0.0;
+
+   const double error =
+      A00 * point.x * point.x + A11 * point.y * point.y + A22 * point.z * point.z +
+      2.0 * (A01 * point.x * point.y + A02 * point.x * point.z + A12 * point.y * point.z) +
+      2.0 * (B0 * point.x + B1 * point.y + B2 * point.z) + C;
+   return std::max( error, 0.0 ) / Weight;
+}
+
+void MeshOptimizer::getLockedVertices(
+   std::vector<bool>& locked,
+   const std::vector<uint32_t>& indices,
+   const std::vector<glm::vec3>& positions
+)
+{
+   // Vertices that share a position differ in another attribute; moving one of them alone would tear the seam.
+   std::vector<uint32_t> position_ids(positions.size());
+   std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+   locked.assign( positions.size(), false );
+   for (uint32_t v = 0; v < positions.size(); ++v) {
+      auto& bucket = buckets[hashVertex( &positions[v][0], 3 )];
+      position_ids[v] = v;
+      for (const auto other : bucket) {
+         if (positions[other] == positions[v]) {
+            position_ids[v] = position_ids[other];
+            locked[v] = locked[other] = true;
+            break;
+         }
+      }
+      bucket.emplace_back( v );
+   }
+
+   // An edge of the position mesh that is not shared by exactly two triangles is on a border or non-manifold.
+   std::unordered_map<uint64_t, int> edge_counts;
+   edge_counts.reserve( indices.size() );
+   for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      for (int e = 0; e < 3; ++e) {
+         const uint32_t a = position_ids[indices[i + e]];
+         const uint32_t b = position_ids[indices[i + (e + 1) % 3]];
+         edge_counts[static_cast<uint64_t>(std::min( a, b )) << 32u | std::max( a, b )]++;
+      }
+   }
+   for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      for (int e = 0; e < 3; ++e) {
+         const uint32_t a = indices[i + e];
+         const uint32_t b = indices[i + (e + 1) % 3];
+         const uint32_t pa = position_ids[a], pb = position_ids[b];
+         if (edge_counts[static_cast<uint64_t>(std::min( pa, pb )) << 32u | std::max( pa, pb )] != 2) {
+            locked[a] = locked[b] = true;
+         }
+      }
+   }
+}
+
+bool MeshOptimizer::flipsTriangle(
+   const std::vector<glm::vec3>& positions,
+   uint32_t a,
+   uint32_t b,
+   uint32_t c,
+   uint32_t moved,
+   const glm::vec3& destination
+)
+{
+   const glm::vec3 before = glm::cross( positions[b] - positions[a], positions[c] - positions[a] );
+   const glm::vec3 pa = a == moved ? destination : positions[a];
+   const glm::vec3 pb = b == moved ? destination : positions[b];
+   const glm::vec3 pc = c == moved ? destination : positions[c];
+   const glm::vec3 after = glm::cross( pb - pa, pc - pa );
+   return glm::dot( before, after ) <= 0.0f;
+}
+
+float MeshOptimizer::getDistanceToTriangle(
+   const glm::vec3& point,
+   const glm::vec3& a,
+   const glm::vec3& b,
+   const glm::vec3& c
+)
+{
+   // The closest point is found by the Voronoi region of the triangle that point lies in.
+   const glm::vec3 ab = b - a, ac = c - a, ap = point - a;
+   const float d1 = glm::dot( ab, ap ), d2 = glm::dot( ac, ap );
+   if (d1 <= 0.0f && d2 <= 0.0f) return glm::length( ap );
+
+   const glm::vec3 bp = point - b;
+   const float d3 = glm::dot( ab, bp ), d4 = glm::dot( ac, bp );
+   if (d3 >= 0.0f && d4 <= d3) return glm::length( bp );
+
+   const float vc = d1 * d4 - d3 * d2;
+   if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return glm::distance( point, a + ab * (d1 / (d1 - d3)) );
+
+   const glm::vec3 cp = point - c;
+   const float d5 = glm::dot( ab, cp ), d6 = glm::dot( ac, cp );
+   if (d6 >= 0.0f && d5 <= d6) return glm::length( cp );
+
+   const float vb = d5 * d2 - d1 * d6;
+   if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return glm::distance( point, a + ac * (d2 / (d2 - d6)) );
+
+   const float va = d3 * d6 - d5 * d4;
+   if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+      return glm::distance( point, b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))) );
+   }
+
+   const float sum = va + vb + vc;
+   if (sum <= 0.0f) return glm::length( ap );
+   return glm::distance( point, a + ab * (vb / sum) + ac * (vc / sum) );
+}
+
+float MeshOptimizer::simplify(
+   std::vector<uint32_t>& simplified,
+   std::vector<uint32_t>& destinations,
+   const std::vector<uint32_t>& indices,
+   const std::vector<float>& vertices,
+   size_t floats_per_vertex,
+   size_t target_index_num
+)
+{
+   const size_t vertex_num = vertices.size() / floats_per_vertex;
+   std::vector<glm::vec3> positions(vertex_num);
+   for (size_t v = 0; v < vertex_num; ++v) {
+      positions[v] = glm::vec3(vertices[v * floats_per_vertex], vertices[v * floats_per_vertex + 1], vertices[v * floats_per_vertex + 2]);
+   }
+   std::vector<bool> locked;
+   getLockedVertices( locked, indices, positions );
+
+   std::vector<Quadric> quadrics(vertex_num);
+   for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      const glm::dvec3 p0(positions[indices[i]]);
+      const glm::dvec3 normal = glm::cross( glm::dvec3(positions[indices[i + 1]]) - p0, glm::dvec3(positions[indices[i + 2]]) - p0 );
+      const double double_area = glm::length( normal );
+      if (double_area <= 0.0) continue;
+
+      const glm::dvec3 unit = normal / double_area;
+      for (int k = 0; k < 3; ++k) quadrics[indices[i + k]].addPlane( unit, -glm::dot( unit, p0 ), double_area * 0.5 );
+   }
+
+   struct Collapse
+   {
+      double Error;
+      uint32_t From, To;
+   };
+
+   simplified = indices;
+   simplified.resize( indices.size() / 3 * 3 );
+   if (destinations.empty()) {
+      destinations.resize( vertex_num );
+      std::iota( destinations.begin(), destinations.end(), 0u );
+   }
+   std::vector<uint32_t> triangle_offsets(vertex_num + 1), vertex_triangles, remap(vertex_num);
+   // Vertex-to-triangle adjacency of the current mesh.
+   const auto build_vertex_triangles = [&]()
+   {
+      std::fill( triangle_offsets.begin(), triangle_offsets.end(), 0 );
+      for (const auto index : simplified) triangle_offsets[index + 1]++;
+      for (size_t v = 0; v < vertex_num; ++v) triangle_offsets[v + 1] += triangle_offsets[v];
+      vertex_triangles.resize( simplified.size() );
+      std::vector<uint32_t> fill(triangle_offsets.begin(), triangle_offsets.end() - 1);
+      for (size_t i = 0; i < simplified.size(); ++i) vertex_triangles[fill[simplified[i]]++] = static_cast<uint32_t>(i / 3);
+   };
+   std::vector<bool> touched(vertex_num);
+   std::vector<Collapse> collapses, best_collapses(vertex_num);
+   while (simplified.size() > target_index_num) {
+      build_vertex_triangles();
+
+      // Only the cheapest collapse of each vertex is a candidate, which keeps the list at one entry per vertex.
+      std::fill( best_collapses.begin(), best_collapses.end(), Collapse{ std::numeric_limits<double>::max(), 0, 0 } );
+      for (size_t i = 0; i < simplified.size(); i += 3) {
+         for (int e = 0; e < 3; ++e) {
+            const uint32_t a = simplified[i + e];
+            const uint32_t b = simplified[i + (e + 1) % 3];
+            // Interior edges appear once in each direction, which covers both ways to collapse them.
+            if (locked[a]) continue;
+
+            Quadric merged = quadrics[a];
+            merged.add( quadrics[b] );
+            const double error = merged.getError( glm::dvec3(positions[b]) );
+            if (error < best_collapses[a].Error) best_collapses[a] = { error, a, b };
+         }
+      }
+      collapses.clear();
+      for (const auto& collapse : best_collapses) {
+         if (collapse.Error < std::numeric_limits<double>::max()) collapses.push_back( collapse );
+      }
+      std::sort(
+         collapses.begin(), collapses.end(),
+         [](const Collapse& x, const Collapse& y) { return x.Error < y.Error; }
+      );
+
+      // Each collapse of an interior edge removes two triangles. Collapses in one pass must not share
+      // neighborhoods, since each one is validated against the positions before the pass.
+      const size_t removable_triangle_num = (simplified.size() - target_index_num) / 3;
+      size_t removed_triangle_num = 0;
+      std::iota( remap.begin(), remap.end(), 0u );
+      std::fill( touched.begin(), touched.end(), false );
+      for (const auto& collapse : collapses) {
+         if (removed_triangle_num >= removable_triangle_num) break;
+         if (touched[collapse.From] || touched[collapse.To]) continue;
+
+         bool valid = true;
+         for (uint32_t t = triangle_offsets[collapse.From]; valid && t < triangle_offsets[collapse.From + 1]; ++t) {
+            const uint32_t* triangle = &simplified[vertex_triangles[t] * 3];
+            if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To) continue;
+            valid = !flipsTriangle( positions, triangle[0], triangle[1], triangle[2], collapse.From, positions[collapse.To] );
+         }
+         if (!valid) continue;
+
+         for (uint32_t t = triangle_offsets[collapse.From]; t < triangle_offsets[collapse.From + 1]; ++t) {
+            const uint32_t* triangle = &simplified[vertex_triangles[t] * 3];
+            touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To) {
+               removed_triangle_num++;
+            }
+         }
+         remap[collapse.From] = collapse.To;
+         quadrics[collapse.To].add( quadrics[collapse.From] );
+      }
+      if (removed_triangle_num == 0) break;
+
+      for (auto& destination : destinations) destination = remap[destination];
+
+      size_t kept = 0;
+      for (size_t i = 0; i < simplified.size(); i += 3) {
+         const uint32_t a = remap[simplified[i]], b = remap[simplified[i + 1]], c = remap[simplified[i + 2]];
+         if (a == b || b == c || c == a) continue;
+         simplified[kept++] = a;
+         simplified[kept++] = b;
+         simplified[kept++] = c;
+      }
+      simplified.resize( kept );
+   }
+
+   // The quadric error only orders the collapses; the error of the result is measured on the positions.
+   build_vertex_triangles();
+
+   float max_error = 0.0f;
+   for (size_t v = 0; v < vertex_num; ++v) {
+      const uint32_t destination = destinations[v];
+      float error = glm::distance( positions[v], positions[destination] );
+      for (uint32_t t = triangle_offsets[destination]; t < triangle_offsets[destination + 1]; ++t) {
+         const uint32_t* triangle = &simplified[vertex_triangles[t] * 3];
+         const glm::vec3& a = positions[triangle[0]];
+         const glm::vec3& b = positions[triangle[1]];
+         const glm::vec3& c = positions[triangle[2]];
+         error = std::min( error, getDistanceToTriangle( positions[v], a, b, c ) );
+      }
+      max_error = std::max( max_error, error );
+   }
+   return max_error;
+}
@@ -0,0 +1,165 @@
+#include "meshlet.h"
+
+void MeshletBuilder::setBounds(Meshlet& meshlet, const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions)
+{
+   meshlet.BoundsMin = glm::vec3(std::numeric_limits<float>::max());
+   meshlet.BoundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+   const uint32_t end = meshlet.IndexOffset + meshlet.IndexNum;
+   for (uint32_t i = meshlet.IndexOffset; i < end; ++i) {
+      meshlet.BoundsMin = glm::min( meshlet.BoundsMin, positions[indices[i]] );
+      meshlet.BoundsMax = glm::max( meshlet.BoundsMax, positions[indices[i]] );
+   }
+   meshlet.Center = 0.5f * (meshlet.BoundsMin + meshlet.BoundsMax);
+   meshlet.Radius = 0.0f;
+   for (uint32_t i = meshlet.IndexOffset; i < end; ++i) {
+      meshlet.Radius = std::max( meshlet.Radius, glm::distance( meshlet.Center, positions[indices[i]] ) );
+   }
+
+   std::vector<glm::vec3> normals;
+   normals.reserve( meshlet.IndexNum / 3 );
+   glm::vec3 normal_sum(0.0f);
+   for (uint32_t i = meshlet.IndexOffset; i + 2 < end; i += 3) {
+      const glm::vec3& p0 = positions[indices[i]];
+      const glm::vec3 normal = glm::cross( positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0 );
+      const float length = glm::length( normal );
+      if (length <= 0.0f) continue;
+      normals.emplace_back( normal / length );
+      normal_sum += normals.back();
+   }
+
+   meshlet.ConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+   meshlet.ConeCutoff = 1.0f;
+   const float sum_length = glm::length( normal_sum );
+   if (normals.empty() || sum_length <= 0.0f) return;
+
+   const glm::vec3 axis = normal_sum / sum_length;
+   float min_cosine = 1.0f;
+   for (const auto& normal : normals) min_cosine = std::min( min_cosine, glm::dot( axis, normal ) );
+   meshlet.ConeAxis = axis;
+   // Wider than a hemisphere, some triangle faces the camera from any direction.
+   if (min_cosine > 0.0f) meshlet.ConeCutoff = std::sqrt( 1.0f - min_cosine * min_cosine );
+}
+
+void MeshletBuilder::build(
+   std::vector<Meshlet>& meshlets,
+   const std::vector<uint32_t>& indices,
+   const std::vector<glm::vec3>& positions,
+   size_t max_vertex_num,
+   size_t max_triangle_num
+)
+{
+   meshlets.clear();
+   if (indices.size() < 3) return;
+
+   // The meshlet each vertex was last added to, so that shared vertices are counted once per meshlet.
+   std::vector<uint32_t> owners(positions.size(), std::numeric_limits<uint32_t>::max());
+   auto current = static_cast<uint32_t>(meshlets.size());
+   const auto count_new_vertices = [&](uint32_t a, uint32_t b, uint32_t c)
+   {
+      return static_cast<size_t>(owners[a] != current) +
+         static_cast<size_t>(owners[b] != current && b != a) +
+         static_cast<size_t>(owners[c] != current && c != a && c != b);
+   };
+
+   Meshlet meshlet;
+   size_t vertex_num = 0, triangle_num = 0;
+   for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+      size_t new_vertex_num = count_new_vertices( a, b, c );
+      if (vertex_num + new_vertex_num > max_vertex_num || triangle_num == max_triangle_num) {
+         meshlet.IndexNum = static_cast<uint32_t>(i) - meshlet.IndexOffset;
+         setBounds( meshlet, indices, positions );
+         meshlets.emplace_back( meshlet );
+
+         meshlet = Meshlet();
+         meshlet.IndexOffset = static_cast<uint32_t>(i);
+         current = static_cast<uint32_t>(meshlets.size());
+         vertex_num = triangle_num = 0;
+         new_vertex_num = count_new_vertices( a, b, c );
+      }
+      owners[a] = owners[b] = owners[c] = current;
+      vertex_num += new_vertex_num;
+      triangle_num++;
+   }
+   meshlet.IndexNum = static_cast<uint32_t>(indices.size() / 3 * 3) - meshlet.IndexOffset;
+   setBounds( meshlet, indices, positions );
+   meshlets.emplace_back( meshlet );
+}
+
+MeshletCuller::MeshletCuller(const glm::mat4& object_to_clip) : Orthographic( false ), Eye( 0.0f ), Planes{}
+{
+   const glm::mat4 m = glm::transpose( object_to_clip ); // rows of object_to_clip
+   Planes[0] = m[3] + m[0];
+   Planes[1] = m[3] - m[0];
+   Planes[2] = m[3] + m[1];
+   Planes[3] = m[3] - m[1];
+   Planes[4] = m[3] + m[2];
+   Planes[5] = m[3] - m[2];
+   for (auto& plane : Planes) {
+      const float length = glm::length( glm::vec3(plane) );
+      if (length > 0.0f) plane /= length;
+   }
+
+   // The camera is the point that the x, y and w rows all send to zero, i.e. the null space of those three rows.
+   // Its w component vanishes for an orthographic projection, which leaves the view direction instead.
+   const std::array<glm::dvec4, 3> rows = { glm::dvec4(m[0]), glm::dvec4(m[1]), glm::dvec4(m[3]) };
+   glm::dvec4 null;
+   for (int j = 0; j < 4; ++j) {
+      glm::dmat3 minor;
+      for (int r = 0, k = 0; k < 4; ++k) {
+         if (k == j) continue;
+         minor[r++] = glm::dvec3(rows[0][k], rows[1][k], rows[2][k]);
+      }
+      null[j] = (j % 2 == 0 ? 1.0 : -1.0) * glm::determinant( minor );
+   }
+   if (std::abs( null.w ) > 1e-7 * glm::length( null )) Eye = glm::vec3(glm::dvec3(null) / null.w);
+   else {
+      Orthographic = true;
+      glm::dvec3 direction = glm::normalize( glm::dvec3(null) );
+      // Depth grows away from the camera, so the view direction is the one that increases z.
+      if (glm::dot( glm::dvec3(m[2]), direction ) < 0.0) direction = -direction;
+      Eye = glm::vec3(direction);
+   }
+}
+
+bool MeshletCuller::isInsideFrustum(const glm::vec3& bounds_min, const glm::vec3& bounds_max) const
+{
+   for (const auto& plane : Planes) {
+      const glm::vec3 farthest(
+         plane.x >= 0.0f ? bounds_max.x : bounds_min.x,
+         plane.y >= 0.0f ? bounds_max.y : bounds_min.y,
+         plane.z >= 0.0f ? bounds_max.z : bounds_min.z
+      );
+      if (glm::dot( glm::vec3(plane), farthest ) + plane.w < 0.0f) return false;
+   }
+   return true;
+}
+
+bool MeshletCuller::isBackFacing(const Meshlet& meshlet) const
+{
+   if (meshlet.ConeCutoff >= 1.0f) return false;
+   if (Orthographic) return glm::dot( Eye, meshlet.ConeAxis ) > meshlet.ConeCutoff;
+
+   const glm::vec3 to_center = meshlet.Center - Eye;
+   return glm::dot( to_center, meshlet.ConeAxis ) > meshlet.ConeCutoff * glm::length( to_center ) + meshlet.Radius;
+}
+
+size_t MeshletCuller::getVisibleRanges(
+   std::vector<IndexRange>& ranges,
+   const std::vector<Meshlet>& meshlets,
+   bool cull_backfaces
+) const
+{
+   ranges.clear();
+   size_t visible_num = 0;
+   for (const auto& meshlet : meshlets) {
+      if (!isVisible( meshlet, cull_backfaces )) continue;
+
+      visible_num++;
+      if (!ranges.empty() && ranges.back().Offset + ranges.back().Count == meshlet.IndexOffset) {
+         ranges.back().Count += meshlet.IndexNum;
+      }
+      else ranges.emplace_back( meshlet.IndexOffset, meshlet.IndexNum );
+   }
+   return visible_num;
+}
\ No newline at end of file
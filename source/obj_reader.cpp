@@ -0,0 +1,278 @@
+#include "obj_reader.h"
+#include <charconv>
+
+ObjReader::ObjReader(int thread_num) : FoundNormals( false ), FoundTextures( false ), ThreadNum( 1 )
+{
+   setThreadNum( thread_num );
+}
+
+void ObjReader::setThreadNum(int thread_num)
+{
+   ThreadNum = thread_num > 0 ? thread_num : static_cast<int>(std::thread::hardware_concurrency());
+   ThreadNum = std::max( ThreadNum, 1 );
+}
+
+void ObjReader::clear()
+{
+   FoundNormals = false;
+   FoundTextures = false;
+   Positions.clear();
+   Normals.clear();
+   Textures.clear();
+   Corners.clear();
+}
+
+bool ObjReader::parseFloat(const char*& ptr, const char* end, float& value)
+{
+   skipSpaces( ptr, end );
+   if (ptr < end && *ptr == '+') ++ptr;
+   const auto result = std::from_chars( ptr, end, value );
+   if (result.ec != std::errc()) return false;
+   ptr = result.ptr;
+   return true;
+}
+
+bool ObjReader::parseIndex(const char*& ptr, const char* end, int count, int& index, bool& relative)
+{
+   int value = 0;
+   const auto result = std::from_chars( ptr, end, value );
+   if (result.ec != std::errc() || value == 0) return false;
+   ptr = result.ptr;
+
+   // OBJ indices are 1-based, and negative ones are relative to the most recently defined element.
+   // The relative ones are resolved against the chunk here and may still point into a preceding chunk.
+   relative = value < 0;
+   index = relative ? count + value : value - 1;
+   return true;
+}
+
+bool ObjReader::parseFace(
+   const char*& ptr,
+   const char* end,
+   Chunk& chunk,
+   std::vector<Corner>& polygon,
+   std::vector<uint8_t>& relative_flags
+)
+{
+   const auto vertex_num = static_cast<int>(chunk.Positions.size());
+   const auto texture_num = static_cast<int>(chunk.Textures.size());
+   const auto normal_num = static_cast<int>(chunk.Normals.size());
+   polygon.clear();
+   relative_flags.clear();
+   while (true) {
+      skipSpaces( ptr, end );
+      if (ptr >= end || *ptr == '\n' || *ptr == '#') break;
+
+      Corner corner;
+      uint8_t flags = 0;
+      bool relative = false;
+      if (!parseIndex( ptr, end, vertex_num, corner.Vertex, relative )) return false;
+      if (relative) flags |= RelativeVertex;
+      if (ptr < end && *ptr == '/') {
+         ++ptr;
+         if (ptr < end && *ptr != '/') {
+            if (!parseIndex( ptr, end, texture_num, corner.Texture, relative )) return false;
+            if (relative) flags |= RelativeTexture;
+         }
+         if (ptr < end && *ptr == '/') {
+            ++ptr;
+            if (!parseIndex( ptr, end, normal_num, corner.Normal, relative )) return false;
+            if (relative) flags |= RelativeNormal;
+         }
+      }
+      polygon.emplace_back( corner );
+      relative_flags.emplace_back( flags );
+   }
+   if (polygon.size() < 3) return false;
+
+   for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+      for (const size_t j : { size_t(0), i, i + 1 }) {
+         if (relative_flags[j] != 0) chunk.RelativeCorners.emplace_back( chunk.Corners.size(), relative_flags[j] );
+         chunk.Corners.emplace_back( polygon[j] );
+      }
+   }
+   return true;
+}
+
+void ObjReader::parseChunk(Chunk& chunk)
+{
+   std::vector<Corner> polygon;
+   std::vector<uint8_t> relative_flags;
+   const char* ptr = chunk.Begin;
+   const char* end = chunk.End;
+   while (ptr < end) {
+      skipSpaces( ptr, end );
+      if (ptr >= end) break;
+
+      bool succeeded = true;
+      if (ptr[0] == 'v' && ptr + 1 < end && (ptr[1] == ' ' || ptr[1] == '\t')) {
+         ptr += 1;
+         glm::vec3 vertex;
+         succeeded = parseFloat( ptr, end, vertex.x ) && parseFloat( ptr, end, vertex.y ) && parseFloat( ptr, end, vertex.z );
+         chunk.Positions.emplace_back( vertex );
+      }
+      else if (ptr[0] == 'v' && ptr + 2 < end && ptr[1] == 't' && (ptr[2] == ' ' || ptr[2] == '\t')) {
+         ptr += 2;
+         glm::vec2 uv;
+         succeeded = parseFloat( ptr, end, uv.x ) && parseFloat( ptr, end, uv.y );
+         chunk.Textures.emplace_back( uv );
+      }
+      else if (ptr[0] == 'v' && ptr + 2 < end && ptr[1] == 'n' && (ptr[2] == ' ' || ptr[2] == '\t')) {
+         ptr += 2;
+         glm::vec3 normal;
+         succeeded = parseFloat( ptr, end, normal.x ) && parseFloat( ptr, end, normal.y ) && parseFloat( ptr, end, normal.z );
+         chunk.Normals.emplace_back( normal );
+      }
+      else if (ptr[0] == 'f' && ptr + 1 < end && (ptr[1] == ' ' || ptr[1] == '\t')) {
+         ptr += 1;
+         succeeded = parseFace( ptr, end, chunk, polygon, relative_flags );
+      }
+      if (!succeeded) {
+         chunk.ErrorPosition = ptr;
+         return;
+      }
+      skipLine( ptr, end );
+   }
+}
+
+void ObjReader::splitIntoChunks(std::vector<Chunk>& chunks, const char* begin, const char* end) const
+{
+   const auto size = static_cast<size_t>(end - begin);
+   const size_t chunk_num = std::clamp( size / MinChunkSize, size_t(1), static_cast<size_t>(ThreadNum) );
+   const size_t chunk_size = size / chunk_num;
+   chunks.reserve( chunk_num );
+
+   const char* chunk_begin = begin;
+   for (size_t i = 1; i < chunk_num && chunk_begin < end; ++i) {
+      const char* chunk_end = std::max( begin + i * chunk_size, chunk_begin );
+      chunk_end = std::find( chunk_end, end, '\n' );
+      if (chunk_end < end) ++chunk_end;
+      chunks.emplace_back( chunk_begin, chunk_end );
+      chunk_begin = chunk_end;
+   }
+   if (chunk_begin < end || chunks.empty()) chunks.emplace_back( chunk_begin, end );
+}
+
+bool ObjReader::mergeChunks(std::vector<Chunk>& chunks)
+{
+   const auto chunk_num = static_cast<int>(chunks.size());
+   std::vector<size_t> position_offsets(chunk_num + 1, 0);
+   std::vector<size_t> normal_offsets(chunk_num + 1, 0);
+   std::vector<size_t> texture_offsets(chunk_num + 1, 0);
+   std::vector<size_t> corner_offsets(chunk_num + 1, 0);
+   for (int i = 0; i < chunk_num; ++i) {
+      position_offsets[i + 1] = position_offsets[i] + chunks[i].Positions.size();
+      normal_offsets[i + 1] = normal_offsets[i] + chunks[i].Normals.size();
+      texture_offsets[i + 1] = texture_offsets[i] + chunks[i].Textures.size();
+      corner_offsets[i + 1] = corner_offsets[i] + chunks[i].Corners.size();
+   }
+   if (position_offsets[chunk_num] > static_cast<size_t>(std::numeric_limits<int>::max())) return false;
+
+   Positions.resize( position_offsets[chunk_num] );
+   Normals.resize( normal_offsets[chunk_num] );
+   Textures.resize( texture_offsets[chunk_num] );
+   Corners.resize( corner_offsets[chunk_num] );
+
+   const auto vertex_num = static_cast<int>(Positions.size());
+   const auto normal_num = static_cast<int>(Normals.size());
+   const auto texture_num = static_cast<int>(Textures.size());
+   std::vector<uint8_t> valid(chunk_num, 1);
+   std::vector<uint8_t> normal_found(chunk_num, 0);
+   std::vector<uint8_t> texture_found(chunk_num, 0);
+   runInParallel( chunk_num, ThreadNum, [&](int i)
+   {
+      Chunk& chunk = chunks[i];
+      std::copy( chunk.Positions.begin(), chunk.Positions.end(), Positions.begin() + position_offsets[i] );
+      std::copy( chunk.Normals.begin(), chunk.Normals.end(), Normals.begin() + normal_offsets[i] );
+      std::copy( chunk.Textures.begin(), chunk.Textures.end(), Textures.begin() + texture_offsets[i] );
+      for (const auto& relative_corner : chunk.RelativeCorners) {
+         Corner& corner = chunk.Corners[relative_corner.first];
+         if (relative_corner.second & RelativeVertex) corner.Vertex += static_cast<int>(position_offsets[i]);
+         if (relative_corner.second & RelativeTexture) corner.Texture += static_cast<int>(texture_offsets[i]);
+         if (relative_corner.second & RelativeNormal) corner.Normal += static_cast<int>(normal_offsets[i]);
+         if (corner.Vertex < 0 ||
+             (corner.Texture < 0 && (relative_corner.second & RelativeTexture)) ||
+             (corner.Normal < 0 && (relative_corner.second & RelativeNormal))) {
+            valid[i] = 0;
+         }
+      }
+
+      auto corner_it = Corners.begin() + static_cast<std::ptrdiff_t>(corner_offsets[i]);
+      for (const auto& corner : chunk.Corners) {
+         if (corner.Vertex < 0 || corner.Vertex >= vertex_num ||
+             corner.Texture < -1 || corner.Texture >= texture_num ||
+             corner.Normal < -1 || corner.Normal >= normal_num) {
+            valid[i] = 0;
+         }
+         if (corner.Normal >= 0) normal_found[i] = 1;
+         if (corner.Texture >= 0) texture_found[i] = 1;
+         *corner_it++ = corner;
+      }
+      chunk = Chunk(chunk.Begin, chunk.End);
+   } );
+
+   for (int i = 0; i < chunk_num; ++i) {
+      if (valid[i] == 0) return false;
+      if (normal_found[i] != 0) FoundNormals = true;
+      if (texture_found[i] != 0) FoundTextures = true;
+   }
+   return true;
+}
+
+bool ObjReader::read(const char* begin, const char* end)
+{
+   clear();
+
+   std::vector<Chunk> chunks;
+   splitIntoChunks( chunks, begin, end );
+   runInParallel( static_cast<int>(chunks.size()), ThreadNum, [&chunks](int i) { parseChunk( chunks[i] ); } );
+
+   for (const auto& chunk : chunks) {
+      if (chunk.ErrorPosition != nullptr) {
+         const auto line = std::count( begin, chunk.ErrorPosition, '\n' ) + 1;
+         std::cerr << "The object file is not correct at line " << line << ".\n";
+         return false;
+      }
+   }
+   if (!mergeChunks( chunks )) {
+      std::cerr << "The object file refers to undefined vertex attributes.\n";
+      clear();
+      return false;
+   }
+   return true;
+}
+
+bool ObjReader::read(const std::string& file_path)
+{
+   const MappedFile file(file_path);
+   if (!file.isOpen()) {
+      std::cout << "The object file is not correct.\n";
+      return false;
+   }
+   return read( file.begin(), file.end() );
+}
+
+void ObjReader::getTriangles(
+   std::vector<glm::vec3>& vertices,
+   std::vector<glm::vec3>& normals,
+   std::vector<glm::vec2>& textures
+) const
+{
+   const size_t corner_num = Corners.size();
+   vertices.resize( corner_num );
+   normals.resize( FoundNormals ? corner_num : 0 );
+   textures.resize( FoundTextures ? corner_num : 0 );
+
+   const auto task_num = static_cast<int>(std::clamp( corner_num * sizeof( glm::vec3 ) / MinChunkSize, size_t(1), static_cast<size_t>(ThreadNum) ));
+   const size_t task_size = (corner_num + task_num - 1) / task_num;
+   runInParallel( task_num, ThreadNum, [&](int t)
+   {
+      const size_t task_end = std::min( corner_num, (t + 1) * task_size );
+      for (size_t i = t * task_size; i < task_end; ++i) {
+         const Corner& corner = Corners[i];
+         vertices[i] = Positions[corner.Vertex];
+         if (FoundNormals) normals[i] = corner.Normal >= 0 ? Normals[corner.Normal] : glm::vec3(0.0f);
+         if (FoundTextures) textures[i] = corner.Texture >= 0 ? Textures[corner.Texture] : glm::vec2(0.0f);
+      }
+   } );
+}
\ No newline at end of file
@@ -1,18 +1,38 @@
 #include "object.h"
+#include <cstddef>
+#include <cstring>
+#include <numeric>
 
 ObjectGL::ObjectGL() :
-   VAO( 0 ), VBO( 0 ), DrawMode( 0 ), VerticesCount( 0 ), EmissionColor( 0.0f, 0.0f, 0.0f, 1.0f ),
-   AmbientReflectionColor( 0.2f, 0.2f, 0.2f, 1.0f ), DiffuseReflectionColor( 0.8f, 0.8f, 0.8f, 1.0f ),
-   SpecularReflectionColor( 0.0f, 0.0f, 0.0f, 1.0f ), SpecularReflectionExponent( 0.0f )
+   State( LoadState::Ready ), OptimizeMesh( true ), SeparatePositionStream( false ), BuildMeshlets( false ),
+   GenerateLods( false ), Arena( nullptr ), VAO( 0 ), VBO( 0 ), IBO( 0 ), PositionVAO( 0 ), PositionVBO( 0 ),
+   InstanceBuffer( 0 ), InstanceBufferSize( 0 ), IndexType( GL_UNSIGNED_INT ), DrawMode( 0 ), VertexStride( 0 ),
+   VerticesCount( 0 ), IndicesCount( 0 ), BoundingBoxMin( 0.0f ), BoundingBoxMax( 0.0f ), WorldBounds{},
+   GeometryVersion( 0 ), VisibleMeshletNum( 0 ), VisibleInstanceNum( 0 ), DrawnTriangleNum( 0 ),
+   PositionScale( 1.0f ), PositionBias( 0.0f )
 {
 }
 
 ObjectGL::~ObjectGL()
 {
+   if (Arena != nullptr) {
+      // The VAOs belong to the arena.
+      Arena->release( GeometryArenaGL::VertexBuffer, VertexRange );
+      Arena->release( GeometryArenaGL::VertexBuffer, PositionRange );
+      Arena->release( GeometryArenaGL::IndexBuffer, IndexRange );
+      Arena->release( GeometryArenaGL::InstanceBuffer, InstanceRange );
+      VAO = PositionVAO = 0;
+   }
    if (VAO != 0) {
       glDeleteVertexArrays( 1, &VAO );
       glDeleteBuffers( 1, &VBO );
    }
+   if (IBO != 0) glDeleteBuffers( 1, &IBO );
+   if (InstanceBuffer != 0) glDeleteBuffers( 1, &InstanceBuffer );
+   if (PositionVAO != 0) {
+      glDeleteVertexArrays( 1, &PositionVAO );
+      glDeleteBuffers( 1, &PositionVBO );
+   }
    for (const auto& texture_id : TextureID) {
       if (texture_id != 0) glDeleteTextures( 1, &texture_id );
    }
@@ -21,32 +41,7 @@ ObjectGL::~ObjectGL()
    }
 }
 
-void ObjectGL::setEmissionColor(const glm::vec4& emission_color)
-{
-   EmissionColor = emission_color;
-}
-
-void ObjectGL::setAmbientReflectionColor(const glm::vec4& ambient_reflection_color)
-{
-   AmbientReflectionColor = ambient_reflection_color;
-}
-
-void ObjectGL::setDiffuseReflectionColor(const glm::vec4& diffuse_reflection_color)
-{
-   DiffuseReflectionColor = diffuse_reflection_color;
-}
-
-void ObjectGL::setSpecularReflectionColor(const glm::vec4& specular_reflection_color)
-{
-   SpecularReflectionColor = specular_reflection_color;
-}
-
-void ObjectGL::setSpecularReflectionExponent(const float& specular_reflection_exponent)
-{
-   SpecularReflectionExponent = specular_reflection_exponent;
-}
-
-bool ObjectGL::prepareTexture2DUsingFreeImage(const std::string& file_path, bool is_grayscale) const
+bool ObjectGL::decodeImage(ImageData& image, const std::string& file_path, bool is_grayscale)
 {
    const FREE_IMAGE_FORMAT format = FreeImage_GetFileType( file_path.c_str(), 0 );
    FIBITMAP* texture = FreeImage_Load( format, file_path.c_str() );
@@ -62,11 +57,11 @@ bool ObjectGL::prepareTexture2DUsingFreeImage(const std::string& file_path, bool
       texture_converted = n_bits_per_pixel == n_bits ? texture : FreeImage_ConvertTo32Bits( texture );
    }
 
-   const GLsizei width = FreeImage_GetWidth( texture_converted );
-   const GLsizei height = FreeImage_GetHeight( texture_converted );
-   GLvoid* data = FreeImage_GetBits( texture_converted );
-   glTextureStorage2D( TextureID.back(), 1, is_grayscale ? GL_R8 : GL_RGBA8, width, height );
-   glTextureSubImage2D( TextureID.back(), 0, 0, 0, width, height, is_grayscale ? GL_RED : GL_BGRA, GL_UNSIGNED_BYTE, data );
+   image.Width = static_cast<int>(FreeImage_GetWidth( texture_converted ));
+   image.Height = static_cast<int>(FreeImage_GetHeight( texture_converted ));
+   image.IsGrayscale = is_grayscale;
+   const auto* bits = FreeImage_GetBits( texture_converted );
+   image.Pixels.assign( bits, bits + static_cast<size_t>(FreeImage_GetPitch( texture_converted )) * image.Height );
 
    FreeImage_Unload( texture_converted );
    if (n_bits_per_pixel != n_bits) FreeImage_Unload( texture );
@@ -75,21 +70,29 @@ bool ObjectGL::prepareTexture2DUsingFreeImage(const std::string& file_path, bool
 
 int ObjectGL::addTexture(const std::string& texture_file_path, bool is_grayscale)
 {
-   GLuint texture_id = 0;
-   glCreateTextures( GL_TEXTURE_2D, 1, &texture_id );
-   TextureID.emplace_back( texture_id );
-   if (!prepareTexture2DUsingFreeImage( texture_file_path, is_grayscale )) {
-      glDeleteTextures( 1, &texture_id );
-      TextureID.erase( TextureID.end() - 1 );
+   ImageData image;
+   if (!decodeImage( image, texture_file_path, is_grayscale )) {
       std::cerr << "Could not read image file " << texture_file_path.c_str() << "\n";
       return -1;
    }
+   return addTexture( image, image.Pixels.data() );
+}
 
-   glTextureParameteri( texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-   glTextureParameteri( texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-   glTextureParameteri( texture_id, GL_TEXTURE_WRAP_S, GL_REPEAT );
-   glTextureParameteri( texture_id, GL_TEXTURE_WRAP_T, GL_REPEAT );
-   glGenerateTextureMipmap( texture_id );
+int ObjectGL::addTexture(const ImageData& image, const void* pixels)
+{
+   addTexture( image.Width, image.Height, image.IsGrayscale );
+   glTextureSubImage2D(
+      TextureID.back(),
+      0,
+      0,
+      0,
+      image.Width,
+      image.Height,
+      image.IsGrayscale ? GL_RED : GL_BGRA,
+      GL_UNSIGNED_BYTE,
+      pixels
+   );
+   glGenerateTextureMipmap( TextureID.back() );
    return static_cast<int>(TextureID.size() - 1);
 }
 
@@ -131,29 +134,290 @@ int ObjectGL::addTexture(const uint8_t* image_buffer, int width, int height, boo
 
 void ObjectGL::prepareTexture(bool normals_exist) const
 {
-   const uint offset = normals_exist ? 6 : 3;
-   glVertexArrayAttribFormat( VAO, TextureLoc, 2, GL_FLOAT, GL_FALSE, offset * sizeof( GLfloat ) );
+   const uint offset = Format.getTextureOffset( normals_exist );
+   if (Format.Texture == VertexFormat::TextureType::Float16) {
+      glVertexArrayAttribFormat( VAO, TextureLoc, 2, GL_HALF_FLOAT, GL_FALSE, offset );
+   }
+   else glVertexArrayAttribFormat( VAO, TextureLoc, 2, GL_FLOAT, GL_FALSE, offset );
    glEnableVertexArrayAttrib( VAO, TextureLoc );
    glVertexArrayAttribBinding( VAO, TextureLoc, 0 );
 }
 
 void ObjectGL::prepareNormal() const
 {
-   glVertexArrayAttribFormat( VAO, NormalLoc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof( GLfloat ) );
+   const uint offset = Format.getNormalOffset();
+   switch (Format.Normal) {
+      case VertexFormat::NormalType::Octahedral16:
+         glVertexArrayAttribFormat( VAO, NormalLoc, 2, GL_SHORT, GL_TRUE, offset );
+         break;
+      case VertexFormat::NormalType::SNorm10:
+         glVertexArrayAttribFormat( VAO, NormalLoc, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset );
+         break;
+      default:
+         glVertexArrayAttribFormat( VAO, NormalLoc, 3, GL_FLOAT, GL_FALSE, offset );
+         break;
+   }
    glEnableVertexArrayAttrib( VAO, NormalLoc );
    glVertexArrayAttribBinding( VAO, NormalLoc, 0 );
 }
 
-void ObjectGL::prepareVertexBuffer(int n_bytes_per_vertex)
+bool ObjectGL::reallocate(
+   GeometryArenaGL::BufferType type,
+   GLsizeiptr size,
+   GLsizeiptr alignment,
+   GeometryArenaGL::Range& range
+)
+{
+   Arena->release( type, range );
+   if (Arena->allocate( type, size, alignment, range )) return true;
+
+   // Nothing may be written to an empty range, and the renderer skips objects that are not ready.
+   State = LoadState::Failed;
+   return false;
+}
+
+void ObjectGL::prepareVertexBuffer(const void* data, GLsizeiptr size, int n_bytes_per_vertex, uint32_t location_mask)
+{
+   VertexStride = n_bytes_per_vertex;
+   if (Arena != nullptr) {
+      if (reallocate( GeometryArenaGL::VertexBuffer, size, n_bytes_per_vertex, VertexRange ) && data != nullptr) {
+         glNamedBufferSubData( getVBO(), VertexRange.Offset, size, data );
+      }
+      VAO = Arena->getVertexArray( getLayoutKey( location_mask ), n_bytes_per_vertex, sizeof( Instance ) );
+   }
+   else {
+      glCreateBuffers( 1, &VBO );
+      glNamedBufferStorage( VBO, size, data, GL_DYNAMIC_STORAGE_BIT );
+
+      glCreateVertexArrays( 1, &VAO );
+      glVertexArrayVertexBuffer( VAO, 0, VBO, 0, n_bytes_per_vertex );
+   }
+   // Without an instance of its own, the object would be drawn with whichever instance is at offset 0 of the arena,
+   // or with disabled instance attributes, which read as a matrix that collapses every vertex.
+   if (Instances.empty()) setInstances( { Instance() } );
+   setPositionAttribute( VAO );
+   setInstanceAttributes( VAO );
+}
+
+void ObjectGL::setPositionAttribute(GLuint vao) const
+{
+   switch (Format.Position) {
+      case VertexFormat::PositionType::Float16:
+         glVertexArrayAttribFormat( vao, VertexLoc, 3, GL_HALF_FLOAT, GL_FALSE, 0 );
+         break;
+      case VertexFormat::PositionType::UNorm16:
+         glVertexArrayAttribFormat( vao, VertexLoc, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0 );
+         break;
+      default:
+         glVertexArrayAttribFormat( vao, VertexLoc, 3, GL_FLOAT, GL_FALSE, 0 );
+         break;
+   }
+   glEnableVertexArrayAttrib( vao, VertexLoc );
+   glVertexArrayAttribBinding( vao, VertexLoc, 0 );
+}
+
+void ObjectGL::setInstanceAttributes(GLuint vao) const
+{
+   if (vao == 0) return;
+
+   // The VAOs of the arena read its instance buffer already, and the base instance picks the range of each object.
+   if (Arena == nullptr) {
+      if (InstanceBuffer == 0) return;
+
+      glVertexArrayVertexBuffer( vao, 1, InstanceBuffer, 0, sizeof( Instance ) );
+      glVertexArrayBindingDivisor( vao, 1, 1 );
+   }
+   for (GLuint i = 0; i < 4; ++i) {
+      const GLuint location = InstanceToWorldLoc + i;
+      glVertexArrayAttribFormat(
+         vao, location, 4, GL_FLOAT, GL_FALSE, static_cast<GLuint>(offsetof( Instance, ToWorld ) + sizeof( glm::vec4 ) * i)
+      );
+      glEnableVertexArrayAttrib( vao, location );
+      glVertexArrayAttribBinding( vao, location, 1 );
+   }
+   glVertexArrayAttribIFormat( vao, InstanceMaterialLoc, 1, GL_INT, offsetof( Instance, MaterialIndex ) );
+   glEnableVertexArrayAttrib( vao, InstanceMaterialLoc );
+   glVertexArrayAttribBinding( vao, InstanceMaterialLoc, 1 );
+}
+
+ObjectGL::Bounds ObjectGL::transformBounds(
+   const glm::mat4& to_world,
+   const glm::vec3& bounds_min,
+   const glm::vec3& bounds_max
+)
+{
+   const glm::vec3 center(to_world * glm::vec4(0.5f * (bounds_min + bounds_max), 1.0f));
+   const glm::vec3 extent = 0.5f * (bounds_max - bounds_min);
+   glm::vec3 world_extent(0.0f);
+   for (int i = 0; i < 3; ++i) world_extent += glm::abs( glm::vec3(to_world[i]) ) * extent[i];
+   return { center - world_extent, center + world_extent };
+}
+
+void ObjectGL::updateWorldBounds()
+{
+   // An object without instances is drawn nowhere, so its bounds are empty and outside of every frustum.
+   InstanceWorldBounds.clear();
+   InstanceWorldBounds.reserve( Instances.size() );
+   for (const auto& instance : Instances) {
+      InstanceWorldBounds.emplace_back( transformBounds( instance.ToWorld, BoundingBoxMin, BoundingBoxMax ) );
+   }
+
+   WorldBounds = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+   for (const auto& bounds : InstanceWorldBounds) {
+      WorldBounds.Min = glm::min( WorldBounds.Min, bounds.Min );
+      WorldBounds.Max = glm::max( WorldBounds.Max, bounds.Max );
+   }
+   GeometryVersion++;
+}
+
+void ObjectGL::updateVertexBounds(size_t float_stride)
+{
+   MeshCache::getBounds( BoundingBoxMin, BoundingBoxMax, DataBuffer.data(), VerticesCount, float_stride );
+   // The simplified indices stay in the buffer after the full mesh, but only IndicesCount of them are drawn.
+   Meshlets.clear();
+   Lods.clear();
+   updateWorldBounds();
+}
+
+void ObjectGL::setInstances(const std::vector<Instance>& instances)
+{
+   Instances = instances;
+   updateWorldBounds();
+   if (Instances.empty()) {
+      if (Arena != nullptr) Arena->release( GeometryArenaGL::InstanceBuffer, InstanceRange );
+      return;
+   }
+
+   const auto size = static_cast<GLsizeiptr>(sizeof( Instance ) * Instances.size());
+   if (Arena != nullptr) {
+      if (size != InstanceRange.Size) {
+         if (!reallocate( GeometryArenaGL::InstanceBuffer, size, sizeof( Instance ), InstanceRange )) return;
+      }
+      glNamedBufferSubData( Arena->getBuffer( GeometryArenaGL::InstanceBuffer ), InstanceRange.Offset, size, Instances.data() );
+      return;
+   }
+   if (size > InstanceBufferSize) {
+      if (InstanceBuffer != 0) glDeleteBuffers( 1, &InstanceBuffer );
+      glCreateBuffers( 1, &InstanceBuffer );
+      glNamedBufferStorage( InstanceBuffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT );
+      InstanceBufferSize = size;
+      setInstanceAttributes( VAO );
+      setInstanceAttributes( PositionVAO );
+   }
+   glNamedBufferSubData( InstanceBuffer, 0, size, Instances.data() );
+}
+
+void ObjectGL::getPositionStream(
+   std::vector<uint8_t>& positions,
+   const void* data,
+   GLsizei vertex_num,
+   int n_bytes_per_vertex,
+   uint position_size
+)
+{
+   // The position always comes first in a vertex, so the stream is the head of every interleaved vertex.
+   positions.resize( static_cast<size_t>(vertex_num) * position_size );
+   const auto* vertex = static_cast<const uint8_t*>(data);
+   for (GLsizei i = 0; i < vertex_num; ++i) {
+      std::memcpy( positions.data() + static_cast<size_t>(i) * position_size, vertex, position_size );
+      vertex += n_bytes_per_vertex;
+   }
+}
+
+void ObjectGL::preparePositionBuffer(const void* data, int n_bytes_per_vertex)
+{
+   if (!SeparatePositionStream) return;
+
+   std::vector<uint8_t> positions;
+   getPositionStream( positions, data, VerticesCount, n_bytes_per_vertex, Format.getPositionSize() );
+   createPositionBuffer( positions.data(), static_cast<GLsizeiptr>(positions.size()) );
+}
+
+void ObjectGL::createPositionBuffer(const void* positions, GLsizeiptr size)
 {
-   glCreateBuffers( 1, &VBO );
-   glNamedBufferStorage( VBO, sizeof( GLfloat ) * DataBuffer.size(), DataBuffer.data(), GL_DYNAMIC_STORAGE_BIT );
+   const auto position_size = static_cast<GLsizei>(Format.getPositionSize());
+   if (Arena != nullptr) {
+      if (reallocate( GeometryArenaGL::VertexBuffer, size, position_size, PositionRange ) && positions != nullptr) {
+         glNamedBufferSubData( getPositionVBO(), PositionRange.Offset, size, positions );
+      }
+      PositionVAO = Arena->getVertexArray( getLayoutKey( 1u << VertexLoc ), position_size, sizeof( Instance ) );
+   }
+   else {
+      glCreateBuffers( 1, &PositionVBO );
+      glNamedBufferStorage( PositionVBO, size, positions, GL_DYNAMIC_STORAGE_BIT );
 
-   glCreateVertexArrays( 1, &VAO );
-   glVertexArrayVertexBuffer( VAO, 0, VBO, 0, n_bytes_per_vertex );
-   glVertexArrayAttribFormat( VAO, VertexLoc, 3, GL_FLOAT, GL_FALSE, 0 );
-   glEnableVertexArrayAttrib( VAO, VertexLoc );
-   glVertexArrayAttribBinding( VAO, VertexLoc, 0 );
+      glCreateVertexArrays( 1, &PositionVAO );
+      glVertexArrayVertexBuffer( PositionVAO, 0, PositionVBO, 0, position_size );
+   }
+   setPositionAttribute( PositionVAO );
+   setInstanceAttributes( PositionVAO );
+}
+
+void ObjectGL::updatePositionBuffer(const void* data)
+{
+   if (getPositionVBO() == 0 || VerticesCount == 0) return;
+
+   std::vector<uint8_t> positions;
+   getPositionStream( positions, data, VerticesCount, VertexStride, Format.getPositionSize() );
+   glNamedBufferSubData(
+      getPositionVBO(), PositionRange.Offset, static_cast<GLsizeiptr>(positions.size()), positions.data()
+   );
+}
+
+void ObjectGL::prepareIndexBuffer(const void* data, GLsizeiptr size, GLenum index_type, GLsizei index_num)
+{
+   if (Arena != nullptr) {
+      const GLsizeiptr index_size = index_type == GL_UNSIGNED_SHORT ? sizeof( GLushort ) : sizeof( GLuint );
+      if (reallocate( GeometryArenaGL::IndexBuffer, size, index_size, IndexRange ) && data != nullptr) {
+         glNamedBufferSubData( getIBO(), IndexRange.Offset, size, data );
+      }
+   }
+   else {
+      glCreateBuffers( 1, &IBO );
+      glNamedBufferStorage( IBO, size, data, GL_DYNAMIC_STORAGE_BIT );
+      glVertexArrayElementBuffer( VAO, IBO );
+      if (PositionVAO != 0) glVertexArrayElementBuffer( PositionVAO, IBO );
+   }
+   IndexType = index_type;
+   IndicesCount = index_num;
+}
+
+void ObjectGL::setPositionDequantization()
+{
+   if (Format.Position == VertexFormat::PositionType::UNorm16) {
+      PositionScale = BoundingBoxMax - BoundingBoxMin;
+      PositionBias = BoundingBoxMin;
+   }
+   else {
+      PositionScale = glm::vec3(1.0f);
+      PositionBias = glm::vec3(0.0f);
+   }
+}
+
+void ObjectGL::prepareSequentialIndices()
+{
+   // A multi-draw only takes indexed meshes, so the meshes in an arena get trivial indices.
+   std::vector<GLuint> indices(VerticesCount);
+   std::iota( indices.begin(), indices.end(), 0u );
+   prepareIndexBuffer(
+      indices.data(), static_cast<GLsizeiptr>(sizeof( GLuint ) * indices.size()), GL_UNSIGNED_INT, VerticesCount
+   );
+}
+
+void ObjectGL::prepareVertexBuffer(int n_bytes_per_vertex, uint32_t location_mask)
+{
+   Format = VertexFormat();
+   setPositionDequantization();
+   MeshCache::getBounds( BoundingBoxMin, BoundingBoxMax, DataBuffer.data(), VerticesCount, n_bytes_per_vertex );
+   updateWorldBounds();
+   prepareVertexBuffer(
+      DataBuffer.data(),
+      static_cast<GLsizeiptr>(sizeof( GLfloat ) * DataBuffer.size()),
+      n_bytes_per_vertex,
+      location_mask
+   );
+   preparePositionBuffer( DataBuffer.data(), n_bytes_per_vertex );
+   if (Arena != nullptr) prepareSequentialIndices();
 }
 
 void ObjectGL::getSquareObject(
@@ -193,17 +457,7 @@ void ObjectGL::getSquareObject(
 
 void ObjectGL::setObject(GLenum draw_mode, const std::vector<glm::vec3>& vertices)
 {
-   DrawMode = draw_mode;
-   VerticesCount = 0;
-   DataBuffer.clear();
-   for (auto& vertex : vertices) {
-      DataBuffer.push_back( vertex.x );
-      DataBuffer.push_back( vertex.y );
-      DataBuffer.push_back( vertex.z );
-      VerticesCount++;
-   }
-   const int n_bytes_per_vertex = 3 * sizeof( GLfloat );
-   prepareVertexBuffer( n_bytes_per_vertex );
+   setInterleavedObject<PositionLayout>( draw_mode, vertices );
 }
 
 void ObjectGL::setObject(
@@ -212,21 +466,7 @@ void ObjectGL::setObject(
    const std::vector<glm::vec3>& normals
 )
 {
-   DrawMode = draw_mode;
-   VerticesCount = 0;
-   DataBuffer.clear();
-   for (size_t i = 0; i < vertices.size(); ++i) {
-      DataBuffer.push_back( vertices[i].x );
-      DataBuffer.push_back( vertices[i].y );
-      DataBuffer.push_back( vertices[i].z );
-      DataBuffer.push_back( normals[i].x );
-      DataBuffer.push_back( normals[i].y );
-      DataBuffer.push_back( normals[i].z );
-      VerticesCount++;
-   }
-   const int n_bytes_per_vertex = 6 * sizeof( GLfloat );
-   prepareVertexBuffer( n_bytes_per_vertex );
-   prepareNormal();
+   setInterleavedObject<PositionNormalLayout>( draw_mode, vertices, normals );
 }
 
 void ObjectGL::setObject(
@@ -237,20 +477,7 @@ void ObjectGL::setObject(
    bool is_grayscale
 )
 {
-   DrawMode = draw_mode;
-   VerticesCount = 0;
-   DataBuffer.clear();
-   for (size_t i = 0; i < vertices.size(); ++i) {
-      DataBuffer.push_back( vertices[i].x );
-      DataBuffer.push_back( vertices[i].y );
-      DataBuffer.push_back( vertices[i].z );
-      DataBuffer.push_back( textures[i].x );
-      DataBuffer.push_back( textures[i].y );
-      VerticesCount++;
-   }
-   const int n_bytes_per_vertex = 5 * sizeof( GLfloat );
-   prepareVertexBuffer( n_bytes_per_vertex );
-   prepareTexture( false );
+   setInterleavedObject<PositionTextureLayout>( draw_mode, vertices, textures );
    addTexture( texture_file_path, is_grayscale );
 }
 
@@ -261,24 +488,7 @@ void ObjectGL::setObject(
    const std::vector<glm::vec2>& textures
 )
 {
-   DrawMode = draw_mode;
-   VerticesCount = 0;
-   DataBuffer.clear();
-   for (size_t i = 0; i < vertices.size(); ++i) {
-      DataBuffer.push_back( vertices[i].x );
-      DataBuffer.push_back( vertices[i].y );
-      DataBuffer.push_back( vertices[i].z );
-      DataBuffer.push_back( normals[i].x );
-      DataBuffer.push_back( normals[i].y );
-      DataBuffer.push_back( normals[i].z );
-      DataBuffer.push_back( textures[i].x );
-      DataBuffer.push_back( textures[i].y );
-      VerticesCount++;
-   }
-   const int n_bytes_per_vertex = 8 * sizeof( GLfloat );
-   prepareVertexBuffer( n_bytes_per_vertex );
-   prepareNormal();
-   prepareTexture( true );
+   setInterleavedObject<PositionNormalTextureLayout>( draw_mode, vertices, normals, textures );
 }
 
 void ObjectGL::setObject(
@@ -294,98 +504,174 @@ void ObjectGL::setObject(
    addTexture( texture_file_path, is_grayscale );
 }
 
-bool ObjectGL::readObjectFile(
-   std::vector<glm::vec3>& vertices,
-   std::vector<glm::vec3>& normals,
-   std::vector<glm::vec2>& textures,
-   const std::string& file_path
-)
+void ObjectGL::buildMeshlets(MeshData& mesh, const std::vector<uint32_t>& indices)
 {
-   std::ifstream file(file_path);
-   if (!file.is_open()) {
-      std::cout << "The object file is not correct.\n";
-      return false;
+   std::vector<glm::vec3> positions(mesh.VertexNum);
+   const auto* vertex = static_cast<const uint8_t*>(mesh.VertexData);
+   for (auto& position : positions) {
+      position = mesh.Format.decodePosition( vertex, mesh.BoundsMin, mesh.BoundsMax );
+      vertex += mesh.VertexStride;
    }
+   MeshletBuilder::build( mesh.Meshlets, indices, positions );
+}
 
-   bool found_normals = false, found_textures = false;
-   std::vector<glm::vec3> vertex_buffer, normal_buffer;
-   std::vector<glm::vec2> texture_buffer;
-   std::vector<int> vertex_indices, normal_indices, texture_indices;
-   while (!file.eof()) {
-      std::string word;
-      file >> word;
-
-      if (word == "v") {
-         glm::vec3 vertex;
-         file >> vertex.x >> vertex.y >> vertex.z;
-         vertex_buffer.emplace_back( vertex );
-      }
-      else if (word == "vt") {
-         glm::vec2 uv;
-         file >> uv.x >> uv.y;
-         texture_buffer.emplace_back( uv );
-         found_textures = true;
-      }
-      else if (word == "vn") {
-         glm::vec3 normal;
-         file >> normal.x >> normal.y >> normal.z;
-         normal_buffer.emplace_back( normal );
-         found_normals = true;
-      }
-      else if (word == "f") {
-         std::string face;
-         const std::regex delimiter("[/]");
-         for (int i = 0; i < 3; ++i) {
-            file >> face;
-            const std::sregex_token_iterator it(face.begin(), face.end(), delimiter, -1);
-            const std::vector<std::string> vtn(it, std::sregex_token_iterator());
-            vertex_indices.emplace_back( std::stoi( vtn[0] ) );
-            if (found_textures) texture_indices.emplace_back( std::stoi( vtn[1] ) );
-            if (found_normals) normal_indices.emplace_back( std::stoi( vtn[2] ) );
+bool ObjectGL::loadMeshCache(MeshData& mesh, const std::string& obj_file_path) const
+{
+   const std::string cache_path = MeshCache::getCachePath( obj_file_path );
+   if (!MeshCache::isUpToDate( cache_path, obj_file_path )) return false;
+
+   auto cache = std::make_unique<MeshCache>( cache_path );
+   if (!cache->isValid()) return false;
+
+   const MeshCache::Header& header = cache->getHeader();
+   if (OptimizeMesh && (header.ProcessingFlags & MeshCache::Optimized) == 0) return false;
+   if (header.PackedVertexFormat != RequestedFormat.pack()) return false;
+   if (GenerateLods && (header.ProcessingFlags & MeshCache::Simplified) == 0) return false;
+
+   // The mapped file goes to the driver as is; nothing is copied into FloatVertices.
+   mesh.NormalsExist = (header.LayoutFlags & MeshCache::HasNormals) != 0;
+   mesh.TexturesExist = (header.LayoutFlags & MeshCache::HasTextures) != 0;
+   mesh.VertexStride = static_cast<int>(header.VertexStride);
+   mesh.VertexNum = static_cast<GLsizei>(header.VertexNum);
+   mesh.IndexType = header.IndexSize == sizeof( GLushort ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+   mesh.Format = RequestedFormat;
+   mesh.BoundsMin = header.BoundsMin;
+   mesh.BoundsMax = header.BoundsMax;
+   mesh.VertexData = cache->getVertexData();
+   mesh.VertexDataSize = static_cast<GLsizeiptr>(cache->getVertexDataSize());
+   if (header.IndexNum > 0) {
+      mesh.IndexData = cache->getIndexData();
+      mesh.IndexDataSize = static_cast<GLsizeiptr>(cache->getIndexDataSize());
+      mesh.Lods.assign( cache->getLods(), cache->getLods() + header.LodNum );
+      if (BuildMeshlets) {
+         std::vector<uint32_t> indices(mesh.Lods.empty() ? header.IndexNum : mesh.Lods[0].IndexNum);
+         if (header.IndexSize == sizeof( GLushort )) {
+            const auto* short_indices = static_cast<const GLushort*>(mesh.IndexData);
+            std::copy( short_indices, short_indices + indices.size(), indices.begin() );
          }
+         else std::memcpy( indices.data(), mesh.IndexData, indices.size() * sizeof( uint32_t ) );
+         buildMeshlets( mesh, indices );
       }
-      else std::getline( file, word );
    }
+   if (SeparatePositionStream) {
+      getPositionStream( mesh.Positions, mesh.VertexData, mesh.VertexNum, mesh.VertexStride, mesh.Format.getPositionSize() );
+   }
+   mesh.Cache = std::move( cache );
+   return true;
+}
+
+void ObjectGL::writeMeshCache(const MeshData& mesh, const std::string& obj_file_path, uint32_t layout_flags) const
+{
+   MeshCache::Header header{};
+   header.LayoutFlags = layout_flags;
+   header.VertexStride = mesh.VertexStride;
+   header.VertexNum = mesh.VertexNum;
+   header.IndexNum = mesh.Indices.size();
+   header.IndexSize = mesh.IndexType == GL_UNSIGNED_SHORT ? sizeof( GLushort ) : sizeof( GLuint );
+   header.ProcessingFlags = (OptimizeMesh ? MeshCache::Optimized : 0u) | (GenerateLods ? MeshCache::Simplified : 0u);
+   header.PackedVertexFormat = mesh.Format.pack();
+   header.BoundsMin = mesh.BoundsMin;
+   header.BoundsMax = mesh.BoundsMax;
+   header.LodNum = static_cast<uint32_t>(mesh.Lods.size());
+   const std::string cache_path = MeshCache::getCachePath( obj_file_path );
+   if (!MeshCache::write( cache_path, header, mesh.VertexData, mesh.IndexData, mesh.Lods.data() )) {
+      std::cerr << "Could not write the mesh cache " << cache_path << "\n";
+   }
+}
 
-   for (uint i = 0; i < vertex_indices.size(); ++i) {
-      vertices.emplace_back( vertex_buffer[vertex_indices[i] - 1] );
-      if (found_normals) normals.emplace_back( normal_buffer[normal_indices[i] - 1] );
-      if (found_textures) textures.emplace_back( texture_buffer[texture_indices[i] - 1] );
+bool ObjectGL::prepareMeshData(MeshData& mesh, const std::string& obj_file_path) const
+{
+   if (loadMeshCache( mesh, obj_file_path )) return true;
+
+   uint32_t layout_flags = 0;
+   if (!MeshCache::build(
+      mesh.FloatVertices, mesh.Indices, mesh.Lods, layout_flags, obj_file_path, OptimizeMesh, GenerateLods
+   )) return false;
+
+   mesh.NormalsExist = (layout_flags & MeshCache::HasNormals) != 0;
+   mesh.TexturesExist = (layout_flags & MeshCache::HasTextures) != 0;
+   const uint32_t float_stride = MeshCache::getVertexStride( layout_flags );
+   mesh.VertexNum = static_cast<GLsizei>(mesh.FloatVertices.size() * sizeof( GLfloat ) / float_stride);
+   MeshCache::getBounds( mesh.BoundsMin, mesh.BoundsMax, mesh.FloatVertices.data(), mesh.VertexNum, float_stride );
+   mesh.Format = RequestedFormat;
+   mesh.VertexStride = static_cast<int>(mesh.Format.getStride( mesh.NormalsExist, mesh.TexturesExist ));
+   mesh.VertexData = mesh.FloatVertices.data();
+   if (!mesh.Format.isFloat32()) {
+      mesh.Format.encode(
+         mesh.EncodedVertices, mesh.FloatVertices, mesh.NormalsExist, mesh.TexturesExist, mesh.BoundsMin, mesh.BoundsMax
+      );
+      mesh.Format.reportError(
+         obj_file_path, mesh.EncodedVertices, mesh.FloatVertices,
+         mesh.NormalsExist, mesh.TexturesExist, mesh.BoundsMin, mesh.BoundsMax
+      );
+      mesh.VertexData = mesh.EncodedVertices.data();
+   }
+   mesh.VertexDataSize = static_cast<GLsizeiptr>(mesh.VertexNum) * mesh.VertexStride;
+
+   const uint32_t index_size = MeshCache::getIndexSize( mesh.VertexNum );
+   mesh.IndexType = index_size == sizeof( GLushort ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+   mesh.IndexData = mesh.Indices.data();
+   if (index_size == sizeof( GLushort )) {
+      mesh.ShortIndices.assign( mesh.Indices.begin(), mesh.Indices.end() );
+      mesh.IndexData = mesh.ShortIndices.data();
    }
+   mesh.IndexDataSize = static_cast<GLsizeiptr>(mesh.Indices.size() * index_size);
+   if (BuildMeshlets) {
+      const size_t lod0_index_num = mesh.Lods.empty() ? mesh.Indices.size() : mesh.Lods[0].IndexNum;
+      buildMeshlets( mesh, std::vector<uint32_t>(mesh.Indices.begin(), mesh.Indices.begin() + lod0_index_num) );
+   }
+   if (SeparatePositionStream) {
+      getPositionStream( mesh.Positions, mesh.VertexData, mesh.VertexNum, mesh.VertexStride, mesh.Format.getPositionSize() );
+   }
+   writeMeshCache( mesh, obj_file_path, layout_flags );
    return true;
 }
 
-void ObjectGL::setObject(GLenum draw_mode, const std::string& obj_file_path)
+void ObjectGL::setObject(GLenum draw_mode, const MeshData& mesh, bool upload)
 {
    DrawMode = draw_mode;
-   std::vector<glm::vec3> vertices, normals;
-   std::vector<glm::vec2> textures;
-   readObjectFile( vertices, normals, textures, obj_file_path );
-
-   const bool normals_exist = !normals.empty();
-   const bool textures_exist = !textures.empty();
-   for (uint i = 0; i < vertices.size(); ++i) {
-      DataBuffer.push_back( vertices[i].x );
-      DataBuffer.push_back( vertices[i].y );
-      DataBuffer.push_back( vertices[i].z );
-      if (normals_exist) {
-         DataBuffer.push_back( normals[i].x );
-         DataBuffer.push_back( normals[i].y );
-         DataBuffer.push_back( normals[i].z );
-      }
-      if (textures_exist) {
-         DataBuffer.push_back( textures[i].x );
-         DataBuffer.push_back( textures[i].y );
-      }
-      VerticesCount++;
+   VerticesCount = mesh.VertexNum;
+   BoundingBoxMin = mesh.BoundsMin;
+   BoundingBoxMax = mesh.BoundsMax;
+   updateWorldBounds();
+   Format = mesh.Format;
+   setPositionDequantization();
+   const uint32_t location_mask = 1u << VertexLoc |
+      (mesh.NormalsExist ? 1u << NormalLoc : 0u) | (mesh.TexturesExist ? 1u << TextureLoc : 0u);
+   prepareVertexBuffer( upload ? mesh.VertexData : nullptr, mesh.VertexDataSize, mesh.VertexStride, location_mask );
+   if (!mesh.Positions.empty()) {
+      createPositionBuffer(
+         upload ? mesh.Positions.data() : nullptr,
+         static_cast<GLsizeiptr>(mesh.Positions.size())
+      );
    }
-   int n = 3;
-   if (normals_exist) n += 3;
-   if (textures_exist) n += 2;
-   const auto n_bytes_per_vertex = static_cast<int>(n * sizeof( GLfloat ));
-   prepareVertexBuffer( n_bytes_per_vertex );
-   if (normals_exist) prepareNormal();
-   if (textures_exist) prepareTexture( normals_exist );
+   if (mesh.NormalsExist) prepareNormal();
+   if (mesh.TexturesExist) prepareTexture( mesh.NormalsExist );
+   if (mesh.IndexDataSize > 0) {
+      const size_t index_size = mesh.IndexType == GL_UNSIGNED_SHORT ? sizeof( GLushort ) : sizeof( GLuint );
+      Lods = mesh.Lods;
+      prepareIndexBuffer(
+         upload ? mesh.IndexData : nullptr,
+         mesh.IndexDataSize,
+         mesh.IndexType,
+         static_cast<GLsizei>(Lods.empty() ? mesh.IndexDataSize / index_size : Lods[0].IndexNum)
+      );
+   }
+   else if (Arena != nullptr) prepareSequentialIndices();
+   Meshlets = mesh.Meshlets;
+}
+
+void ObjectGL::setObject(GLenum draw_mode, const std::string& obj_file_path)
+{
+   MeshData mesh;
+   if (!prepareMeshData( mesh, obj_file_path )) return;
+
+   setObject( draw_mode, mesh );
+
+   // replaceVertices edits the float vertices. A mesh that was just built has them already, but a mesh from the cache
+   // only has them in the mapped file, so a float one reads them back from the vertex buffer when they are replaced.
+   if (!mesh.FloatVertices.empty()) DataBuffer.swap( mesh.FloatVertices );
+   else DataBuffer.clear();
 }
 
 void ObjectGL::setObject(
@@ -394,31 +680,7 @@ void ObjectGL::setObject(
    const std::string& texture_file_name
 )
 {
-   DrawMode = draw_mode;
-   std::vector<glm::vec3> vertices, normals;
-   std::vector<glm::vec2> textures;
-   readObjectFile( vertices, normals, textures, obj_file_path );
-
-   assert( !textures.empty() );
-
-   const bool normals_exist = !normals.empty();
-   for (uint i = 0; i < vertices.size(); ++i) {
-      DataBuffer.push_back( vertices[i].x );
-      DataBuffer.push_back( vertices[i].y );
-      DataBuffer.push_back( vertices[i].z );
-      if (normals_exist) {
-         DataBuffer.push_back( normals[i].x );
-         DataBuffer.push_back( normals[i].y );
-         DataBuffer.push_back( normals[i].z );
-      }
-      DataBuffer.push_back( textures[i].x );
-      DataBuffer.push_back( textures[i].y );
-      VerticesCount++;
-   }
-   const int n_bytes_per_vertex = normals_exist ? 8 * sizeof( GLfloat ) : 5 * sizeof( GLfloat );
-   prepareVertexBuffer( n_bytes_per_vertex );
-   if (normals_exist) prepareNormal();
-   prepareTexture( normals_exist );
+   setObject( draw_mode, obj_file_path );
    addTexture( texture_file_name );
 }
 
@@ -443,31 +705,9 @@ void ObjectGL::setSquareObject(
    setObject( draw_mode, square_vertices, square_normals, square_textures, texture_file_path, is_grayscale );
 }
 
-void ObjectGL::transferUniformsToShader(const ShaderGL* shader)
-{
-   glUniform4fv( shader->getMaterialEmissionLocation(), 1, &EmissionColor[0] );
-   glUniform4fv( shader->getMaterialAmbientLocation(), 1, &AmbientReflectionColor[0] );
-   glUniform4fv( shader->getMaterialDiffuseLocation(), 1, &DiffuseReflectionColor[0] );
-   glUniform4fv( shader->getMaterialSpecularLocation(), 1, &SpecularReflectionColor[0] );
-   glUniform1f( shader->getMaterialSpecularExponentLocation(), SpecularReflectionExponent );
-}
-
 void ObjectGL::updateDataBuffer(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals)
 {
-   assert( VBO != 0 );
-
-   VerticesCount = 0;
-   DataBuffer.clear();
-   for (size_t i = 0; i < vertices.size(); ++i) {
-      DataBuffer.push_back( vertices[i].x );
-      DataBuffer.push_back( vertices[i].y );
-      DataBuffer.push_back( vertices[i].z );
-      DataBuffer.push_back( normals[i].x );
-      DataBuffer.push_back( normals[i].y );
-      DataBuffer.push_back( normals[i].z );
-      VerticesCount++;
-   }
-   glNamedBufferSubData( VBO, 0, static_cast<GLsizeiptr>(sizeof( GLfloat ) * DataBuffer.size()), DataBuffer.data() );
+   updateInterleavedData<PositionNormalLayout>( vertices, normals );
 }
 
 void ObjectGL::updateDataBuffer(
@@ -476,22 +716,234 @@ void ObjectGL::updateDataBuffer(
    const std::vector<glm::vec2>& textures
 )
 {
-   assert( VBO != 0 );
+   updateInterleavedData<PositionNormalTextureLayout>( vertices, normals, textures );
+}
 
-   VerticesCount = 0;
-   DataBuffer.clear();
-   for (size_t i = 0; i < vertices.size(); ++i) {
-      DataBuffer.push_back( vertices[i].x );
-      DataBuffer.push_back( vertices[i].y );
-      DataBuffer.push_back( vertices[i].z );
-      DataBuffer.push_back( normals[i].x );
-      DataBuffer.push_back( normals[i].y );
-      DataBuffer.push_back( normals[i].z );
-      DataBuffer.push_back( textures[i].x );
-      DataBuffer.push_back( textures[i].y );
-      VerticesCount++;
+GLint ObjectGL::getBaseVertex(bool position_only) const
+{
+   if (position_only && PositionRange.Size > 0) {
+      return static_cast<GLint>(PositionRange.Offset / static_cast<GLintptr>(Format.getPositionSize()));
    }
-   glNamedBufferSubData( VBO, 0, static_cast<GLsizeiptr>(sizeof( GLfloat ) * DataBuffer.size()), DataBuffer.data() );
+   return VertexStride > 0 ? static_cast<GLint>(VertexRange.Offset / VertexStride) : 0;
+}
+
+void ObjectGL::drawCommand(const DrawElementsIndirectCommand& command) const
+{
+   const size_t index_size = IndexType == GL_UNSIGNED_SHORT ? sizeof( GLushort ) : sizeof( GLuint );
+   glDrawElementsInstancedBaseVertexBaseInstance(
+      DrawMode,
+      static_cast<GLsizei>(command.Count),
+      IndexType,
+      reinterpret_cast<const void*>(static_cast<uintptr_t>(command.FirstIndex * index_size)),
+      static_cast<GLsizei>(command.InstanceCount),
+      command.BaseVertex,
+      command.BaseInstance
+   );
+}
+
+void ObjectGL::draw(bool position_only) const
+{
+   if (Arena != nullptr) drawCommand( getDrawCommand( 0, position_only ) );
+   else if (IBO != 0) glDrawElementsInstanced( DrawMode, IndicesCount, IndexType, nullptr, getInstanceNum() );
+   else glDrawArraysInstanced( DrawMode, 0, VerticesCount, getInstanceNum() );
+}
+
+DrawElementsIndirectCommand ObjectGL::getDrawCommand(int lod, bool position_only) const
+{
+   assert( isIndexed() );
+
+   const size_t index_size = IndexType == GL_UNSIGNED_SHORT ? sizeof( GLushort ) : sizeof( GLuint );
+   DrawElementsIndirectCommand command{
+      static_cast<GLuint>(IndicesCount), static_cast<GLuint>(getInstanceNum()),
+      static_cast<GLuint>(IndexRange.Offset / index_size), getBaseVertex( position_only ), getBaseInstance()
+   };
+   if (lod > 0 && lod < static_cast<int>(Lods.size())) {
+      command.Count = static_cast<GLuint>(Lods[lod].IndexNum);
+      command.FirstIndex += static_cast<GLuint>(Lods[lod].IndexOffset);
+   }
+   return command;
+}
+
+int ObjectGL::selectLod(float max_error) const
+{
+   int lod = 0;
+   for (int i = 1; i < static_cast<int>(Lods.size()); ++i) {
+      if (Lods[i].Error <= max_error) lod = i;
+   }
+   return lod;
+}
+
+void ObjectGL::appendDrawCommands(
+   std::vector<DrawElementsIndirectCommand>& commands,
+   const glm::mat4& world_to_clip,
+   bool cull_backfaces,
+   int lod,
+   bool position_only
+)
+{
+   const DrawElementsIndirectCommand command = getDrawCommand( lod, position_only );
+   const MeshletCuller world_culler(world_to_clip);
+   VisibleMeshletNum = 0;
+   VisibleInstanceNum = 0;
+   DrawnTriangleNum = 0;
+   if (!world_culler.isInsideFrustum( WorldBounds.Min, WorldBounds.Max )) return;
+
+   if (!isDrawnAsMeshlets( lod )) {
+      GLuint first = 0;
+      for (GLuint i = 0; i <= command.InstanceCount; ++i) {
+         if (i < command.InstanceCount &&
+             world_culler.isInsideFrustum( InstanceWorldBounds[i].Min, InstanceWorldBounds[i].Max )) continue;
+
+         if (i > first) {
+            commands.push_back(
+               { command.Count, i - first, command.FirstIndex, command.BaseVertex, command.BaseInstance + first }
+            );
+            VisibleInstanceNum += i - first;
+         }
+         first = i + 1;
+      }
+      DrawnTriangleNum = static_cast<size_t>(command.Count / 3) * VisibleInstanceNum;
+      return;
+   }
+
+   const MeshletCuller culler(world_to_clip * getFirstInstanceToWorld());
+   VisibleMeshletNum = culler.getVisibleRanges( VisibleRanges, Meshlets, cull_backfaces );
+   VisibleInstanceNum = VisibleMeshletNum > 0 ? 1 : 0;
+   for (const auto& range : VisibleRanges) {
+      commands.push_back(
+         {
+            static_cast<GLuint>(range.Count), 1, command.FirstIndex + static_cast<GLuint>(range.Offset),
+            command.BaseVertex, command.BaseInstance
+         }
+      );
+      DrawnTriangleNum += range.Count / 3;
+   }
+}
+
+void ObjectGL::drawVisible(const glm::mat4& world_to_clip, bool cull_backfaces, int lod, bool position_only)
+{
+   if (Arena != nullptr) {
+      VisibleCommands.clear();
+      appendDrawCommands( VisibleCommands, world_to_clip, cull_backfaces, lod, position_only );
+      for (const auto& command : VisibleCommands) drawCommand( command );
+      return;
+   }
+
+   const size_t index_size = IndexType == GL_UNSIGNED_SHORT ? sizeof( GLushort ) : sizeof( GLuint );
+   const MeshletCuller culler(world_to_clip * getFirstInstanceToWorld());
+   const GLsizei instance_num = getInstanceNum();
+   VisibleInstanceNum = static_cast<size_t>(instance_num);
+   if (lod > 0 && lod < static_cast<int>(Lods.size())) {
+      VisibleMeshletNum = 0;
+      DrawnTriangleNum = 0;
+      if (instance_num == 1 && !culler.isInsideFrustum( BoundingBoxMin, BoundingBoxMax )) {
+         VisibleInstanceNum = 0;
+         return;
+      }
+
+      DrawnTriangleNum = Lods[lod].IndexNum / 3 * instance_num;
+      glDrawElementsInstanced(
+         DrawMode,
+         static_cast<GLsizei>(Lods[lod].IndexNum),
+         IndexType,
+         reinterpret_cast<const void*>(static_cast<uintptr_t>(Lods[lod].IndexOffset * index_size)),
+         instance_num
+      );
+      return;
+   }
+   if (Meshlets.empty() || instance_num != 1) {
+      VisibleMeshletNum = 0;
+      DrawnTriangleNum = static_cast<size_t>((IBO != 0 ? IndicesCount : VerticesCount) / 3) * instance_num;
+      draw();
+      return;
+   }
+
+   VisibleMeshletNum = culler.getVisibleRanges( VisibleRanges, Meshlets, cull_backfaces );
+   DrawnTriangleNum = 0;
+   if (VisibleRanges.empty()) return;
+
+   VisibleIndexCounts.resize( VisibleRanges.size() );
+   VisibleIndexOffsets.resize( VisibleRanges.size() );
+   for (size_t i = 0; i < VisibleRanges.size(); ++i) {
+      VisibleIndexCounts[i] = static_cast<GLsizei>(VisibleRanges[i].Count);
+      VisibleIndexOffsets[i] = reinterpret_cast<const void*>(static_cast<uintptr_t>(VisibleRanges[i].Offset * index_size));
+      DrawnTriangleNum += VisibleRanges[i].Count / 3;
+   }
+   glMultiDrawElements(
+      DrawMode,
+      VisibleIndexCounts.data(),
+      IndexType,
+      VisibleIndexOffsets.data(),
+      static_cast<GLsizei>(VisibleRanges.size())
+   );
+}
+
+void ObjectGL::uploadVertices(bool normals_exist, bool textures_exist)
+{
+   assert( Format.getStride( normals_exist, textures_exist ) == static_cast<uint32_t>(VertexStride) );
+
+   // The buffer holds the vertices in the format of the object, whose positions may be quantized over the bounds,
+   // so the new positions are quantized over their own bounds.
+   const auto float_stride = static_cast<size_t>(MeshCache::getVertexStride(
+      (normals_exist ? MeshCache::HasNormals : 0u) | (textures_exist ? MeshCache::HasTextures : 0u)
+   ));
+   updateVertexBounds( float_stride );
+   const void* data = DataBuffer.data();
+   std::vector<uint8_t> encoded;
+   if (!Format.isFloat32()) {
+      setPositionDequantization();
+      Format.encode( encoded, DataBuffer, normals_exist, textures_exist, BoundingBoxMin, BoundingBoxMax );
+      data = encoded.data();
+   }
+   glNamedBufferSubData(
+      getVBO(), VertexRange.Offset, static_cast<GLsizeiptr>(VerticesCount) * VertexStride, data
+   );
+   updatePositionBuffer( data );
+}
+
+bool ObjectGL::prepareFloatVertices(size_t vertex_num, int step)
+{
+   if (DataBuffer.size() >= vertex_num * step) return true;
+
+   const auto vertex_buffer_size = static_cast<size_t>(VerticesCount) * static_cast<size_t>(VertexStride);
+   if (Format.isFloat32() && VertexStride == static_cast<GLsizei>(sizeof( GLfloat ) * step) &&
+       vertex_num <= static_cast<size_t>(VerticesCount)) {
+      DataBuffer.resize( vertex_buffer_size / sizeof( GLfloat ) );
+      glGetNamedBufferSubData(
+         getVBO(), VertexRange.Offset, static_cast<GLsizeiptr>(vertex_buffer_size), DataBuffer.data()
+      );
+      return true;
+   }
+
+   std::cerr << "Cannot replace " << vertex_num << " vertices, because the object keeps the float vertices of only "
+      << DataBuffer.size() / step << ". The vertices that are not in floats cannot be read back from the vertex "
+      "buffer either.\n";
+   return false;
+}
+
+bool ObjectGL::resizeVertexBuffer(GLsizei vertex_num)
+{
+   if (vertex_num == VerticesCount) return true;
+   if (Arena == nullptr) {
+      std::cerr << "Cannot change the number of vertices from " << VerticesCount << " to " << vertex_num
+         << ", because the buffers of an object without a geometry arena do not grow.\n";
+      return false;
+   }
+
+   // The neighbours in the arena would be overwritten otherwise.
+   VerticesCount = vertex_num;
+   const auto size = static_cast<GLsizeiptr>(vertex_num) * VertexStride;
+   if (!reallocate( GeometryArenaGL::VertexBuffer, size, VertexStride, VertexRange )) return false;
+   if (PositionRange.Size > 0) {
+      const auto position_size = static_cast<GLsizeiptr>(Format.getPositionSize());
+      const GLsizeiptr position_buffer_size = static_cast<GLsizeiptr>(vertex_num) * position_size;
+      const bool allocated = reallocate(
+         GeometryArenaGL::VertexBuffer, position_buffer_size, position_size, PositionRange
+      );
+      if (!allocated) return false;
+   }
+   prepareSequentialIndices();
+   return State != LoadState::Failed;
 }
 
 void ObjectGL::replaceVertices(
@@ -500,19 +952,21 @@ void ObjectGL::replaceVertices(
    bool textures_exist
 )
 {
-   assert( VBO != 0 );
+   assert( VAO != 0 );
 
-   VerticesCount = 0;
    int step = 3;
    if (normals_exist) step += 3;
    if (textures_exist) step += 2;
+   if (!prepareFloatVertices( vertices.size(), step )) return;
+
+   VerticesCount = 0;
    for (size_t i = 0; i < vertices.size(); ++i) {
       DataBuffer[i * step] = vertices[i].x;
       DataBuffer[i * step + 1] = vertices[i].y;
       DataBuffer[i * step + 2] = vertices[i].z;
       VerticesCount++;
    }
-   glNamedBufferSubData( VBO, 0, static_cast<GLsizeiptr>(sizeof( GLfloat ) * VerticesCount * step), DataBuffer.data() );
+   uploadVertices( normals_exist, textures_exist );
 }
 
 void ObjectGL::replaceVertices(
@@ -521,17 +975,19 @@ void ObjectGL::replaceVertices(
    bool textures_exist
 )
 {
-   assert( VBO != 0 );
+   assert( VAO != 0 );
 
-   VerticesCount = 0;
    int step = 3;
    if (normals_exist) step += 3;
    if (textures_exist) step += 2;
+   if (!prepareFloatVertices( vertices.size() / 3, step )) return;
+
+   VerticesCount = 0;
    for (size_t i = 0, j = 0; i < vertices.size(); i += 3, ++j) {
       DataBuffer[j * step] = vertices[i];
       DataBuffer[j * step + 1] = vertices[i + 1];
       DataBuffer[j * step + 2] = vertices[i + 2];
       VerticesCount++;
    }
-   glNamedBufferSubData( VBO, 0, static_cast<GLsizeiptr>(sizeof( GLfloat ) * VerticesCount * step), DataBuffer.data() );
+   uploadVertices( normals_exist, textures_exist );
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "program_cache.h"
+#include <cstring>
+
+uint64_t ProgramCache::getKey(const std::vector<std::pair<GLenum, std::string>>& stages)
+{
+   // FNV-1a over the driver strings and then every stage, so that a driver update invalidates the binaries.
+   uint64_t hash = 14695981039346656037ull;
+   const auto add = [&hash](const void* data, size_t size) {
+      const auto* bytes = static_cast<const uint8_t*>(data);
+      for (size_t i = 0; i < size; ++i) {
+         hash ^= bytes[i];
+         hash *= 1099511628211ull;
+      }
+   };
+   for (const GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+      const auto* driver = reinterpret_cast<const char*>(glGetString( name ));
+      if (driver != nullptr) add( driver, std::strlen( driver ) + 1 );
+   }
+   for (const auto& stage : stages) {
+      add( &stage.first, sizeof( stage.first ) );
+      add( stage.second.data(), stage.second.size() + 1 );
+   }
+   return hash;
+}
+
+std::string ProgramCache::getCachePath(uint64_t key)
+{
+   std::stringstream name;
+   name << std::hex << std::setw( 16 ) << std::setfill( '0' ) << key << ".program";
+   return (std::filesystem::path(CMAKE_SOURCE_DIR) / "shaders/cache" / name.str()).string();
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key)
+{
+   const MappedFile file(getCachePath( key ));
+   if (!file.isOpen() || file.size() < sizeof( Header )) return false;
+
+   const auto& header = *reinterpret_cast<const Header*>(file.begin());
+   if (std::memcmp( header.Magic, Magic, sizeof( Magic ) ) != 0 || header.Version != Version) return false;
+   if (header.Key != key || sizeof( Header ) + header.BinarySize > file.size()) return false;
+
+   glProgramBinary(
+      program, header.BinaryFormat, file.begin() + sizeof( Header ), static_cast<GLsizei>(header.BinarySize)
+   );
+   GLint linked = GL_FALSE;
+   glGetProgramiv( program, GL_LINK_STATUS, &linked );
+   return linked == GL_TRUE;
+}
+
+bool ProgramCache::write(GLuint program, uint64_t key)
+{
+   GLint binary_size = 0;
+   glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &binary_size );
+   if (binary_size <= 0) return true; // the driver has no binary to give, which is not an error
+
+   Header header{};
+   std::vector<char> binary(binary_size);
+   GLenum binary_format = 0;
+   glGetProgramBinary( program, binary_size, &binary_size, &binary_format, binary.data() );
+   std::memcpy( header.Magic, Magic, sizeof( Magic ) );
+   header.Version = Version;
+   header.Key = key;
+   header.BinaryFormat = binary_format;
+   header.BinarySize = static_cast<uint32_t>(binary_size);
+
+   // Write next to the destination and rename it, so that a reader never maps a half-written file.
+   const std::string cache_path = getCachePath( key );
+   const std::string temporary_path = cache_path + ".tmp";
+   std::error_code error;
+   std::filesystem::create_directories( std::filesystem::path(cache_path).parent_path(), error );
+   std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+   if (!file.is_open()) return false;
+
+   file.write( reinterpret_cast<const char*>(&header), sizeof( Header ) );
+   file.write( binary.data(), binary_size );
+   file.close();
+   if (!file) return false;
+
+   std::filesystem::rename( temporary_path, cache_path, error );
+   if (error) {
+      std::error_code ignored;
+      std::filesystem::remove( temporary_path, ignored );
+      return false;
+   }
+   return true;
+}
\ No newline at end of file
@@ -1,13 +1,26 @@
 #include "renderer.h"
 
 RendererGL::RendererGL() :
-   Window( nullptr ), Pause( false ), FrameWidth( 1920 ), FrameHeight( 1080 ), ShadowMapSize( 1024 ), SplitNum( 4 ),
-   ActiveLightIndex( 0 ), FBO( 0 ), DepthTextureID( 0 ), ClickedPoint( -1, -1 ),
+   Window( nullptr ), Pause( false ), FrameWidth( 1920 ), FrameHeight( 1080 ), ShadowMapSize( 512 ), SplitNum( 3 ),
+   ActiveLightIndex( 0 ), PcfKernelSize( 1 ), BunnyField( false ), GpuCulling( true ), SingleScenePass( true ),
+   CascadeBlending( false ), CascadeBlendRange( 0.1f ), TightCrop( true ), SampleDistribution( true ), FBO( 0 ),
+   DepthTextureID( 0 ), SceneFBO( 0 ), SceneColorID( 0 ), SceneDepthTextureID( 0 ), ClickedPoint( -1, -1 ),
    Texter( std::make_unique<TextGL>() ), MainCamera( std::make_unique<CameraGL>() ),
    TextCamera( std::make_unique<CameraGL>() ), LightCamera( std::make_unique<CameraGL>() ),
-   TextShader( std::make_unique<ShaderGL>() ), SceneShader( std::make_unique<ShaderGL>() ),
-   LightViewShader( std::make_unique<ShaderGL>() ), WallObject( std::make_unique<ObjectGL>() ),
-   BunnyObject( std::make_unique<ObjectGL>() ), Lights( std::make_unique<LightGL>() )
+   TextShader( std::make_unique<ShaderGL>() ),
+   SceneShaders(
+      std::make_unique<ShaderPermutationsGL>(
+         std::vector<ShaderPermutationsGL::Define>{
+            { "USE_TEXTURE", 1 }, { "LIGHT_TYPE", 3 }, { "PCF_KERNEL_SIZE", 3 }, { "CASCADE_SELECTION", 2 }
+         },
+         [](ShaderGL* shader) { shader->setSceneUniformLocations(); }
+      )
+   ),
+   LightViewShader( std::make_unique<ShaderGL>() ), CullingShader( std::make_unique<ShaderGL>() ),
+   ReductionShader( std::make_unique<ShaderGL>() ),
+   WallObject( std::make_unique<ObjectGL>() ),
+   BunnyObject( std::make_unique<ObjectGL>() ), Lights( std::make_unique<LightGL>() ),
+   StartTime( std::chrono::steady_clock::now() )
 {
    Renderer = this;
 
@@ -19,6 +32,9 @@ RendererGL::~RendererGL()
 {
    if (DepthTextureID != 0) glDeleteTextures( 1, &DepthTextureID );
    if (FBO != 0) glDeleteFramebuffers( 1, &FBO );
+   if (SceneDepthTextureID != 0) glDeleteTextures( 1, &SceneDepthTextureID );
+   if (SceneColorID != 0) glDeleteRenderbuffers( 1, &SceneColorID );
+   if (SceneFBO != 0) glDeleteFramebuffers( 1, &SceneFBO );
 }
 
 void RendererGL::printOpenGLInformation()
@@ -56,25 +72,19 @@ void RendererGL::initialize()
    glEnable( GL_DEPTH_TEST );
    glClearColor( 0.1f, 0.1f, 0.1f, 1.0f );
 
-   Texter->initialize();
-
    TextCamera->update2DCamera( FrameWidth, FrameHeight );
    MainCamera->updatePerspectiveCamera( FrameWidth, FrameHeight );
    LightCamera->updateOrthographicCamera( ShadowMapSize, ShadowMapSize );
 
-   const std::string shader_directory_path = std::string(CMAKE_SOURCE_DIR) + "/shaders";
-   TextShader->setShader(
-      std::string(shader_directory_path + "/text.vert").c_str(),
-      std::string(shader_directory_path + "/text.frag").c_str()
-   );
-   SceneShader->setShader(
-      std::string(shader_directory_path + "/scene_shader.vert").c_str(),
-      std::string(shader_directory_path + "/scene_shader.frag").c_str()
-   );
-   LightViewShader->setShader(
-      std::string(shader_directory_path + "/light_view_generator.vert").c_str(),
-      std::string(shader_directory_path + "/light_view_generator.frag").c_str()
-   );
+   ShaderGL::enableParallelCompile();
+   Loader = std::make_unique<AssetLoader>();
+   DrawRing = std::make_unique<UniformRingGL>();
+   Arena = std::make_unique<GeometryArenaGL>();
+   Draws = std::make_unique<DrawListGL>();
+   ShadowDraws = std::make_unique<DrawListGL>();
+   Culler = std::make_unique<DrawCullerGL>();
+   Reducer = std::make_unique<DepthReducerGL>();
+   Materials = std::make_unique<MaterialLibraryGL>();
 }
 
 void RendererGL::writeFrame(const std::string& name) const
@@ -93,12 +103,15 @@ void RendererGL::writeFrame(const std::string& name) const
    delete [] buffer;
 }
 
-void RendererGL::writeDepthTexture(const std::string& name) const
+void RendererGL::writeDepthTexture(const std::string& name, int layer) const
 {
    const int size = ShadowMapSize * ShadowMapSize;
    auto* buffer = new uint8_t[size];
    auto* raw_buffer = new GLfloat[size];
-   glGetTextureImage( DepthTextureID, 0, GL_DEPTH_COMPONENT, GL_FLOAT, static_cast<GLsizei>(size * sizeof( GLfloat )), raw_buffer );
+   glGetTextureSubImage(
+      DepthTextureID, 0, 0, 0, layer, ShadowMapSize, ShadowMapSize, 1,
+      GL_DEPTH_COMPONENT, GL_FLOAT, static_cast<GLsizei>(size * sizeof( GLfloat )), raw_buffer
+   );
 
    for (int i = 0; i < size; ++i) {
       buffer[i] = static_cast<uint8_t>(LightCamera->linearizeDepthValue( raw_buffer[i] ) * 255.0f);
@@ -131,6 +144,39 @@ void RendererGL::keyboard(GLFWwindow* window, int key, int scancode, int action,
          Renderer->Lights->toggleLightSwitch();
          std::cout << "Light Turned " << (Renderer->Lights->isLightOn() ? "On!\n" : "Off!\n");
          break;
+      case GLFW_KEY_F:
+         Renderer->PcfKernelSize = Renderer->PcfKernelSize < 7 ? Renderer->PcfKernelSize + 2 : 1;
+         std::cout << "PCF Kernel: " << Renderer->PcfKernelSize << "x" << Renderer->PcfKernelSize << "\n";
+         break;
+      case GLFW_KEY_B:
+         Renderer->BunnyField = !Renderer->BunnyField;
+         Renderer->setBunnyInstances();
+         std::cout << "Bunnies: " << Renderer->BunnyObject->getInstanceNum() << "\n";
+         break;
+      case GLFW_KEY_U:
+         Renderer->GpuCulling = !Renderer->GpuCulling;
+         std::cout << "GPU Culling: " << (Renderer->GpuCulling ? "On\n" : "Off\n");
+         break;
+      case GLFW_KEY_S:
+         Renderer->SingleScenePass = !Renderer->SingleScenePass;
+         std::cout << "Scene Passes: " << (Renderer->SingleScenePass ? 1 : Renderer->SplitNum) << "\n";
+         break;
+      case GLFW_KEY_N:
+         Renderer->CascadeBlending = !Renderer->CascadeBlending;
+         std::cout << "Cascade Blending: " << (Renderer->CascadeBlending ? "On\n" : "Off\n");
+         break;
+      case GLFW_KEY_T:
+         Renderer->TightCrop = !Renderer->TightCrop;
+         std::cout << "Crop: " << (Renderer->TightCrop ? "Receivers and Casters\n" : "Split Frustum\n");
+         break;
+      case GLFW_KEY_D:
+         Renderer->SampleDistribution = !Renderer->SampleDistribution;
+         std::cout << "Splits: " << (Renderer->SampleDistribution ? "Visible Depths\n" : "Near to Far Plane\n");
+         break;
+      case GLFW_KEY_G:
+         Renderer->printDrawStatistics();
+         Renderer->printShadowMapUsage();
+         break;
       case GLFW_KEY_P: {
          const glm::vec3 pos = Renderer->MainCamera->getCameraPosition();
          std::cout << "Camera Position: " << pos.x << ", " << pos.y << ", " << pos.z << "\n";
@@ -201,11 +247,11 @@ void RendererGL::registerCallbacks() const
    glfwSetScrollCallback( Window, mousewheel );
 }
 
-void RendererGL::splitViewFrustum()
+void RendererGL::splitViewFrustum(float near, float far)
 {
    constexpr float split_weight = 0.5f;
-   const float n = MainCamera->getNearPlane();
-   const float f = MainCamera->getFarPlane();
+   const float n = near;
+   const float f = far;
    SplitPositions.resize( SplitNum + 1 );
    SplitPositions[0] = n;
    SplitPositions[SplitNum] = f;
@@ -247,24 +293,91 @@ void RendererGL::setWallObject() const
    wall_normals.emplace_back( 0.0f, 1.0f, 0.0f );
    wall_normals.emplace_back( 0.0f, 1.0f, 0.0f );
 
+   WallObject->setGeometryArena( Arena.get() );
+   WallObject->setPositionStream( true );
    WallObject->setObject( GL_TRIANGLES, wall_vertices, wall_normals );
-   WallObject->setDiffuseReflectionColor( { 1.0f, 1.0f, 1.0f, 1.0f } );
+   WallObject->setInstances(
+      {
+         { glm::mat4(1.0f), WallMaterials[0] },
+         {
+            glm::translate( glm::mat4(1.0f), glm::vec3(0.0f, half_length, -half_length) ) *
+            glm::rotate( glm::mat4(1.0f), glm::radians( 90.0f ), glm::vec3(1.0f, 0.0f, 0.0f) ),
+            WallMaterials[1]
+         },
+         {
+            glm::translate( glm::mat4(1.0f), glm::vec3(-half_length, half_length, 0.0f) ) *
+            glm::rotate( glm::mat4(1.0f), glm::radians( -90.0f ), glm::vec3(0.0f, 0.0f, 1.0f) ),
+            WallMaterials[2]
+         }
+      }
+   );
 }
 
 void RendererGL::setBunnyObject() const
 {
    const std::string sample_directory_path = std::string(CMAKE_SOURCE_DIR) + "/samples";
-   BunnyObject->setObject(
+   BunnyObject->setGeometryArena( Arena.get() );
+   BunnyObject->setVertexFormat( VertexFormat::getCompactFormat() );
+   BunnyObject->setPositionStream( true );
+   BunnyObject->setMeshletBuilding( true );
+   BunnyObject->setLodGeneration( true );
+   Loader->loadObject(
+      BunnyObject.get(),
       GL_TRIANGLES,
       std::string(sample_directory_path + "/Bunny/bunny.obj")
    );
-   BunnyObject->setDiffuseReflectionColor( { 1.0f, 1.0f, 1.0f, 1.0f } );
+}
+
+void RendererGL::setBunnyInstances() const
+{
+   if (!BunnyField) {
+      const glm::mat4 to_world =
+         glm::translate( glm::mat4(1.0f), glm::vec3(0.0f, 10.0f, -30.0f) ) *
+         glm::scale( glm::mat4(1.0f), glm::vec3(100.0f, 100.0f, 100.0f) );
+      BunnyObject->setInstances( { { to_world, BunnyMaterial } } );
+      return;
+   }
+
+   // A grid of small bunnies over the floor, which is 256 units wide, alternating between the wall colors.
+   constexpr int side = 100;
+   constexpr float spacing = 2.5f;
+   constexpr float scale = 12.0f;
+   std::vector<ObjectGL::Instance> instances;
+   instances.reserve( side * side );
+   for (int z = 0; z < side; ++z) {
+      for (int x = 0; x < side; ++x) {
+         const glm::vec3 position(
+            (static_cast<float>(x) - 0.5f * static_cast<float>(side - 1)) * spacing,
+            0.1f * scale,
+            (static_cast<float>(z) - 0.5f * static_cast<float>(side - 1)) * spacing
+         );
+         instances.emplace_back(
+            glm::translate( glm::mat4(1.0f), position ) * glm::scale( glm::mat4(1.0f), glm::vec3(scale) ),
+            (x + z) % 4 == 0 ? BunnyMaterial : WallMaterials[(x + z) % 3]
+         );
+      }
+   }
+   BunnyObject->setInstances( instances );
+}
+
+void RendererGL::setMaterials()
+{
+   WallMaterials[0] = Materials->addMaterial( Material( { 0.0f, 0.0f, 1.0f, 1.0f } ) );
+   WallMaterials[1] = Materials->addMaterial( Material( { 0.0f, 1.0f, 0.0f, 1.0f } ) );
+   WallMaterials[2] = Materials->addMaterial( Material( { 1.0f, 0.0f, 0.0f, 1.0f } ) );
+   BunnyMaterial = Materials->addMaterial( Material( { 1.0f, 1.0f, 1.0f, 1.0f } ) );
+   // An instance with the index of a material that was not added would read outside of MaterialBlock.
+   assert( std::min( { WallMaterials[0], WallMaterials[1], WallMaterials[2], BunnyMaterial } ) >= 0 );
 }
 
 void RendererGL::setDepthFrameBuffer()
 {
-   glCreateTextures( GL_TEXTURE_2D, 1, &DepthTextureID );
-   glTextureStorage2D( DepthTextureID, 1, GL_DEPTH_COMPONENT32F, ShadowMapSize, ShadowMapSize );
+   // One layer per split, which a single pass draws all at once.
+   if (SplitNum > MaxSplitNum) std::cerr << "Only the first " << MaxSplitNum << " splits have a shadow map\n";
+   glCreateTextures( GL_TEXTURE_2D_ARRAY, 1, &DepthTextureID );
+   glTextureStorage3D(
+      DepthTextureID, 1, GL_DEPTH_COMPONENT32F, ShadowMapSize, ShadowMapSize, std::min( SplitNum, MaxSplitNum )
+   );
    glTextureParameteri( DepthTextureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
    glTextureParameteri( DepthTextureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
    glTextureParameteri( DepthTextureID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
@@ -280,6 +393,130 @@ void RendererGL::setDepthFrameBuffer()
    }
 }
 
+void RendererGL::setSceneFrameBuffer()
+{
+   // The reduction fetches single texels, so the depth texture has no mipmaps to sample.
+   glCreateTextures( GL_TEXTURE_2D, 1, &SceneDepthTextureID );
+   glTextureStorage2D( SceneDepthTextureID, 1, GL_DEPTH_COMPONENT32F, FrameWidth, FrameHeight );
+   glTextureParameteri( SceneDepthTextureID, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+   glTextureParameteri( SceneDepthTextureID, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+   glCreateRenderbuffers( 1, &SceneColorID );
+   glNamedRenderbufferStorage( SceneColorID, GL_RGBA8, FrameWidth, FrameHeight );
+
+   glCreateFramebuffers( 1, &SceneFBO );
+   glNamedFramebufferRenderbuffer( SceneFBO, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, SceneColorID );
+   glNamedFramebufferTexture( SceneFBO, GL_DEPTH_ATTACHMENT, SceneDepthTextureID, 0 );
+
+   if (glCheckNamedFramebufferStatus( SceneFBO, GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE) {
+      std::cerr << "FrameBuffer Setup Error\n";
+   }
+}
+
+void RendererGL::prepareScene()
+{
+   // The bunny streams in through the loader, so its file is parsed while the rest is being set up.
+   setBunnyObject();
+
+   // Files are read on the workers while the main thread, which owns the context, issues the GL work. The shaders
+   // are compiled as soon as their sources arrive but checked only at the end, so that the driver can compile them
+   // in the meantime.
+   const std::string shader_directory_path = std::string(CMAKE_SOURCE_DIR) + "/shaders";
+   ShaderGL::ShaderSources text_sources, scene_sources, light_view_sources;
+   // The light view shader picks the layer of the shadow map array in the vertex shader where it can.
+   const bool vertex_layer = ShaderGL::isExtensionSupported( "GL_ARB_shader_viewport_layer_array" ) ||
+      ShaderGL::isExtensionSupported( "GL_AMD_vertex_shader_layer" );
+   TaskGraph tasks;
+   const int read_text_shader = tasks.addTask(
+      "read text shader", TaskGraph::Thread::Worker, [&]() {
+         ShaderGL::readShaderSources(
+            text_sources,
+            std::string(shader_directory_path + "/text.vert").c_str(),
+            std::string(shader_directory_path + "/text.frag").c_str()
+         );
+      }
+   );
+   const int read_scene_shader = tasks.addTask(
+      "read scene shader", TaskGraph::Thread::Worker, [&]() {
+         ShaderGL::readShaderSources(
+            scene_sources,
+            std::string(shader_directory_path + "/scene_shader.vert").c_str(),
+            std::string(shader_directory_path + "/scene_shader.frag").c_str()
+         );
+      }
+   );
+   const int read_light_view_shader = tasks.addTask(
+      "read light view shader", TaskGraph::Thread::Worker, [&]() {
+         ShaderGL::readShaderSources(
+            light_view_sources,
+            std::string(shader_directory_path + "/light_view_generator.vert").c_str(),
+            std::string(shader_directory_path + "/light_view_generator.frag").c_str(),
+            vertex_layer ? nullptr : std::string(shader_directory_path + "/light_view_generator.geom").c_str()
+         );
+      }
+   );
+   const int load_font = tasks.addTask( "load font", TaskGraph::Thread::Worker, [this]() { Texter->loadFont(); } );
+
+   const int set_scene = tasks.addTask(
+      "set scene", TaskGraph::Thread::Main, [this]() {
+         splitViewFrustum( MainCamera->getNearPlane(), MainCamera->getFarPlane() );
+         setLights();
+         setMaterials();
+         setWallObject();
+         setBunnyInstances();
+         Culler->addObject( WallObject.get() );
+         Culler->addObject( BunnyObject.get() );
+      }
+   );
+   const int compile_text_shader = tasks.addTask(
+      "compile text shader", TaskGraph::Thread::Main,
+      [&]() { TextShader->compileShader( text_sources ); }, { read_text_shader }
+   );
+   // The variant of the scene shader to prepare depends on the lights.
+   const int compile_scene_shader = tasks.addTask(
+      "compile scene shader", TaskGraph::Thread::Main,
+      [&]() {
+         SceneShaders->setSources( std::move( scene_sources ) );
+         SceneShaders->compileVariant( getSceneShaderKey( false ) );
+      }, { read_scene_shader, set_scene }
+   );
+   const int compile_light_view_shader = tasks.addTask(
+      "compile light view shader", TaskGraph::Thread::Main,
+      [&]() { LightViewShader->compileShader( light_view_sources ); }, { read_light_view_shader }
+   );
+   tasks.addTask(
+      "set culling shader", TaskGraph::Thread::Main, [&]() {
+         CullingShader->setComputeShaders( std::string(shader_directory_path + "/draw_culling.comp").c_str() );
+      }
+   );
+   tasks.addTask(
+      "set reduction shader", TaskGraph::Thread::Main, [&]() {
+         ReductionShader->setComputeShaders( std::string(shader_directory_path + "/depth_reduction.comp").c_str() );
+      }
+   );
+   tasks.addTask( "set depth framebuffer", TaskGraph::Thread::Main, [this]() { setDepthFrameBuffer(); } );
+   tasks.addTask( "set scene framebuffer", TaskGraph::Thread::Main, [this]() { setSceneFrameBuffer(); } );
+   tasks.addTask( "set glyph object", TaskGraph::Thread::Main, [this]() { Texter->initialize(); }, { load_font } );
+
+   tasks.addTask(
+      "link text shader", TaskGraph::Thread::Main, [this]() {
+         TextShader->finishShader();
+         TextShader->setTextUniformLocations();
+      }, { compile_text_shader }
+   );
+   tasks.addTask(
+      "link scene shader", TaskGraph::Thread::Main,
+      [this]() { SceneShaders->getVariant( getSceneShaderKey( false ) ); }, { compile_scene_shader }
+   );
+   tasks.addTask(
+      "link light view shader", TaskGraph::Thread::Main, [this]() {
+         LightViewShader->finishShader();
+         LightViewShader->setLightViewUniformLocations();
+      }, { compile_light_view_shader }
+   );
+   tasks.run();
+   tasks.printTimeline();
+}
+
 void RendererGL::getSplitFrustum(std::array<glm::vec3, 8>& frustum, float near, float far) const
 {
    const glm::mat4& projection_matrix = MainCamera->getProjectionMatrix();
@@ -349,7 +586,47 @@ void RendererGL::getBoundingBox(std::array<glm::vec3, 8>& bounding_box, const st
    bounding_box[7] = glm::vec3(max_point.x, max_point.y, max_point.z);
 }
 
-glm::mat4 RendererGL::calculateLightCropMatrix(std::array<glm::vec3, 8>& bounding_box) const
+glm::mat4 RendererGL::getSplitViewProjection(float near, float far) const
+{
+   return glm::perspective( glm::radians( MainCamera->getFOV() ), MainCamera->getAspectRatio(), near, far ) *
+      MainCamera->getViewMatrix();
+}
+
+void RendererGL::getShadowBounds(std::vector<ShadowBounds>& bounds, bool per_instance) const
+{
+   bounds.clear();
+   const glm::mat4 light_view_projection = LightCamera->getProjectionMatrix() * LightCamera->getViewMatrix();
+   for (const ObjectGL* object : { WallObject.get(), BunnyObject.get() }) {
+      if (!object->isReady() || object->getInstanceNum() == 0) continue;
+
+      if (!per_instance) {
+         const ObjectGL::Bounds& world_bounds = object->getWorldBounds();
+         bounds.push_back(
+            { world_bounds, ObjectGL::transformBounds( light_view_projection, world_bounds.Min, world_bounds.Max ) }
+         );
+         continue;
+      }
+
+      const std::vector<ObjectGL::Instance>& instances = object->getInstances();
+      const std::vector<ObjectGL::Bounds>& world_bounds = object->getInstanceWorldBounds();
+      for (size_t i = 0; i < world_bounds.size(); ++i) {
+         const glm::mat4 to_light = light_view_projection * instances[i].ToWorld;
+         bounds.push_back(
+            {
+               world_bounds[i],
+               ObjectGL::transformBounds( to_light, object->getBoundingBoxMin(), object->getBoundingBoxMax() )
+            }
+         );
+      }
+   }
+}
+
+glm::mat4 RendererGL::calculateLightCropMatrix(
+   const std::array<glm::vec3, 8>& bounding_box,
+   const glm::mat4& split_view_projection,
+   const std::vector<ShadowBounds>& shadow_bounds,
+   bool& has_receivers
+) const
 {
    std::array<glm::vec4, 8> ndc_points{};
    const glm::mat4 model_view_projection = LightCamera->getProjectionMatrix() * LightCamera->getViewMatrix();
@@ -372,6 +649,33 @@ glm::mat4 RendererGL::calculateLightCropMatrix(std::array<glm::vec3, 8>& boundin
       if (ndc_points[i].z > max_point.z) max_point.z = ndc_points[i].z;
    }
    min_point.z = -1.0f;
+   has_receivers = true;
+
+   if (TightCrop) {
+      // As in PSSM, the crop only covers the part of the split that receivers are in, and its depth range starts
+      // at the nearest caster over that part instead of at the light.
+      glm::vec3 receiver_min(std::numeric_limits<float>::max());
+      glm::vec3 receiver_max(std::numeric_limits<float>::lowest());
+      const MeshletCuller split_culler(split_view_projection);
+      for (const auto& bounds : shadow_bounds) {
+         if (!split_culler.isInsideFrustum( bounds.World.Min, bounds.World.Max )) continue;
+         receiver_min = glm::min( receiver_min, bounds.Light.Min );
+         receiver_max = glm::max( receiver_max, bounds.Light.Max );
+      }
+      const glm::vec3 tight_min = glm::max( min_point, receiver_min );
+      const glm::vec3 tight_max = glm::min( max_point, receiver_max );
+      has_receivers = tight_min.x < tight_max.x && tight_min.y < tight_max.y && receiver_min.z < max_point.z;
+      if (has_receivers) {
+         min_point = glm::vec3(tight_min.x, tight_min.y, tight_max.z);
+         max_point = tight_max;
+         for (const auto& bounds : shadow_bounds) {
+            if (bounds.Light.Max.x < min_point.x || bounds.Light.Min.x > max_point.x ||
+                bounds.Light.Max.y < min_point.y || bounds.Light.Min.y > max_point.y) continue;
+            min_point.z = std::min( min_point.z, bounds.Light.Min.z );
+         }
+         min_point.z = std::max( min_point.z, -1.0f );
+      }
+   }
 
    glm::mat4 crop(1.0f);
    crop[0][0] = 2.0f / (max_point.x - min_point.x);
@@ -383,77 +687,222 @@ glm::mat4 RendererGL::calculateLightCropMatrix(std::array<glm::vec3, 8>& boundin
    return crop;
 }
 
-void RendererGL::drawBoxObject(ShaderGL* shader, const CameraGL* camera) const
+float RendererGL::getLodErrorBound(
+   const CameraGL* camera,
+   const glm::mat4& crop_matrix,
+   const ObjectGL* object,
+   bool depth_pass
+) const
+{
+   const glm::mat4& to_world = object->getInstances().front().ToWorld;
+   const float scale = std::max(
+      std::max( glm::length( glm::vec3(to_world[0]) ), glm::length( glm::vec3(to_world[1]) ) ),
+      glm::length( glm::vec3(to_world[2]) )
+   );
+   float world_error;
+   if (depth_pass) {
+      // An error below one texel of this split cannot change its depth map.
+      const glm::mat4 to_clip = crop_matrix * camera->getProjectionMatrix() * camera->getViewMatrix();
+      const float clip_per_world = std::max(
+         glm::length( glm::vec3(to_clip[0][0], to_clip[1][0], to_clip[2][0]) ),
+         glm::length( glm::vec3(to_clip[0][1], to_clip[1][1], to_clip[2][1]) )
+      );
+      world_error = 2.0f / (static_cast<float>(ShadowMapSize) * clip_per_world);
+   }
+   else {
+      // An error below one pixel at the nearest point of the instances is invisible.
+      const ObjectGL::Bounds& bounds = object->getWorldBounds();
+      const glm::vec3 eye = camera->getCameraPosition();
+      const float distance = std::max(
+         glm::distance( eye, glm::clamp( eye, bounds.Min, bounds.Max ) ),
+         camera->getNearPlane()
+      );
+      world_error = 2.0f * distance / (camera->getProjectionMatrix()[1][1] * static_cast<float>(FrameHeight));
+   }
+   return world_error / scale;
+}
+
+uint64_t RendererGL::getSceneShaderKey(bool use_texture) const
+{
+   int light_type = NoLight;
+   if (Lights->isLightOn()) {
+      if (!Lights->isActivated( ActiveLightIndex )) light_type = SwitchedOffLight;
+      else if (Lights->getLightPosition( ActiveLightIndex ).w == 0.0f) light_type = DirectionalLight;
+      else if (Lights->getSpotlightCutoffAngle( ActiveLightIndex ) >= 180.0f) light_type = PointLight;
+      else light_type = Spotlight;
+   }
+   int cascade_selection = SelectByPass;
+   if (SingleScenePass) cascade_selection = CascadeBlending ? BlendPerFragment : SelectPerFragment;
+   return SceneShaders->getKey( { use_texture ? 1 : 0, light_type, PcfKernelSize, cascade_selection } );
+}
+
+GLuint RendererGL::getSceneProgram(const ObjectGL* object) const
 {
-   glm::mat4 to_world(1.0f);
-   shader->transferBasicTransformationUniforms( to_world, camera );
-   WallObject->setDiffuseReflectionColor( { 0.0f, 0.0f, 1.0f, 1.0f } );
-   WallObject->transferUniformsToShader( shader );
-   glBindVertexArray( WallObject->getVAO() );
-   glDrawArrays( WallObject->getDrawMode(), 0, WallObject->getVertexNum() );
+   ShaderGL* shader = SceneShaders->getVariant( getSceneShaderKey( object->getTextureNum() > 0 ) );
+   shader->uniform1i( Uniform::LightIndex, ActiveLightIndex );
+   return shader->getShaderProgram();
+}
 
-   to_world =
-      glm::translate( glm::mat4(1.0f), glm::vec3(0.0f, 128.0f, -128.0f) ) *
-      glm::rotate( glm::mat4(1.0f), glm::radians( 90.0f ), glm::vec3(1.0f, 0.0f, 0.0f) );
-   shader->transferBasicTransformationUniforms( to_world, camera );
-   WallObject->setDiffuseReflectionColor( { 0.0f, 1.0f, 0.0f, 1.0f } );
-   WallObject->transferUniformsToShader( shader );
-   glDrawArrays( WallObject->getDrawMode(), 0, WallObject->getVertexNum() );
+RendererGL::PassData RendererGL::getLightViewPass(const glm::mat4& light_crop_matrix, int split) const
+{
+   PassData pass;
+   pass.Camera = LightCamera.get();
+   pass.CropMatrix = light_crop_matrix;
+   pass.View = LightCamera->getViewMatrix();
+   pass.LightViewProjection = LightCamera->getProjectionMatrix() * pass.View;
+   pass.ViewProjection = light_crop_matrix * pass.LightViewProjection;
+   pass.DepthPass = true;
+   pass.HasCasters = hasCasters( pass );
+   pass.ShadowLayer = split;
+   pass.CullingView = -1;
+   pass.CullingList = 0; // shared by the layers
+   return pass;
+}
 
-   to_world =
-      glm::translate( glm::mat4(1.0f), glm::vec3(-128.0f, 128.0f, 0.0f) ) *
-      glm::rotate( glm::mat4(1.0f), glm::radians( -90.0f ), glm::vec3(0.0f, 0.0f, 1.0f) );
-   shader->transferBasicTransformationUniforms( to_world, camera );
-   WallObject->setDiffuseReflectionColor( { 1.0f, 0.0f, 0.0f, 1.0f } );
-   WallObject->transferUniformsToShader( shader );
-   glDrawArrays( WallObject->getDrawMode(), 0, WallObject->getVertexNum() );
+RendererGL::PassData RendererGL::getScenePass(int split) const
+{
+   PassData pass;
+   pass.Camera = MainCamera.get();
+   pass.CropMatrix = glm::mat4(1.0f);
+   pass.View = MainCamera->getViewMatrix();
+   pass.ViewProjection = MainCamera->getProjectionMatrix() * pass.View;
+   pass.LightViewProjection = LightCamera->getProjectionMatrix() * LightCamera->getViewMatrix();
+   pass.DepthPass = false;
+   pass.HasCasters = true;
+   pass.ShadowLayer = split;
+   pass.CullingView = -1;
+   pass.CullingList = 1 + std::max( split, 0 );
+   return pass;
 }
 
-void RendererGL::drawBunnyObject(ShaderGL* shader, const CameraGL* camera) const
+bool RendererGL::hasCasters(const PassData& light_view_pass) const
 {
-   const glm::mat4 to_world =
-      glm::translate( glm::mat4(1.0f), glm::vec3(0.0f, 10.0f, -30.0f) ) *
-      glm::scale( glm::mat4(1.0f), glm::vec3(100.0f, 100.0f, 100.0f) );
-   shader->transferBasicTransformationUniforms( to_world, camera );
-   BunnyObject->transferUniformsToShader( shader );
+   // calculateLightCropMatrix opens the depth range of a split toward the light, up to the nearest caster or the
+   // near plane of the light, so the casters that the camera does not see stay in its crop volume.
+   const MeshletCuller culler(light_view_pass.ViewProjection);
+   for (const ObjectGL* object : { WallObject.get(), BunnyObject.get() }) {
+      const ObjectGL::Bounds& bounds = object->getWorldBounds();
+      if (object->isReady() && culler.isInsideFrustum( bounds.Min, bounds.Max )) return true;
+   }
+   return false;
+}
 
-   glBindVertexArray( BunnyObject->getVAO() );
-   glDrawArrays( BunnyObject->getDrawMode(), 0, BunnyObject->getVertexNum() );
+bool RendererGL::bindPassData(const PassData& pass) const
+{
+   PassBlockData data;
+   data.ViewProjectionMatrix = pass.ViewProjection;
+   data.ViewMatrix = pass.View;
+   data.LightViewProjectionMatrix = pass.LightViewProjection;
+   data.ShadowLayer = pass.ShadowLayer;
+   return DrawRing->bind( GL_UNIFORM_BUFFER, PassBlockBinding, &data, sizeof( PassBlockData ) );
 }
 
-void RendererGL::drawDepthMapFromLightView(const glm::mat4& light_crop_matrix) const
+bool RendererGL::bindCascadeData(const std::vector<PassData>& light_view_passes) const
+{
+   CascadeBlockData data{};
+   data.SplitFarPlanes.fill( glm::vec4(std::numeric_limits<float>::max()) );
+   for (const auto& pass : light_view_passes) {
+      const int layer = pass.ShadowLayer;
+      data.CascadeMatrices[layer] = pass.ViewProjection;
+      data.CropScales[layer] = glm::vec4(pass.CropMatrix[0][0], pass.CropMatrix[1][1], pass.CropMatrix[2][2], 1.0f);
+      data.CropOffsets[layer] = glm::vec4(glm::vec3(pass.CropMatrix[3]), 0.0f);
+      data.SplitFarPlanes[layer / 4][layer % 4] = SplitPositions[layer + 1];
+   }
+   data.CascadeNum = static_cast<int32_t>(light_view_passes.size());
+   data.NearPlane = SplitPositions[0];
+   data.BlendRange = CascadeBlendRange;
+   return DrawRing->bind( GL_UNIFORM_BUFFER, CascadeBlockBinding, &data, sizeof( CascadeBlockData ) );
+}
+
+void RendererGL::addDraw(
+   GLuint program,
+   ObjectGL* object,
+   const glm::mat4& world_to_clip,
+   const PassData& pass,
+   int lod,
+   bool cull_backfaces
+) const
+{
+   // The GPU culls every instance on its own, and the view decides about the back faces.
+   if (pass.CullingView >= 0) Culler->addDraw( pass.CullingView, program, 0, object, lod, pass.DepthPass );
+   else {
+      DrawListGL* draws = pass.DepthPass ? ShadowDraws.get() : Draws.get();
+      draws->addObject( program, 0, object, world_to_clip, cull_backfaces, lod, pass.DepthPass, pass.ShadowLayer );
+   }
+}
+
+void RendererGL::addBoxObject(GLuint program, const PassData& pass) const
+{
+   addDraw( program, WallObject.get(), pass.ViewProjection, pass, 0, false );
+}
+
+void RendererGL::addBunnyObject(GLuint program, const PassData& pass) const
+{
+   if (!BunnyObject->isReady() || BunnyObject->getInstanceNum() == 0) return;
+
+   // Both sides of a caster can write the shadow map, so only the camera view culls back-facing meshlets.
+   const int lod = BunnyObject->selectLod(
+      getLodErrorBound( pass.Camera, pass.CropMatrix, BunnyObject.get(), pass.DepthPass )
+   );
+   addDraw( program, BunnyObject.get(), pass.ViewProjection, pass, lod, !pass.DepthPass );
+}
+
+void RendererGL::addPassObjects(const PassData& pass) const
+{
+   // In the scene pass, each object is drawn with the variant of the scene shader that matches it and the active
+   // light, and the objects that share a variant go into one multi-draw.
+   if (pass.DepthPass) {
+      addBunnyObject( LightViewShader->getShaderProgram(), pass );
+      addBoxObject( LightViewShader->getShaderProgram(), pass );
+   }
+   else {
+      addBunnyObject( getSceneProgram( BunnyObject.get() ), pass );
+      addBoxObject( getSceneProgram( WallObject.get() ), pass );
+   }
+}
+
+void RendererGL::addCullingView(PassData& pass) const
+{
+   pass.CullingView = Culler->addView( pass.ViewProjection, !pass.DepthPass, pass.CullingList, pass.ShadowLayer );
+   addPassObjects( pass );
+}
+
+void RendererGL::drawPassObjects(const PassData* passes, size_t pass_num) const
+{
+   // The passes draw to the same target, so they share one list of draws.
+   if (GpuCulling) {
+      Culler->submit( passes[0].CullingList );
+      return;
+   }
+
+   DrawListGL* draws = passes[0].DepthPass ? ShadowDraws.get() : Draws.get();
+   draws->clear();
+   for (size_t i = 0; i < pass_num; ++i) {
+      if (passes[i].HasCasters) addPassObjects( passes[i] );
+   }
+   if (!draws->submit( DrawRing.get() )) std::cerr << "The uniform ring is too small for the draws of a pass\n";
+}
+
+void RendererGL::drawDepthMapsFromLightView(const std::vector<PassData>& passes) const
 {
    glViewport( 0, 0, ShadowMapSize, ShadowMapSize );
    glBindFramebuffer( GL_FRAMEBUFFER, FBO );
 
+   // Every layer of the shadow map array is cleared, and each command draws to the layer of its split.
    constexpr GLfloat one = 1.0f;
    glClearNamedFramebufferfv( FBO, GL_DEPTH, 0, &one );
    glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
-
-   glUseProgram( LightViewShader->getShaderProgram() );
-   glUniformMatrix4fv( LightViewShader->getLocation( "LightCropMatrix" ), 1, GL_FALSE, &light_crop_matrix[0][0] );
-
-   drawBunnyObject( LightViewShader.get(), LightCamera.get() );
-   drawBoxObject( LightViewShader.get(), LightCamera.get() );
+   drawPassObjects( passes.data(), passes.size() );
 }
 
-void RendererGL::drawShadow(const glm::mat4& light_crop_matrix) const
+void RendererGL::drawShadow(const PassData& pass) const
 {
    glViewport( 0, 0, FrameWidth, FrameHeight );
-   glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+   glBindFramebuffer( GL_FRAMEBUFFER, SceneFBO );
    glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
-   glUseProgram( SceneShader->getShaderProgram() );
-
-   Lights->transferUniformsToShader( SceneShader.get() );
-   glUniform1i( SceneShader->getLocation( "LightIndex" ), ActiveLightIndex );
-   glUniform1i( SceneShader->getLocation( "UseTexture" ), 0 );
-
-   const glm::mat4 view_projection = light_crop_matrix * LightCamera->getProjectionMatrix() * LightCamera->getViewMatrix();
-   glUniformMatrix4fv( SceneShader->getLocation( "LightViewProjectionMatrix" ), 1, GL_FALSE, &view_projection[0][0] );
 
    glBindTextureUnit( 1, DepthTextureID );
-   drawBunnyObject( SceneShader.get(), MainCamera.get() );
-   drawBoxObject( SceneShader.get(), MainCamera.get() );
+   if (bindPassData( pass )) drawPassObjects( &pass, 1 );
 }
 
 void RendererGL::drawText(const std::string& text) const
@@ -481,9 +930,9 @@ void RendererGL::drawText(const std::string& text) const
          glm::translate( glm::mat4(1.0f), glm::vec3(position, 0.0f) ) *
          glm::scale( glm::mat4(1.0f), glm::vec3(glyph->Size.x, glyph->Size.y, 1.0f) );
       TextShader->transferBasicTransformationUniforms( to_world, TextCamera.get() );
-      TextShader->uniform2fv( "TextScale", glyph->TopRightTextureCoord );
+      TextShader->uniform2fv( Uniform::TextScale, glyph->TopRightTextureCoord );
       glBindTextureUnit( 0, glyph_object->getTextureID( glyph->TextureIDIndex ) );
-      glDrawArrays( glyph_object->getDrawMode(), 0, glyph_object->getVertexNum() );
+      glyph_object->draw();
 
       text_position.x += glyph->Advance.x;
       text_position.y -= glyph->Advance.y;
@@ -492,9 +941,91 @@ void RendererGL::drawText(const std::string& text) const
    glDisable( GL_BLEND );
 }
 
-void RendererGL::render() const
+void RendererGL::printDrawStatistics() const
+{
+   Arena->printStatistics();
+   if (GpuCulling) {
+      Culler->printStatistics();
+      return;
+   }
+
+   std::stringstream text;
+   text << "CPU culling\n";
+   for (int i = 0; i < std::min( SplitNum, MaxSplitNum ); ++i) {
+      text << " - cascade " << i << ": " << ShadowDraws->getInstanceNum( i ) << " casters\n";
+   }
+   text << " - light views: " << ShadowDraws->getCommandNum() << " commands in " << ShadowDraws->getBatchNum()
+      << " multi-draws\n";
+   text << " - last scene pass: " << Draws->getCommandNum() << " commands in " << Draws->getBatchNum()
+      << " multi-draws\n";
+   std::cout << text.str();
+}
+
+void RendererGL::printShadowMapUsage() const
+{
+   // A texel is counted as used if it lies under the part of a receiver that is in the split, which is estimated
+   // on a grid over the crop from the bounds of the receivers in the clip space of the light.
+   constexpr int grid_size = 64;
+   std::vector<ShadowBounds> shadow_bounds;
+   getShadowBounds( shadow_bounds, true );
+   const glm::mat4& light_projection = LightCamera->getProjectionMatrix();
+   const glm::mat4 light_view_projection = light_projection * LightCamera->getViewMatrix();
+   std::vector<bool> used_cells(grid_size * grid_size);
+
+   std::stringstream text;
+   text << "Shadow map usage with the " << (TightCrop ? "tight" : "split frustum") << " crop";
+   text << std::fixed << std::setprecision( 1 ) << " and splits from " << SplitPositions.front() << " to "
+      << SplitPositions.back() << "\n";
+   for (int i = 0; i < std::min( SplitNum, MaxSplitNum ); ++i) {
+      std::array<glm::vec3, 8> frustum{};
+      getSplitFrustum( frustum, SplitPositions[i], SplitPositions[i + 1] );
+      const glm::mat4 split_view_projection = getSplitViewProjection( SplitPositions[i], SplitPositions[i + 1] );
+      bool has_receivers;
+      const glm::mat4 crop = calculateLightCropMatrix( frustum, split_view_projection, shadow_bounds, has_receivers );
+
+      // The split and the receivers in the clip space of the crop, where the shadow map spans [-1, 1].
+      glm::vec2 split_min(std::numeric_limits<float>::max()), split_max(std::numeric_limits<float>::lowest());
+      for (const auto& point : frustum) {
+         const glm::vec2 position(crop * light_view_projection * glm::vec4(point, 1.0f));
+         split_min = glm::min( split_min, position );
+         split_max = glm::max( split_max, position );
+      }
+      std::fill( used_cells.begin(), used_cells.end(), false );
+      const MeshletCuller split_culler(split_view_projection);
+      for (const auto& bounds : shadow_bounds) {
+         if (!split_culler.isInsideFrustum( bounds.World.Min, bounds.World.Max )) continue;
+
+         const glm::vec2 receiver_min = glm::max( glm::vec2(crop * glm::vec4(bounds.Light.Min, 1.0f)), split_min );
+         const glm::vec2 receiver_max = glm::min( glm::vec2(crop * glm::vec4(bounds.Light.Max, 1.0f)), split_max );
+         const glm::ivec2 first = glm::clamp(
+            glm::ivec2(glm::floor( (receiver_min + 1.0f) * 0.5f * static_cast<float>(grid_size) )), 0, grid_size
+         );
+         const glm::ivec2 last = glm::clamp(
+            glm::ivec2(glm::ceil( (receiver_max + 1.0f) * 0.5f * static_cast<float>(grid_size) )), 0, grid_size
+         );
+         for (int y = first.y; y < last.y; ++y) {
+            for (int x = first.x; x < last.x; ++x) used_cells[y * grid_size + x] = true;
+         }
+      }
+      const auto used = static_cast<float>(std::count( used_cells.begin(), used_cells.end(), true )) /
+         static_cast<float>(grid_size * grid_size);
+
+      // The texels that a unit of the world spans in the light view, along the coarser axis of the crop.
+      const float texels_per_unit = 0.5f * static_cast<float>(ShadowMapSize) *
+         std::min( crop[0][0] * light_projection[0][0], crop[1][1] * light_projection[1][1] );
+      text << " - split " << i << ": " << 100.0f * used << "% used, " << 100.0f * (1.0f - used) << "% wasted, "
+         << texels_per_unit << " texels per unit" << (has_receivers ? "\n" : ", no receivers\n");
+   }
+   std::cout << text.str();
+}
+
+void RendererGL::render()
 {
-   glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+   DrawRing->beginFrame();
+   constexpr GLfloat one = 1.0f;
+   constexpr std::array<GLfloat, 4> background{ 0.1f, 0.1f, 0.1f, 1.0f };
+   glClearNamedFramebufferfv( SceneFBO, GL_COLOR, 0, background.data() );
+   glClearNamedFramebufferfv( SceneFBO, GL_DEPTH, 0, &one );
 
    LightCamera->updateCameraView(
       glm::vec3(Lights->getLightPosition( ActiveLightIndex )),
@@ -504,9 +1035,38 @@ void RendererGL::render() const
 
    std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
 
+   // The splits change only the near and far planes of the main camera, so its view holds for every pass.
+   Lights->updateLightBuffer( MainCamera->getViewMatrix() );
+
+   // The splits follow the depths that the camera saw a frame or two ago, widened for what has come into view since.
    const float original_n = MainCamera->getNearPlane();
    const float original_f = MainCamera->getFarPlane();
-   for (int i = 0; i < SplitNum; ++i) {
+   float visible_near, visible_far;
+   if (SampleDistribution && Reducer->getDepthRange( visible_near, visible_far )) {
+      constexpr float margin = 0.1f;
+      splitViewFrustum(
+         std::max( original_n, visible_near * (1.0f - margin) ), std::min( original_f, visible_far * (1.0f + margin) )
+      );
+   }
+   else splitViewFrustum( original_n, original_f );
+
+   // The passes of every split are set up before any of them is drawn, so that one dispatch culls them all.
+   // The scene is either shaded once, with each fragment sampling the split that contains it, or once per split
+   // with the depth range and the near and far planes sliced to it. The first and the last of these slices reach out
+   // to the planes of the camera, so that nothing is clipped where the splits do not.
+   const int split_num = std::min( SplitNum, MaxSplitNum );
+   std::vector<float> scene_slices{ original_n };
+   if (!SingleScenePass) {
+      scene_slices.insert( scene_slices.end(), SplitPositions.begin() + 1, SplitPositions.begin() + split_num );
+   }
+   scene_slices.emplace_back( original_f );
+   std::vector<PassData> light_view_passes, scene_passes;
+   light_view_passes.reserve( split_num );
+   scene_passes.reserve( split_num );
+   std::vector<ShadowBounds> shadow_bounds;
+   if (TightCrop) getShadowBounds( shadow_bounds, false );
+   if (GpuCulling) Culler->clear();
+   for (int i = 0; i < split_num; ++i) {
       std::array<glm::vec3, 8> frustum{};
       getSplitFrustum( frustum, SplitPositions[i], SplitPositions[i + 1] );
 
@@ -514,48 +1074,80 @@ void RendererGL::render() const
       //std::array<glm::vec3, 8> bounding_box{};
       //getBoundingBox( bounding_box, frustum );
 
-      const glm::mat4 crop_matrix = calculateLightCropMatrix( frustum );
-
-      drawDepthMapFromLightView( crop_matrix );
-
-      //writeDepthTexture( "../light_view" + std::to_string( i ) + ".png" );
-
-      glDepthRange(
-         (SplitPositions[i] - original_n) / (original_f - original_n),
-         (SplitPositions[i + 1] - original_n) / (original_f - original_n)
+      // A split without receivers is never sampled, so it is not drawn either.
+      bool has_receivers;
+      const glm::mat4 crop_matrix = calculateLightCropMatrix(
+         frustum, getSplitViewProjection( SplitPositions[i], SplitPositions[i + 1] ), shadow_bounds, has_receivers
       );
-      MainCamera->updateNearFarPlanes( SplitPositions[i], SplitPositions[i + 1] );
-      drawShadow( crop_matrix );
-      glDepthRange( 0.0f, 1.0f );
-      MainCamera->updateNearFarPlanes( original_n, original_f );
+      light_view_passes.emplace_back( getLightViewPass( crop_matrix, i ) );
+      light_view_passes.back().HasCasters &= has_receivers;
+      if (GpuCulling && light_view_passes.back().HasCasters) addCullingView( light_view_passes.back() );
+      if (!SingleScenePass) {
+         MainCamera->updateNearFarPlanes( scene_slices[i], scene_slices[i + 1] );
+         scene_passes.emplace_back( getScenePass( i ) );
+         if (GpuCulling) addCullingView( scene_passes.back() );
+         MainCamera->updateNearFarPlanes( original_n, original_f );
+      }
+   }
+   if (SingleScenePass) {
+      scene_passes.emplace_back( getScenePass( -1 ) );
+      if (GpuCulling) addCullingView( scene_passes.back() );
+   }
+   if (GpuCulling && !Culler->cull( CullingShader->getShaderProgram(), DrawRing.get() )) {
+      std::cerr << "The uniform ring is too small for the culling views\n";
+   }
+   if (!bindCascadeData( light_view_passes )) std::cerr << "The uniform ring is too small for the cascades\n";
+
+   drawDepthMapsFromLightView( light_view_passes );
+   //for (int i = 0; i < split_num; ++i) writeDepthTexture( "../light_view" + std::to_string( i ) + ".png", i );
+
+   if (SingleScenePass) drawShadow( scene_passes.front() );
+   else {
+      for (int i = 0; i < split_num; ++i) {
+         glDepthRange(
+            (scene_slices[i] - original_n) / (original_f - original_n),
+            (scene_slices[i + 1] - original_n) / (original_f - original_n)
+         );
+         MainCamera->updateNearFarPlanes( scene_slices[i], scene_slices[i + 1] );
+         drawShadow( scene_passes[i] );
+         glDepthRange( 0.0f, 1.0f );
+         MainCamera->updateNearFarPlanes( original_n, original_f );
+      }
    }
+   if (SampleDistribution) Reducer->reduce( ReductionShader->getShaderProgram(), SceneDepthTextureID, scene_slices );
+   glBlitNamedFramebuffer(
+      SceneFBO, 0, 0, 0, FrameWidth, FrameHeight, 0, 0, FrameWidth, FrameHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST
+   );
 
    std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
    const auto fps = 1E+6 / static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
    std::stringstream text;
    text << std::fixed << std::setprecision( 2 ) << fps << " fps";
    drawText( text.str() );
+   DrawRing->endFrame();
 }
 
 void RendererGL::play()
 {
    if (glfwWindowShouldClose( Window )) initialize();
 
-   splitViewFrustum();
-   setLights();
-   setWallObject();
-   setBunnyObject();
-   setDepthFrameBuffer();
-
-   TextShader->setTextUniformLocations();
-   SceneShader->setSceneUniformLocations( 1 );
-   LightViewShader->setLightViewUniformLocations();
+   prepareScene();
 
+   bool first_frame = true;
    while (!glfwWindowShouldClose( Window )) {
+      Loader->update();
       if (!Pause) render();
 
       glfwSwapBuffers( Window );
       glfwPollEvents();
+
+      if (first_frame) {
+         first_frame = false;
+         const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - StartTime;
+         std::stringstream text;
+         text << std::fixed << std::setprecision( 1 ) << " - first frame after " << elapsed.count() << " ms\n";
+         std::cout << text.str();
+      }
    }
    glfwDestroyWindow( Window );
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "shader.h"
+#include <cstring>
 
-ShaderGL::ShaderGL() : ShaderProgram( 0 )
+ShaderGL::ShaderGL() : ShaderProgram( 0 ), CacheKey( 0 )
 {
 }
 
@@ -11,17 +12,16 @@ ShaderGL::~ShaderGL()
 
 void ShaderGL::readShaderFile(std::string& shader_contents, const char* shader_path)
 {
-   std::ifstream file( shader_path, std::ios::in );
+   std::ifstream file( shader_path, std::ios::in | std::ios::binary );
    if (!file.is_open()) {
       std::cerr << "Cannot open shader file: " << shader_path << "\n";
       return;
    }
 
-   std::string line;
-   while (!file.eof()) {
-      getline( file, line );
-      shader_contents.append( line + "\n" );
-   }
+   file.seekg( 0, std::ios::end );
+   shader_contents.resize( static_cast<size_t>(file.tellg()) );
+   file.seekg( 0, std::ios::beg );
+   file.read( shader_contents.data(), static_cast<std::streamsize>(shader_contents.size()) );
    file.close();
 }
 
@@ -75,7 +75,50 @@ GLuint ShaderGL::getCompiledShader(GLenum shader_type, const char* shader_path)
    return shader;
 }
 
-void ShaderGL::setShader(
+bool ShaderGL::checkLinkError(GLuint program)
+{
+   GLint linked = 0;
+   glGetProgramiv( program, GL_LINK_STATUS, &linked );
+
+   if (linked == GL_FALSE) {
+      GLint max_length = 0;
+      glGetProgramiv( program, GL_INFO_LOG_LENGTH, &max_length );
+
+      std::cerr << " ======= Program log ======= \n";
+      std::vector<GLchar> error_log(std::max( max_length, 1 ));
+      glGetProgramInfoLog( program, max_length, &max_length, &error_log[0] );
+      for (const auto& c : error_log) std::cerr << c;
+      std::cerr << "\n";
+   }
+   return linked == GL_TRUE;
+}
+
+bool ShaderGL::isExtensionSupported(const char* name)
+{
+   GLint extension_num = 0;
+   glGetIntegerv( GL_NUM_EXTENSIONS, &extension_num );
+   for (GLint i = 0; i < extension_num; ++i) {
+      const auto* extension = reinterpret_cast<const char*>(glGetStringi( GL_EXTENSIONS, static_cast<GLuint>(i) ));
+      if (extension != nullptr && std::strcmp( extension, name ) == 0) return true;
+   }
+   return false;
+}
+
+void ShaderGL::enableParallelCompile()
+{
+   // Even without the extension, most drivers keep compiling in the background until the status is queried.
+   using MaxShaderCompilerThreads = void (APIENTRYP)(GLuint count);
+   const char* function_name = nullptr;
+   if (isExtensionSupported( "GL_KHR_parallel_shader_compile" )) function_name = "glMaxShaderCompilerThreadsKHR";
+   else if (isExtensionSupported( "GL_ARB_parallel_shader_compile" )) function_name = "glMaxShaderCompilerThreadsARB";
+   if (function_name == nullptr) return;
+
+   const auto max_shader_compiler_threads = reinterpret_cast<MaxShaderCompilerThreads>(glfwGetProcAddress( function_name ));
+   if (max_shader_compiler_threads != nullptr) max_shader_compiler_threads( 0xFFFFFFFFu ); // as many as the driver likes
+}
+
+void ShaderGL::readShaderSources(
+   ShaderSources& sources,
    const char* vertex_shader_path,
    const char* fragment_shader_path,
    const char* geometry_shader_path,
@@ -83,23 +126,88 @@ void ShaderGL::setShader(
    const char* tessellation_evaluation_shader_path
 )
 {
-   const GLuint vertex_shader = getCompiledShader( GL_VERTEX_SHADER, vertex_shader_path );
-   const GLuint fragment_shader = getCompiledShader( GL_FRAGMENT_SHADER, fragment_shader_path );
-   const GLuint geometry_shader = getCompiledShader( GL_GEOMETRY_SHADER, geometry_shader_path );
-   const GLuint tessellation_control_shader = getCompiledShader( GL_TESS_CONTROL_SHADER, tessellation_control_shader_path );
-   const GLuint tessellation_evaluation_shader = getCompiledShader( GL_TESS_EVALUATION_SHADER, tessellation_evaluation_shader_path );
+   const std::array<std::pair<GLenum, const char*>, 5> stages = {
+      std::make_pair( GL_VERTEX_SHADER, vertex_shader_path ),
+      std::make_pair( GL_FRAGMENT_SHADER, fragment_shader_path ),
+      std::make_pair( GL_GEOMETRY_SHADER, geometry_shader_path ),
+      std::make_pair( GL_TESS_CONTROL_SHADER, tessellation_control_shader_path ),
+      std::make_pair( GL_TESS_EVALUATION_SHADER, tessellation_evaluation_shader_path )
+   };
+   sources.Stages.clear();
+   for (const auto& stage : stages) {
+      if (stage.second == nullptr) continue;
+
+      std::string shader_contents;
+      readShaderFile( shader_contents, stage.second );
+      sources.Stages.emplace_back( stage.first, std::move( shader_contents ) );
+   }
+}
+
+void ShaderGL::compileShader(const ShaderSources& sources)
+{
+   ShaderProgram = glCreateProgram();
+   CacheKey = ProgramCache::getKey( sources.Stages );
+   if (ProgramCache::load( ShaderProgram, CacheKey )) {
+      CacheKey = 0;
+      return;
+   }
+
+   // A rejected binary leaves the program in a failed state, so the compile starts over with a new one.
+   glDeleteProgram( ShaderProgram );
    ShaderProgram = glCreateProgram();
-   glAttachShader( ShaderProgram, vertex_shader );
-   glAttachShader( ShaderProgram, fragment_shader );
-   if (geometry_shader != 0) glAttachShader( ShaderProgram, geometry_shader );
-   if (tessellation_control_shader != 0) glAttachShader( ShaderProgram, tessellation_control_shader );
-   if (tessellation_evaluation_shader != 0) glAttachShader( ShaderProgram, tessellation_evaluation_shader );
+   glProgramParameteri( ShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+   for (const auto& stage : sources.Stages) {
+      const GLuint shader = glCreateShader( stage.first );
+      const char* shader_source = stage.second.c_str();
+      glShaderSource( shader, 1, &shader_source, nullptr );
+      glCompileShader( shader );
+      glAttachShader( ShaderProgram, shader );
+      PendingShaders.emplace_back( stage.first, shader );
+   }
    glLinkProgram( ShaderProgram );
-   glDeleteShader( vertex_shader );
-   glDeleteShader( fragment_shader );
-   if (geometry_shader != 0) glDeleteShader( geometry_shader );
-   if (tessellation_control_shader != 0) glDeleteShader( tessellation_control_shader );
-   if (tessellation_evaluation_shader != 0) glDeleteShader( tessellation_evaluation_shader );
+}
+
+bool ShaderGL::finishShader()
+{
+   bool compiled = true;
+   for (const auto& shader : PendingShaders) {
+      // A shader that failed is deleted by checkCompileError.
+      if (checkCompileError( shader.first, shader.second )) glDeleteShader( shader.second );
+      else compiled = false;
+   }
+   PendingShaders.clear();
+   if (!compiled) {
+      std::cerr << "Could not compile shader\n";
+      return false;
+   }
+   if (!checkLinkError( ShaderProgram )) return false;
+
+   if (CacheKey != 0 && !ProgramCache::write( ShaderProgram, CacheKey )) {
+      std::cerr << "Could not write the program cache " << ProgramCache::getCachePath( CacheKey ) << "\n";
+   }
+   CacheKey = 0;
+   return true;
+}
+
+void ShaderGL::setShader(
+   const char* vertex_shader_path,
+   const char* fragment_shader_path,
+   const char* geometry_shader_path,
+   const char* tessellation_control_shader_path,
+   const char* tessellation_evaluation_shader_path
+)
+{
+   ShaderSources sources;
+   readShaderSources(
+      sources,
+      vertex_shader_path,
+      fragment_shader_path,
+      geometry_shader_path,
+      tessellation_control_shader_path,
+      tessellation_evaluation_shader_path
+   );
+   compileShader( sources );
+   finishShader();
 }
 
 void ShaderGL::setComputeShaders(const char* compute_shader_path)
@@ -119,51 +227,44 @@ void ShaderGL::setBasicTransformationUniforms()
    Location.ModelViewProjection = glGetUniformLocation( ShaderProgram, "ModelViewProjectionMatrix" );
 }
 
+void ShaderGL::addUniformLocation(const UniformName& name)
+{
+#ifndef NDEBUG
+   for (const auto& uniform : CustomLocations) {
+      if (uniform.Hash == name.Hash && std::strcmp( uniform.Name, name.Name ) != 0) {
+         std::cerr << "Uniform names " << uniform.Name << " and " << name.Name << " have the same hash\n";
+         assert( false );
+      }
+   }
+#endif
+   const GLint location = glGetUniformLocation( ShaderProgram, name.Name );
+   for (auto& uniform : CustomLocations) {
+      if (uniform.Hash == name.Hash) {
+         uniform.Location = location;
+         return;
+      }
+   }
+   CustomLocations.push_back( { name.Hash, location, name.Name } );
+}
+
 void ShaderGL::setTextUniformLocations()
 {
    setBasicTransformationUniforms();
-   addUniformLocation( "TextScale" );
+   addUniformLocation( Uniform::TextScale );
    Location.Texture[0] = glGetUniformLocation( ShaderProgram, "BaseTexture" );
 }
 
 void ShaderGL::setLightViewUniformLocations()
 {
    setBasicTransformationUniforms();
-   addUniformLocation( "LightCropMatrix" );
 }
 
-void ShaderGL::setSceneUniformLocations(int light_num)
+void ShaderGL::setSceneUniformLocations()
 {
    setBasicTransformationUniforms();
-
-   Location.MaterialEmission = glGetUniformLocation( ShaderProgram, "Material.EmissionColor" );
-   Location.MaterialAmbient = glGetUniformLocation( ShaderProgram, "Material.AmbientColor" );
-   Location.MaterialDiffuse = glGetUniformLocation( ShaderProgram, "Material.DiffuseColor" );
-   Location.MaterialSpecular = glGetUniformLocation( ShaderProgram, "Material.SpecularColor" );
-   Location.MaterialSpecularExponent = glGetUniformLocation( ShaderProgram, "Material.SpecularExponent" );
-
    Location.Texture[0] = glGetUniformLocation( ShaderProgram, "BaseTexture" );
 
-   Location.UseLight = glGetUniformLocation( ShaderProgram, "UseLight" );
-   Location.LightNum = glGetUniformLocation( ShaderProgram, "LightNum" );
-   Location.GlobalAmbient = glGetUniformLocation( ShaderProgram, "GlobalAmbient" );
-
-   Location.Lights.resize( light_num );
-   for (int i = 0; i < light_num; ++i) {
-      Location.Lights[i].LightSwitch = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].LightSwitch").c_str() );
-      Location.Lights[i].LightPosition = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].Position").c_str() );
-      Location.Lights[i].LightAmbient = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].AmbientColor").c_str() );
-      Location.Lights[i].LightDiffuse = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].DiffuseColor").c_str() );
-      Location.Lights[i].LightSpecular = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].SpecularColor").c_str() );
-      Location.Lights[i].SpotlightDirection = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].SpotlightDirection").c_str() );
-      Location.Lights[i].SpotlightCutoffAngle = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].SpotlightCutoffAngle").c_str() );
-      Location.Lights[i].SpotlightFeather = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].SpotlightFeather").c_str() );
-      Location.Lights[i].LightFallOffRadius = glGetUniformLocation( ShaderProgram, std::string("Lights[" + std::to_string( i ) + "].FallOffRadius").c_str() );
-   }
-
-   addUniformLocation( "UseTexture" );
-   addUniformLocation( "LightIndex" );
-   addUniformLocation( "LightViewProjectionMatrix" );
+   addUniformLocation( Uniform::LightIndex );
 }
 
 void ShaderGL::transferBasicTransformationUniforms(const glm::mat4& to_world, const CameraGL* camera) const
@@ -0,0 +1,76 @@
+#include "shader_permutations.h"
+
+ShaderPermutationsGL::ShaderPermutationsGL(
+   std::vector<Define> defines,
+   std::function<void(ShaderGL*)> set_uniform_locations
+) : Defines( std::move( defines ) ), SetUniformLocations( std::move( set_uniform_locations ) )
+{
+}
+
+void ShaderPermutationsGL::setSources(ShaderGL::ShaderSources&& sources)
+{
+   Sources = std::move( sources );
+   Variants.clear();
+}
+
+uint64_t ShaderPermutationsGL::getKey(std::initializer_list<int> values) const
+{
+   assert( values.size() == Defines.size() );
+
+   uint64_t key = 0;
+   int shift = 0;
+   auto value = values.begin();
+   for (const auto& define : Defines) {
+      assert( 0 <= *value && *value < 1 << define.Bits );
+      key |= static_cast<uint64_t>(*value++) << shift;
+      shift += define.Bits;
+   }
+   return key;
+}
+
+std::string ShaderPermutationsGL::getDefineBlock(uint64_t key) const
+{
+   std::stringstream block;
+   for (const auto& define : Defines) {
+      const uint64_t mask = (1ull << define.Bits) - 1;
+      block << "#define " << define.Name << " " << (key & mask) << "\n";
+      key >>= define.Bits;
+   }
+   return block.str();
+}
+
+void ShaderPermutationsGL::compileVariant(uint64_t key)
+{
+   if (Variants.find( key ) != Variants.end()) return;
+
+   // The defines have to follow the #version line, which must come first in every stage.
+   const std::string define_block = getDefineBlock( key );
+   ShaderGL::ShaderSources sources = Sources;
+   for (auto& stage : sources.Stages) {
+      const size_t version = stage.second.find( "#version" );
+      const size_t line_end = version == std::string::npos ? std::string::npos : stage.second.find( '\n', version );
+      if (line_end == std::string::npos) stage.second.insert( 0, define_block );
+      else stage.second.insert( line_end + 1, define_block );
+   }
+
+   Variant variant{ std::make_unique<ShaderGL>(), false };
+   variant.Shader->compileShader( sources );
+   Variants.emplace( key, std::move( variant ) );
+}
+
+ShaderGL* ShaderPermutationsGL::getVariant(uint64_t key)
+{
+   auto it = Variants.find( key );
+   if (it == Variants.end()) {
+      compileVariant( key );
+      it = Variants.find( key );
+   }
+
+   Variant& variant = it->second;
+   if (!variant.Finished) {
+      if (!variant.Shader->finishShader()) std::cerr << "Could not build the variant\n" << getDefineBlock( key );
+      SetUniformLocations( variant.Shader.get() );
+      variant.Finished = true;
+   }
+   return variant.Shader.get();
+}
\ No newline at end of file
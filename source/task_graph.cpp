@@ -0,0 +1,188 @@
+#include "task_graph.h"
+#include <numeric>
+
+int TaskGraph::addTask(
+   const std::string& name,
+   Thread thread,
+   std::function<void()> function,
+   const std::vector<int>& dependencies
+)
+{
+   const auto index = static_cast<int>(Tasks.size());
+   Task task;
+   task.Name = name;
+   task.RunOn = thread;
+   task.Function = std::move( function );
+   task.Dependencies = dependencies;
+   task.RemainingDependencyNum = static_cast<int>(dependencies.size());
+   task.ThreadIndex = 0;
+   Tasks.emplace_back( std::move( task ) );
+   for (const auto dependency : dependencies) {
+      assert( dependency < index );
+      Tasks[dependency].Dependents.emplace_back( index );
+   }
+   return index;
+}
+
+int TaskGraph::popFirst(std::vector<int>& ready)
+{
+   const auto first = std::min_element( ready.begin(), ready.end() );
+   const int task_index = *first;
+   ready.erase( first );
+   return task_index;
+}
+
+void TaskGraph::execute(int task_index, int thread_index)
+{
+   Task& task = Tasks[task_index];
+   task.ThreadIndex = thread_index;
+   task.Start = Clock::now();
+   task.Function();
+   task.End = Clock::now();
+
+   {
+      std::lock_guard<std::mutex> lock(Mutex);
+      for (const auto dependent : task.Dependents) {
+         if (--Tasks[dependent].RemainingDependencyNum > 0) continue;
+
+         if (Tasks[dependent].RunOn == Thread::Main) ReadyMainTasks.emplace_back( dependent );
+         else ReadyWorkerTasks.emplace_back( dependent );
+      }
+      FinishedTaskNum++;
+   }
+   Condition.notify_all();
+}
+
+void TaskGraph::work(int thread_index)
+{
+   const auto task_num = static_cast<int>(Tasks.size());
+   while (true) {
+      int task_index;
+      {
+         std::unique_lock<std::mutex> lock(Mutex);
+         Condition.wait( lock, [&]() { return FinishedTaskNum == task_num || !ReadyWorkerTasks.empty(); } );
+         if (ReadyWorkerTasks.empty()) return;
+
+         task_index = popFirst( ReadyWorkerTasks );
+      }
+      execute( task_index, thread_index );
+   }
+}
+
+void TaskGraph::run(int thread_num)
+{
+   const auto task_num = static_cast<int>(Tasks.size());
+   auto worker_num = static_cast<int>(std::count_if(
+      Tasks.begin(), Tasks.end(), [](const Task& task) { return task.RunOn == Thread::Worker; }
+   ));
+   if (thread_num <= 0) thread_num = static_cast<int>(std::thread::hardware_concurrency());
+   worker_num = std::min( worker_num, std::max( thread_num, 1 ) );
+
+   RunStart = Clock::now();
+   FinishedTaskNum = 0;
+   ReadyMainTasks.clear();
+   ReadyWorkerTasks.clear();
+   for (int i = 0; i < task_num; ++i) {
+      if (Tasks[i].RemainingDependencyNum > 0) continue;
+
+      if (Tasks[i].RunOn == Thread::Main) ReadyMainTasks.emplace_back( i );
+      else ReadyWorkerTasks.emplace_back( i );
+   }
+
+   std::vector<std::thread> workers;
+   workers.reserve( worker_num );
+   for (int i = 0; i < worker_num; ++i) workers.emplace_back( &TaskGraph::work, this, i + 1 );
+
+   while (true) {
+      int task_index;
+      {
+         std::unique_lock<std::mutex> lock(Mutex);
+         Condition.wait( lock, [&]() { return FinishedTaskNum == task_num || !ReadyMainTasks.empty(); } );
+         if (ReadyMainTasks.empty()) break;
+
+         task_index = popFirst( ReadyMainTasks );
+      }
+      execute( task_index, 0 );
+   }
+   for (auto& worker : workers) worker.join();
+}
+
+double TaskGraph::getElapsedTime() const
+{
+   auto end = RunStart;
+   for (const auto& task : Tasks) end = std::max( end, task.End );
+   return toMilliseconds( end );
+}
+
+void TaskGraph::getCriticalPath(std::vector<int>& path) const
+{
+   path.clear();
+   if (Tasks.empty()) return;
+
+   // Walk back from the task that finished last through whatever released it, which is either the dependency that
+   // finished last or the task that held its thread before it, whichever ended later. A task on the same thread has
+   // to start strictly earlier as well, so that zero-length tasks with equal timestamps cannot pick each other.
+   int current = static_cast<int>(std::max_element(
+      Tasks.begin(), Tasks.end(), [](const Task& a, const Task& b) { return a.End < b.End; }
+   ) - Tasks.begin());
+   while (current >= 0) {
+      path.emplace_back( current );
+      int previous = -1;
+      for (const auto dependency : Tasks[current].Dependencies) {
+         if (previous < 0 || Tasks[previous].End < Tasks[dependency].End) previous = dependency;
+      }
+      for (int i = 0; i < static_cast<int>(Tasks.size()); ++i) {
+         if (i == current || Tasks[i].ThreadIndex != Tasks[current].ThreadIndex) continue;
+         if (Tasks[current].Start < Tasks[i].End || Tasks[current].Start <= Tasks[i].Start) continue;
+         if (previous < 0 || Tasks[previous].End < Tasks[i].End) previous = i;
+      }
+      current = previous;
+   }
+   std::reverse( path.begin(), path.end() );
+}
+
+void TaskGraph::printTimeline() const
+{
+   size_t name_width = 0;
+   for (const auto& task : Tasks) name_width = std::max( name_width, task.Name.size() );
+
+   std::vector<int> order(Tasks.size());
+   std::iota( order.begin(), order.end(), 0 );
+   std::sort(
+      order.begin(), order.end(), [this](int a, int b) { return Tasks[a].Start < Tasks[b].Start; }
+   );
+
+   std::stringstream text;
+   text << std::fixed << std::setprecision( 1 );
+   text << "Startup timeline (" << getElapsedTime() << " ms)\n";
+   for (const auto i : order) {
+      const Task& task = Tasks[i];
+      text << " - " << std::left << std::setw( static_cast<int>(name_width) ) << task.Name << std::right
+         << std::setw( 9 ) << toMilliseconds( task.Start ) << " ~" << std::setw( 8 ) << toMilliseconds( task.End )
+         << " ms on " << (task.ThreadIndex == 0 ? "main" : "worker " + std::to_string( task.ThreadIndex )) << "\n";
+   }
+
+   std::vector<int> path;
+   getCriticalPath( path );
+   text << " - critical path:";
+   for (size_t i = 0; i < path.size(); ++i) text << (i == 0 ? " " : " -> ") << Tasks[path[i]].Name;
+   text << "\n";
+   std::cout << text.str();
+}
+
+bool TaskGraph::exportTimeline(const std::string& file_path) const
+{
+   std::ofstream file(file_path);
+   if (!file.is_open()) return false;
+
+   file << std::fixed << std::setprecision( 3 ) << "[\n";
+   for (size_t i = 0; i < Tasks.size(); ++i) {
+      const Task& task = Tasks[i];
+      file << "{ \"name\": \"" << task.Name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << task.ThreadIndex
+         << ", \"ts\": " << toMilliseconds( task.Start ) * 1000.0
+         << ", \"dur\": " << (toMilliseconds( task.End ) - toMilliseconds( task.Start )) * 1000.0 << " }"
+         << (i + 1 < Tasks.size() ? ",\n" : "\n");
+   }
+   file << "]\n";
+   return static_cast<bool>(file);
+}
\ No newline at end of file
@@ -13,7 +13,7 @@ TextGL::~TextGL()
    if (FontLibrary != nullptr) FT_Done_FreeType( FontLibrary );
 }
 
-void TextGL::initialize()
+void TextGL::loadFont()
 {
    if (FT_Init_FreeType( &FontLibrary )) std::cerr << "Could not initialize FreeType2 library\n";
 
@@ -21,7 +21,11 @@ void TextGL::initialize()
    const int width = convertFloatTo26Dot6( 50.0f );
    const int height = convertFloatTo26Dot6( 50.0f );
    FT_Set_Char_Size( FontFace, width, height, 72, 72 );
+}
 
+void TextGL::initialize()
+{
+   if (FontLibrary == nullptr) loadFont();
    GlyphObject->setSquareObject( GL_TRIANGLES, true );
 }
 
@@ -0,0 +1,69 @@
+#include "uniform_ring.h"
+#include <cstring>
+
+UniformRingGL::UniformRingGL(GLsizeiptr frame_size, int frame_num) :
+   Buffer( 0 ), Data( nullptr ), FrameSize( 0 ), Alignment( 256 ), FrameIndex( 0 ), Head( 0 ),
+   Fences( std::max( frame_num, 1 ), nullptr )
+{
+   // Every range is aligned for both kinds of blocks.
+   GLint uniform_alignment = 0, storage_alignment = 0;
+   glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment );
+   glGetIntegerv( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment );
+   const GLint alignment = std::max( uniform_alignment, storage_alignment );
+   if (alignment > 0) Alignment = alignment;
+   FrameSize = (frame_size + Alignment - 1) / Alignment * Alignment;
+
+   // Coherent writes through the mapping are visible to the draws issued after them without any flush.
+   constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+   const GLsizeiptr size = FrameSize * static_cast<GLsizeiptr>(Fences.size());
+   glCreateBuffers( 1, &Buffer );
+   glNamedBufferStorage( Buffer, size, nullptr, flags );
+   Data = static_cast<uint8_t*>(glMapNamedBufferRange( Buffer, 0, size, flags ));
+}
+
+UniformRingGL::~UniformRingGL()
+{
+   for (const auto& fence : Fences) {
+      if (fence != nullptr) glDeleteSync( fence );
+   }
+   if (Buffer != 0) {
+      glUnmapNamedBuffer( Buffer );
+      glDeleteBuffers( 1, &Buffer );
+   }
+}
+
+void UniformRingGL::beginFrame()
+{
+   GLsync& fence = Fences[FrameIndex];
+   if (fence != nullptr) {
+      while (glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 ) == GL_TIMEOUT_EXPIRED) {}
+      glDeleteSync( fence );
+      fence = nullptr;
+   }
+   Head = 0;
+}
+
+void UniformRingGL::endFrame()
+{
+   Fences[FrameIndex] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+   FrameIndex = (FrameIndex + 1) % static_cast<int>(Fences.size());
+}
+
+bool UniformRingGL::write(const void* data, GLsizeiptr size, GLintptr& offset)
+{
+   if (Head + size > FrameSize) return false;
+
+   offset = static_cast<GLintptr>(FrameIndex) * FrameSize + Head;
+   std::memcpy( Data + offset, data, size );
+   Head = (Head + size + Alignment - 1) / Alignment * Alignment;
+   return true;
+}
+
+bool UniformRingGL::bind(GLenum target, GLuint binding, const void* data, GLsizeiptr size)
+{
+   GLintptr offset;
+   if (!write( data, size, offset )) return false;
+
+   glBindBufferRange( target, binding, Buffer, offset, size );
+   return true;
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "vertex_format.h"
+#include <gtc/packing.hpp>
+#include <cstring>
+
+glm::vec2 VertexFormat::encodeOctahedral(const glm::vec3& normal)
+{
+   const glm::vec3 n = normal / (std::abs( normal.x ) + std::abs( normal.y ) + std::abs( normal.z ));
+   if (n.z >= 0.0f) return { n.x, n.y };
+   return {
+      (1.0f - std::abs( n.y )) * (n.x >= 0.0f ? 1.0f : -1.0f),
+      (1.0f - std::abs( n.x )) * (n.y >= 0.0f ? 1.0f : -1.0f)
+   };
+}
+
+glm::vec3 VertexFormat::decodeOctahedral(const glm::vec2& encoded)
+{
+   glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs( encoded.x ) - std::abs( encoded.y ));
+   const float t = std::max( -n.z, 0.0f );
+   n.x += n.x >= 0.0f ? -t : t;
+   n.y += n.y >= 0.0f ? -t : t;
+   return glm::normalize( n );
+}
+
+glm::vec3 VertexFormat::decodePosition(
+   const uint8_t* vertex,
+   const glm::vec3& bounds_min,
+   const glm::vec3& bounds_max
+) const
+{
+   if (Position == PositionType::Float32) {
+      glm::vec3 position;
+      std::memcpy( &position[0], vertex, sizeof( glm::vec3 ) );
+      return position;
+   }
+
+   uint64_t packed;
+   std::memcpy( &packed, vertex, sizeof( packed ) );
+   if (Position == PositionType::Float16) return glm::vec3(glm::unpackHalf4x16( packed ));
+   return glm::vec3(glm::unpackUnorm4x16( packed )) * (bounds_max - bounds_min) + bounds_min;
+}
+
+void VertexFormat::encode(
+   std::vector<uint8_t>& encoded,
+   const std::vector<float>& vertices,
+   bool normals_exist,
+   bool textures_exist,
+   const glm::vec3& bounds_min,
+   const glm::vec3& bounds_max
+) const
+{
+   const size_t floats_per_vertex = 3 + (normals_exist ? 3 : 0) + (textures_exist ? 2 : 0);
+   const size_t vertex_num = vertices.size() / floats_per_vertex;
+   const uint32_t stride = getStride( normals_exist, textures_exist );
+   const uint32_t texture_offset = getTextureOffset( normals_exist );
+   const glm::vec3 extent = bounds_max - bounds_min;
+   const glm::vec3 inverse_extent(
+      extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+      extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+      extent.z > 0.0f ? 1.0f / extent.z : 0.0f
+   );
+
+   encoded.resize( vertex_num * stride );
+   for (size_t i = 0; i < vertex_num; ++i) {
+      const float* vertex = vertices.data() + i * floats_per_vertex;
+      uint8_t* out = encoded.data() + i * stride;
+
+      const glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+      if (Position == PositionType::Float32) std::memcpy( out, &position[0], sizeof( glm::vec3 ) );
+      else {
+         const uint64_t packed = Position == PositionType::Float16 ?
+            glm::packHalf4x16( glm::vec4(position, 0.0f) ) :
+            glm::packUnorm4x16( glm::vec4((position - bounds_min) * inverse_extent, 0.0f) );
+         std::memcpy( out, &packed, sizeof( packed ) );
+      }
+
+      if (normals_exist) {
+         uint8_t* normal_out = out + getNormalOffset();
+         const glm::vec3 normal(vertex[3], vertex[4], vertex[5]);
+         const float length = glm::length( normal );
+         const glm::vec3 unit = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+         if (Normal == NormalType::Float32) std::memcpy( normal_out, &normal[0], sizeof( glm::vec3 ) );
+         else if (Normal == NormalType::SNorm10) {
+            const uint32_t packed = glm::packSnorm3x10_1x2( glm::vec4(unit, 0.0f) );
+            std::memcpy( normal_out, &packed, sizeof( packed ) );
+         }
+         else {
+            // Rounding each component to the nearest step is not always the closest direction after decoding,
+            // so the four neighboring grid points are tried.
+            const glm::vec2 octahedral = encodeOctahedral( unit ) * 32767.0f;
+            const glm::vec2 base = glm::floor( octahedral );
+            glm::vec2 best = glm::round( octahedral );
+            float best_cosine = -2.0f;
+            for (int c = 0; c < 4; ++c) {
+               const glm::vec2 candidate = glm::clamp(
+                  base + glm::vec2(static_cast<float>(c & 1), static_cast<float>(c >> 1)), -32767.0f, 32767.0f
+               );
+               const float cosine = glm::dot( decodeOctahedral( candidate / 32767.0f ), unit );
+               if (cosine > best_cosine) {
+                  best_cosine = cosine;
+                  best = candidate;
+               }
+            }
+            const std::array<int16_t, 2> packed = { static_cast<int16_t>(best.x), static_cast<int16_t>(best.y) };
+            std::memcpy( normal_out, packed.data(), sizeof( packed ) );
+         }
+      }
+
+      if (textures_exist) {
+         const float* texture = vertex + (normals_exist ? 6 : 3);
+         if (Texture == TextureType::Float32) std::memcpy( out + texture_offset, texture, 2 * sizeof( float ) );
+         else {
+            const uint32_t packed = glm::packHalf2x16( glm::vec2(texture[0], texture[1]) );
+            std::memcpy( out + texture_offset, &packed, sizeof( packed ) );
+         }
+      }
+   }
+}
+
+void VertexFormat::reportError(
+   const std::string& name,
+   const std::vector<uint8_t>& encoded,
+   const std::vector<float>& vertices,
+   bool normals_exist,
+   bool textures_exist,
+   const glm::vec3& bounds_min,
+   const glm::vec3& bounds_max
+) const
+{
+   const size_t floats_per_vertex = 3 + (normals_exist ? 3 : 0) + (textures_exist ? 2 : 0);
+   const size_t vertex_num = vertices.size() / floats_per_vertex;
+   const uint32_t stride = getStride( normals_exist, textures_exist );
+   const uint32_t texture_offset = getTextureOffset( normals_exist );
+   const float diagonal = glm::distance( bounds_min, bounds_max );
+
+   double max_position_error = 0.0, squared_position_error = 0.0, max_normal_angle = 0.0, max_texture_error = 0.0;
+   for (size_t i = 0; i < vertex_num; ++i) {
+      const float* vertex = vertices.data() + i * floats_per_vertex;
+      const uint8_t* in = encoded.data() + i * stride;
+
+      const glm::vec3 position = decodePosition( in, bounds_min, bounds_max );
+      const double error = glm::distance( position, glm::vec3(vertex[0], vertex[1], vertex[2]) );
+      max_position_error = std::max( max_position_error, error );
+      squared_position_error += error * error;
+
+      if (normals_exist) {
+         const glm::vec3 original(vertex[3], vertex[4], vertex[5]);
+         if (Normal != NormalType::Float32 && glm::length( original ) > 0.0f) {
+            glm::vec3 normal;
+            if (Normal == NormalType::SNorm10) {
+               uint32_t packed;
+               std::memcpy( &packed, in + getNormalOffset(), sizeof( packed ) );
+               normal = glm::normalize( glm::vec3(glm::unpackSnorm3x10_1x2( packed )) );
+            }
+            else {
+               std::array<int16_t, 2> packed{};
+               std::memcpy( packed.data(), in + getNormalOffset(), sizeof( packed ) );
+               normal = decodeOctahedral( glm::vec2(packed[0], packed[1]) / 32767.0f );
+            }
+            const float cosine = glm::clamp( glm::dot( normal, glm::normalize( original ) ), -1.0f, 1.0f );
+            max_normal_angle = std::max( max_normal_angle, static_cast<double>(glm::degrees( std::acos( cosine ) )) );
+         }
+      }
+
+      if (textures_exist && Texture == TextureType::Float16) {
+         uint32_t packed;
+         std::memcpy( &packed, in + texture_offset, sizeof( packed ) );
+         const float* texture = vertex + (normals_exist ? 6 : 3);
+         const glm::vec2 difference = glm::abs( glm::unpackHalf2x16( packed ) - glm::vec2(texture[0], texture[1]) );
+         max_texture_error = std::max( max_texture_error, static_cast<double>(std::max( difference.x, difference.y )) );
+      }
+   }
+
+   const double rms_position_error = vertex_num > 0 ? std::sqrt( squared_position_error / vertex_num ) : 0.0;
+   const double scale = diagonal > 0.0f ? 1.0 / diagonal : 0.0;
+   std::stringstream report;
+   report << "Quantized " << name << ": " << floats_per_vertex * sizeof( float ) << " -> " << stride << " bytes per vertex\n"
+      << std::scientific << std::setprecision( 3 )
+      << " - position error: max " << max_position_error << " (" << max_position_error * scale << " of the diagonal), rms "
+      << rms_position_error << " (" << rms_position_error * scale << " of the diagonal)\n";
+   if (normals_exist) report << " - normal error: max " << std::fixed << max_normal_angle << " degrees\n";
+   if (textures_exist) report << " - texture coordinate error: max " << std::scientific << max_texture_error << "\n";
+   std::cout << report.str();
+}
\ No newline at end of file
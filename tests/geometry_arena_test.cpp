@@ -0,0 +1,152 @@
+#include "geometry_arena.h"
+#include <random>
+
+// Checks FreeListAllocator, which GeometryArenaGL suballocates its buffers with, without an OpenGL context:
+// alignment, the merging of freed neighbors, the reuse of holes, growth, and a random sequence of allocations and
+// releases against a map of the bytes in use.
+
+namespace
+{
+   int FailureNum = 0;
+
+   void check(bool condition, const std::string& message)
+   {
+      if (condition) return;
+      std::cerr << "FAILED: " << message << "\n";
+      ++FailureNum;
+   }
+
+   void testAlignment()
+   {
+      FreeListAllocator allocator(1000);
+      GLintptr offset = -1;
+      check( allocator.allocate( 10, 1, offset ) && offset == 0, "the first block is not at 0" );
+      // Vertex ranges are aligned to their stride, which does not have to be a power of two.
+      check( allocator.allocate( 24, 12, offset ) && offset == 12, "a block is not aligned to 12 bytes" );
+      check( allocator.allocate( 8, 7, offset ) && offset == 42, "a block is not aligned to 7 bytes" );
+      check( allocator.getFreeBlockNum() == 3, "the padding in front of the aligned blocks is not free" );
+      check( allocator.allocate( 2, 1, offset ) && offset == 10, "the padding is not reused" );
+      check( allocator.getUsedSize() == 44, "the used size counts the padding" );
+      check( !allocator.allocate( 951, 1, offset ), "a block larger than the rest fits" );
+      check( allocator.allocate( 950, 1, offset ) && offset == 50, "the rest does not fit" );
+      check( allocator.getFreeBlockNum() == 1 && allocator.getLargestFreeBlock() == 6, "the padding is not free" );
+   }
+
+   void testCoalescing()
+   {
+      FreeListAllocator allocator(300);
+      std::array<GLintptr, 3> offsets{};
+      for (auto& offset : offsets) check( allocator.allocate( 100, 1, offset ), "the blocks do not fit" );
+      check( allocator.getFreeBlockNum() == 0, "a full allocator has free blocks" );
+
+      allocator.release( offsets[0], 100 );
+      allocator.release( offsets[2], 100 );
+      check( allocator.getFreeBlockNum() == 2, "released blocks apart from each other are merged" );
+      allocator.release( offsets[1], 100 );
+      check( allocator.getFreeBlockNum() == 1, "a released block is not merged with both neighbors" );
+      check( allocator.getLargestFreeBlock() == 300 && allocator.getUsedSize() == 0, "the merged block is not whole" );
+
+      GLintptr offset = -1;
+      check( allocator.allocate( 300, 1, offset ) && offset == 0, "the merged block cannot be allocated at once" );
+   }
+
+   void testHoles()
+   {
+      FreeListAllocator allocator(1000);
+      std::array<GLintptr, 3> offsets{};
+      for (auto& offset : offsets) check( allocator.allocate( 100, 1, offset ), "the blocks do not fit" );
+      allocator.release( offsets[1], 100 );
+
+      GLintptr offset = -1;
+      check( allocator.allocate( 60, 4, offset ) && offset == 100, "the first hole that fits is not taken" );
+      check( allocator.allocate( 50, 1, offset ) && offset == 300, "a block that does not fit the hole goes into it" );
+      check( allocator.allocate( 40, 1, offset ) && offset == 160, "the rest of the hole is not reused" );
+      check( allocator.getFreeBlockNum() == 1, "the hole is not filled" );
+   }
+
+   void testGrowth()
+   {
+      FreeListAllocator allocator(256);
+      GLintptr first = -1, second = -1, offset = -1;
+      check( allocator.allocate( 128, 1, first ) && allocator.allocate( 100, 1, second ), "the blocks do not fit" );
+      check( !allocator.allocate( 64, 1, offset ), "a block larger than the tail fits" );
+
+      // The free tail of 28 bytes and the new space are one block, so the block fits right after the second one.
+      allocator.grow( 512 );
+      check( allocator.getCapacity() == 512 && allocator.getUsedSize() == 228, "growth changes the used size" );
+      check( allocator.getFreeBlockNum() == 1, "the old tail is not merged with the new space" );
+      check( allocator.allocate( 64, 1, offset ) && offset == 228, "the grown space does not follow the old tail" );
+
+      allocator.release( first, 128 );
+      allocator.release( second, 100 );
+      check( allocator.allocate( 228, 1, offset ) && offset == 0, "the blocks before the growth are not at 0" );
+      allocator.grow( 128 );
+      check( allocator.getCapacity() == 512, "the allocator shrinks" );
+   }
+
+   void testRandom()
+   {
+      constexpr GLsizeiptr capacity = 1 << 12;
+      FreeListAllocator allocator(capacity);
+      std::vector<bool> used(capacity * 4, false);
+      std::vector<std::pair<GLintptr, GLsizeiptr>> blocks;
+      std::mt19937 generator(11);
+      std::uniform_int_distribution<GLsizeiptr> size( 1, 200 );
+      std::uniform_int_distribution<GLsizeiptr> alignment( 1, 24 );
+      GLsizeiptr used_size = 0;
+      int overlap_num = 0, misaligned_num = 0;
+      for (int i = 0; i < 20000; ++i) {
+         if (!blocks.empty() && generator() % 2 == 0) {
+            const size_t index = generator() % blocks.size();
+            const auto block = blocks[index];
+            blocks[index] = blocks.back();
+            blocks.pop_back();
+            allocator.release( block.first, block.second );
+            std::fill( used.begin() + block.first, used.begin() + block.first + block.second, false );
+            used_size -= block.second;
+            continue;
+         }
+
+         const GLsizeiptr block_size = size( generator );
+         const GLsizeiptr block_alignment = alignment( generator );
+         GLintptr offset = -1;
+         if (!allocator.allocate( block_size, block_alignment, offset )) {
+            // Growing keeps every offset, as the arena copies the old buffer to the start of the new one.
+            if (allocator.getCapacity() < static_cast<GLsizeiptr>(used.size()) / 2) {
+               allocator.grow( allocator.getCapacity() * 2 );
+            }
+            continue;
+         }
+         if (offset % block_alignment != 0) misaligned_num++;
+         if (offset + block_size > allocator.getCapacity() ||
+             std::find( used.begin() + offset, used.begin() + offset + block_size, true ) !=
+             used.begin() + offset + block_size) overlap_num++;
+         else std::fill( used.begin() + offset, used.begin() + offset + block_size, true );
+         blocks.emplace_back( offset, block_size );
+         used_size += block_size;
+      }
+      check( misaligned_num == 0, std::to_string( misaligned_num ) + " random blocks are misaligned" );
+      check( overlap_num == 0, std::to_string( overlap_num ) + " random blocks overlap" );
+      check( allocator.getUsedSize() == used_size, "the used size drifts" );
+
+      for (const auto& block : blocks) allocator.release( block.first, block.second );
+      check( allocator.getUsedSize() == 0, "the used size is not 0 after releasing everything" );
+      check( allocator.getFreeBlockNum() == 1 && allocator.getLargestFreeBlock() == allocator.getCapacity(),
+         "the free blocks are not merged after releasing everything" );
+   }
+}
+
+int main()
+{
+   testAlignment();
+   testCoalescing();
+   testHoles();
+   testGrowth();
+   testRandom();
+   if (FailureNum > 0) {
+      std::cerr << FailureNum << " checks failed\n";
+      return 1;
+   }
+   std::cout << "All checks passed\n";
+   return 0;
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "obj_reader.h"
+#include "project_constants.h"
+#include <cstring>
+
+// Checks that welding the bunny gives unique vertices that reproduce its triangle soup exactly, that the reordering
+// passes of MeshOptimizer keep every triangle with its winding, only renumbering the vertices, and that the
+// post-transform cache never does worse than in the order of the OBJ file. The error of every level of detail is
+// also checked against the distance from every vertex to every triangle of the level.
+
+namespace
+{
+   int FailureNum = 0;
+
+   void check(bool condition, const std::string& message)
+   {
+      if (condition) return;
+      std::cerr << "FAILED: " << message << "\n";
+      ++FailureNum;
+   }
+
+   struct Mesh
+   {
+      std::vector<float> Vertices;
+      std::vector<uint32_t> Indices;
+      size_t FloatsPerVertex;
+
+      Mesh() : FloatsPerVertex( 0 ) {}
+
+      [[nodiscard]] size_t getVertexNum() const { return Vertices.size() / FloatsPerVertex; }
+   };
+
+   bool getTriangleSoup(std::vector<float>& soup, size_t& floats_per_vertex)
+   {
+      const std::string path = std::string(CMAKE_SOURCE_DIR) + "/samples/Bunny/bunny.obj";
+      ObjReader reader;
+      if (!reader.read( path )) {
+         check( false, "could not read " + path );
+         return false;
+      }
+
+      std::vector<glm::vec3> vertices, normals;
+      std::vector<glm::vec2> textures;
+      reader.getTriangles( vertices, normals, textures );
+      uint32_t layout_flags = 0;
+      MeshCache::interleave( soup, layout_flags, vertices, normals, textures );
+      floats_per_vertex = MeshCache::getVertexStride( layout_flags ) / sizeof( float );
+      return true;
+   }
+
+   // Every triangle as the bytes of its vertices, starting from the smallest one so that the winding is kept, and
+   // sorted, so that two meshes with the same triangles in any order and numbering give the same list.
+   std::vector<std::string> getTriangles(const Mesh& mesh)
+   {
+      const size_t vertex_size = mesh.FloatsPerVertex * sizeof( float );
+      std::vector<std::string> triangles;
+      triangles.reserve( mesh.Indices.size() / 3 );
+      for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3) {
+         std::array<std::string, 3> corners;
+         for (size_t k = 0; k < 3; ++k) {
+            corners[k].resize( vertex_size );
+            std::memcpy( &corners[k][0], &mesh.Vertices[mesh.Indices[i + k] * mesh.FloatsPerVertex], vertex_size );
+         }
+         const auto first = static_cast<size_t>(std::min_element( corners.begin(), corners.end() ) - corners.begin());
+         triangles.emplace_back( corners[first] + corners[(first + 1) % 3] + corners[(first + 2) % 3] );
+      }
+      std::sort( triangles.begin(), triangles.end() );
+      return triangles;
+   }
+
+   // Whether the welded vertices and indices give back every vertex of the soup bit for bit, and no two welded
+   // vertices are the same.
+   void checkWeld(const std::vector<float>& soup, size_t floats_per_vertex, const std::string& name)
+   {
+      Mesh mesh;
+      mesh.FloatsPerVertex = floats_per_vertex;
+      MeshOptimizer::weld( mesh.Vertices, mesh.Indices, soup, floats_per_vertex );
+      const size_t vertex_size = floats_per_vertex * sizeof( float );
+      check( mesh.Indices.size() * floats_per_vertex == soup.size(), name + ": not one index per vertex" );
+      size_t mismatch_num = 0;
+      for (size_t i = 0; i < mesh.Indices.size(); ++i) {
+         if (mesh.Indices[i] >= mesh.getVertexNum()) {
+            mismatch_num++;
+            continue;
+         }
+         const float* welded = &mesh.Vertices[mesh.Indices[i] * floats_per_vertex];
+         if (std::memcmp( welded, &soup[i * floats_per_vertex], vertex_size ) != 0) mismatch_num++;
+      }
+      check( mismatch_num == 0, name + ": " + std::to_string( mismatch_num ) + " vertices are not reproduced" );
+
+      std::vector<std::string> vertices(mesh.getVertexNum(), std::string(vertex_size, '\0'));
+      for (size_t i = 0; i < vertices.size(); ++i) {
+         std::memcpy( &vertices[i][0], &mesh.Vertices[i * floats_per_vertex], vertex_size );
+      }
+      std::sort( vertices.begin(), vertices.end() );
+      check(
+         std::adjacent_find( vertices.begin(), vertices.end() ) == vertices.end(),
+         name + ": identical vertices are not welded"
+      );
+   }
+
+   void testWeld()
+   {
+      std::vector<float> soup;
+      size_t floats_per_vertex = 0;
+      if (!getTriangleSoup( soup, floats_per_vertex )) return;
+
+      checkWeld( soup, floats_per_vertex, "bunny" );
+      std::vector<float> welded;
+      std::vector<uint32_t> indices;
+      MeshOptimizer::weld( welded, indices, soup, floats_per_vertex );
+      check( welded.size() * 3 < soup.size(), "the bunny does not share most of its vertices" );
+
+      // The comparison is bitwise, so -0 and +0 stay apart.
+      const std::vector<float> signed_zeros{ 0.0f, 1.0f, -0.0f, 1.0f, 0.0f, 1.0f, 2.0f, 3.0f, -0.0f, 1.0f };
+      checkWeld( signed_zeros, 2, "signed zeros" );
+      MeshOptimizer::weld( welded, indices, signed_zeros, 2 );
+      check( indices == std::vector<uint32_t>{ 0, 1, 0, 2, 1 }, "-0 and +0 are welded" );
+   }
+
+   // The distance to the nearest point of the plane of the triangle if it is inside, or else to the nearest edge.
+   float getDistanceToTriangle(const glm::vec3& point, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+   {
+      const auto get_distance_to_segment = [&point](const glm::vec3& p, const glm::vec3& q)
+      {
+         const glm::vec3 pq = q - p;
+         const float length2 = glm::dot( pq, pq );
+         const float t = length2 > 0.0f ? glm::clamp( glm::dot( point - p, pq ) / length2, 0.0f, 1.0f ) : 0.0f;
+         return glm::distance( point, p + t * pq );
+      };
+      const float edge_distance = std::min(
+         { get_distance_to_segment( a, b ), get_distance_to_segment( b, c ), get_distance_to_segment( c, a ) }
+      );
+      const glm::vec3 normal = glm::cross( b - a, c - a );
+      if (glm::dot( normal, normal ) == 0.0f) return edge_distance;
+
+      const glm::vec3 n = glm::normalize( normal );
+      const glm::vec3 projected = point - glm::dot( point - a, n ) * n;
+      const bool inside =
+         glm::dot( glm::cross( b - a, projected - a ), n ) >= 0.0f &&
+         glm::dot( glm::cross( c - b, projected - b ), n ) >= 0.0f &&
+         glm::dot( glm::cross( a - c, projected - c ), n ) >= 0.0f;
+      return inside ? std::min( edge_distance, std::abs( glm::dot( point - a, n ) ) ) : edge_distance;
+   }
+
+   void testSimplification()
+   {
+      std::vector<float> vertices;
+      std::vector<uint32_t> indices;
+      std::vector<MeshCache::LevelOfDetail> lods;
+      uint32_t layout_flags = 0;
+      const std::string path = std::string(CMAKE_SOURCE_DIR) + "/samples/Bunny/bunny.obj";
+      if (!MeshCache::build( vertices, indices, lods, layout_flags, path, true, true )) {
+         check( false, "could not build " + path );
+         return;
+      }
+      check( lods.size() > 3, "the bunny has only " + std::to_string( lods.size() ) + " levels of detail" );
+
+      const size_t floats_per_vertex = MeshCache::getVertexStride( layout_flags ) / sizeof( float );
+      std::vector<glm::vec3> positions(vertices.size() / floats_per_vertex);
+      for (size_t i = 0; i < positions.size(); ++i) {
+         positions[i] = glm::make_vec3( &vertices[i * floats_per_vertex] );
+      }
+      for (size_t lod = 1; lod < lods.size(); ++lod) {
+         const uint64_t begin = lods[lod].IndexOffset, end = begin + lods[lod].IndexNum;
+         float max_distance = 0.0f;
+         for (const auto& position : positions) {
+            float distance = std::numeric_limits<float>::max();
+            for (uint64_t i = begin; i < end; i += 3) {
+               distance = std::min(
+                  distance,
+                  getDistanceToTriangle(
+                     position, positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]]
+                  )
+               );
+            }
+            max_distance = std::max( max_distance, distance );
+         }
+         // The error bounds the distance of every vertex to the level, up to the rounding of the distances.
+         check(
+            lods[lod].Error >= max_distance * 0.999f,
+            "level " + std::to_string( lod ) + " has the error " + std::to_string( lods[lod].Error ) +
+               ", but a vertex is " + std::to_string( max_distance ) + " away"
+         );
+      }
+   }
+
+   void testReordering()
+   {
+      std::vector<float> soup;
+      Mesh mesh;
+      if (!getTriangleSoup( soup, mesh.FloatsPerVertex )) return;
+
+      MeshOptimizer::weld( mesh.Vertices, mesh.Indices, soup, mesh.FloatsPerVertex );
+      const std::vector<std::string> triangles = getTriangles( mesh );
+      const float original = MeshOptimizer::analyzeVertexCache( mesh.Indices, mesh.getVertexNum() ).ACMR;
+
+      MeshOptimizer::optimizeVertexCache( mesh.Indices, mesh.getVertexNum() );
+      check( getTriangles( mesh ) == triangles, "optimizeVertexCache changes the triangles" );
+      const float cache_optimized = MeshOptimizer::analyzeVertexCache( mesh.Indices, mesh.getVertexNum() ).ACMR;
+      check( cache_optimized < original, "optimizeVertexCache keeps the ACMR at " + std::to_string( original ) );
+
+      MeshOptimizer::optimizeOverdraw( mesh.Indices, mesh.Vertices, mesh.FloatsPerVertex );
+      check( getTriangles( mesh ) == triangles, "optimizeOverdraw changes the triangles" );
+      const float overdraw_optimized = MeshOptimizer::analyzeVertexCache( mesh.Indices, mesh.getVertexNum() ).ACMR;
+      // The clusters are only reordered while the ACMR stays within 1.05 times that of the cache order.
+      check(
+         overdraw_optimized <= cache_optimized * 1.05f && overdraw_optimized < original,
+         "optimizeOverdraw raises the ACMR from " + std::to_string( cache_optimized ) + " to " +
+            std::to_string( overdraw_optimized )
+      );
+
+      MeshOptimizer::optimizeVertexFetch( mesh.Vertices, mesh.Indices, mesh.FloatsPerVertex );
+      check( getTriangles( mesh ) == triangles, "optimizeVertexFetch changes the triangles" );
+      check(
+         MeshOptimizer::analyzeVertexCache( mesh.Indices, mesh.getVertexNum() ).ACMR == overdraw_optimized,
+         "optimizeVertexFetch changes the ACMR"
+      );
+      // The vertices are numbered in the order the indices first refer to them.
+      uint32_t next = 0;
+      bool ordered = true;
+      for (const auto& index : mesh.Indices) {
+         if (index > next) ordered = false;
+         if (index == next) next++;
+      }
+      check( ordered && next == mesh.getVertexNum(), "optimizeVertexFetch leaves the vertices out of order" );
+   }
+}
+
+int main()
+{
+   testWeld();
+   testReordering();
+   testSimplification();
+   if (FailureNum > 0) {
+      std::cerr << FailureNum << " checks failed\n";
+      return 1;
+   }
+   std::cout << "All checks passed\n";
+   return 0;
+}
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include "meshlet.h"
+#include <random>
+
+// Checks MeshletCuller without an OpenGL context: the eye it recovers from perspective and orthographic matrices,
+// the frustum test against the clip-space definition, and the normal-cone test against the triangles it culls and
+// against a copy of isBackFacing in draw_culling.comp, which culls the same meshlets in world space.
+
+namespace
+{
+   int FailureNum = 0;
+
+   void check(bool condition, const std::string& message)
+   {
+      if (condition) return;
+      std::cerr << "FAILED: " << message << "\n";
+      ++FailureNum;
+   }
+
+   struct Camera
+   {
+      std::string Name;
+      glm::mat4 Projection;
+      glm::mat4 View;
+      bool Orthographic;
+   };
+
+   std::vector<Camera> getCameras()
+   {
+      const glm::vec3 up(0.0f, 1.0f, 0.0f);
+      const glm::mat4 perspective = glm::perspective( glm::radians( 60.0f ), 16.0f / 9.0f, 0.1f, 100.0f );
+      const glm::mat4 orthographic = glm::ortho( -4.0f, 4.0f, -3.0f, 3.0f, 0.5f, 40.0f );
+      const glm::vec3 target(0.0f, 0.5f, 0.0f);
+      return {
+         { "perspective", perspective, glm::lookAt( glm::vec3(3.0f, 2.0f, 5.0f), target, up ), false },
+         { "perspective from below", perspective, glm::lookAt( glm::vec3(-1.0f, -6.0f, 0.5f), target, up ), false },
+         { "orthographic", orthographic, glm::lookAt( glm::vec3(-6.0f, 8.0f, 4.0f), target, up ), true },
+         { "orthographic along z", orthographic, glm::lookAt( glm::vec3(0.0f, 0.5f, 10.0f), target, up ), true }
+      };
+   }
+
+   glm::mat4 getModel()
+   {
+      glm::mat4 model = glm::translate( glm::mat4(1.0f), glm::vec3(0.3f, -0.2f, 0.4f) );
+      model = glm::rotate( model, glm::radians( 35.0f ), glm::normalize( glm::vec3(1.0f, 2.0f, -0.5f) ) );
+      return glm::scale( model, glm::vec3(1.5f) );
+   }
+
+   void testEye()
+   {
+      const glm::mat4 model = getModel();
+      const glm::mat4 to_object = glm::inverse( model );
+      for (const auto& camera : getCameras()) {
+         const MeshletCuller culler(camera.Projection * camera.View * model);
+         const glm::mat4 to_world = glm::inverse( camera.View );
+         check( culler.isOrthographic() == camera.Orthographic, camera.Name + ": wrong projection type" );
+         if (camera.Orthographic) {
+            // The camera looks down its -z axis.
+            const glm::vec4 forward(0.0f, 0.0f, -1.0f, 0.0f);
+            const glm::vec3 direction = glm::normalize( glm::vec3(to_object * to_world * forward) );
+            check( glm::dot( culler.getEye(), direction ) > 0.9999f, camera.Name + ": wrong view direction" );
+         }
+         else {
+            const glm::vec3 eye(to_object * to_world * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+            check( glm::distance( culler.getEye(), eye ) < 1e-3f, camera.Name + ": wrong eye position" );
+         }
+      }
+   }
+
+   // A box is outside exactly when all of its corners are outside the same clip plane.
+   bool isInsideClipVolume(const glm::mat4& object_to_clip, const glm::vec3& bounds_min, const glm::vec3& bounds_max)
+   {
+      std::array<glm::vec4, 8> corners;
+      for (int i = 0; i < 8; ++i) {
+         const glm::vec3 corner(
+            (i & 1) != 0 ? bounds_max.x : bounds_min.x,
+            (i & 2) != 0 ? bounds_max.y : bounds_min.y,
+            (i & 4) != 0 ? bounds_max.z : bounds_min.z
+         );
+         corners[i] = object_to_clip * glm::vec4(corner, 1.0f);
+      }
+      for (int axis = 0; axis < 3; ++axis) {
+         for (const float sign : { 1.0f, -1.0f }) {
+            bool outside = true;
+            for (const auto& corner : corners) outside = outside && corner.w + sign * corner[axis] < 0.0f;
+            if (outside) return false;
+         }
+      }
+      return true;
+   }
+
+   void testFrustum()
+   {
+      const glm::mat4 model = getModel();
+      std::mt19937 generator(7);
+      std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+      std::uniform_real_distribution<float> extent(0.01f, 4.0f);
+      for (const auto& camera : getCameras()) {
+         const glm::mat4 object_to_clip = camera.Projection * camera.View * model;
+         const MeshletCuller culler(object_to_clip);
+         const glm::vec3 target(glm::inverse( model ) * glm::vec4(0.0f, 0.5f, 0.0f, 1.0f));
+         check( culler.isInsideFrustum( target - 0.1f, target + 0.1f ), camera.Name + ": the target is culled" );
+         check( culler.isInsideFrustum( glm::vec3(-1e3f), glm::vec3(1e3f) ), camera.Name + ": the scene is culled" );
+
+         int inside_num = 0, mismatch_num = 0;
+         for (int i = 0; i < 20000; ++i) {
+            const glm::vec3 center(position( generator ), position( generator ), position( generator ));
+            const glm::vec3 half_size(extent( generator ), extent( generator ), extent( generator ));
+            const bool inside = isInsideClipVolume( object_to_clip, center - half_size, center + half_size );
+            if (inside) inside_num++;
+            if (culler.isInsideFrustum( center - half_size, center + half_size ) != inside) mismatch_num++;
+         }
+         check( inside_num > 100, camera.Name + ": too few random boxes in the frustum" );
+         // Only rounding on a plane may differ.
+         check( mismatch_num <= 2, camera.Name + ": " + std::to_string( mismatch_num ) + " boxes disagree" );
+      }
+   }
+
+   // A bumpy sphere in row order, so that consecutive triangles and therefore meshlets are close to each other.
+   void getSphere(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+   {
+      constexpr uint32_t rings = 64, segments = 128;
+      for (uint32_t r = 0; r <= rings; ++r) {
+         const float theta = glm::pi<float>() * static_cast<float>(r) / static_cast<float>(rings);
+         for (uint32_t s = 0; s <= segments; ++s) {
+            const float phi = glm::two_pi<float>() * static_cast<float>(s) / static_cast<float>(segments);
+            const float radius = 1.0f + 0.05f * std::sin( 7.0f * phi ) * std::sin( 5.0f * theta );
+            positions.emplace_back(
+               radius * std::sin( theta ) * std::cos( phi ),
+               radius * std::cos( theta ),
+               -radius * std::sin( theta ) * std::sin( phi )
+            );
+         }
+      }
+      for (uint32_t r = 0; r < rings; ++r) {
+         for (uint32_t s = 0; s < segments; ++s) {
+            const uint32_t v = r * (segments + 1) + s;
+            const uint32_t below = v + segments + 1;
+            indices.insert( indices.end(), { v, below, v + 1, v + 1, below, below + 1 } );
+         }
+      }
+   }
+
+   // isBackFacing of draw_culling.comp, with the eye and the meshlet in world space.
+   bool isBackFacingInShader(const glm::vec4& eye, const glm::vec4& sphere, const glm::vec4& cone)
+   {
+      if (cone.w >= 1.0f) return false;
+      if (eye.w == 0.0f) return glm::dot( glm::vec3(eye), glm::vec3(cone) ) > cone.w;
+
+      const glm::vec3 to_center = glm::vec3(sphere) - glm::vec3(eye);
+      return glm::dot( to_center, glm::vec3(cone) ) > cone.w * glm::length( to_center ) + sphere.w;
+   }
+
+   bool isTriangleBackFacing(const MeshletCuller& culler, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+   {
+      const glm::vec3 normal = glm::cross( p1 - p0, p2 - p0 );
+      const glm::vec3 view = culler.isOrthographic() ? culler.getEye() : p0 - culler.getEye();
+      return glm::dot( normal, view ) >= 0.0f;
+   }
+
+   void testBackFacing()
+   {
+      std::vector<glm::vec3> positions;
+      std::vector<uint32_t> indices;
+      getSphere( positions, indices );
+      std::vector<Meshlet> meshlets;
+      MeshletBuilder::build( meshlets, indices, positions );
+
+      Meshlet open;
+      open.ConeAxis = glm::vec3(0.0f, 0.0f, -1.0f);
+      const glm::mat4 model = getModel();
+      const glm::mat3 to_world_normal = glm::transpose( glm::inverse( glm::mat3(model) ) );
+      const float scale = glm::length( glm::vec3(model[0]) );
+      for (const auto& camera : getCameras()) {
+         const MeshletCuller culler(camera.Projection * camera.View * model);
+         const MeshletCuller world_culler(camera.Projection * camera.View);
+         const glm::vec4 eye(world_culler.getEye(), world_culler.isOrthographic() ? 0.0f : 1.0f);
+         check( !culler.isBackFacing( open ), camera.Name + ": a meshlet facing every direction is culled" );
+
+         size_t culled_num = 0, shader_mismatch_num = 0;
+         for (const auto& meshlet : meshlets) {
+            const bool culled = culler.isBackFacing( meshlet );
+            const glm::vec4 sphere(glm::vec3(model * glm::vec4(meshlet.Center, 1.0f)), meshlet.Radius * scale);
+            const glm::vec4 cone(glm::normalize( to_world_normal * meshlet.ConeAxis ), meshlet.ConeCutoff);
+            if (isBackFacingInShader( eye, sphere, cone ) != culled) shader_mismatch_num++;
+            if (!culled) continue;
+
+            culled_num++;
+            const uint32_t end = meshlet.IndexOffset + meshlet.IndexNum;
+            for (uint32_t i = meshlet.IndexOffset; i < end; i += 3) {
+               const glm::vec3& p0 = positions[indices[i]];
+               const glm::vec3& p1 = positions[indices[i + 1]];
+               const glm::vec3& p2 = positions[indices[i + 2]];
+               if (glm::length( glm::cross( p1 - p0, p2 - p0 ) ) <= 0.0f) continue;
+               if (!isTriangleBackFacing( culler, p0, p1, p2 )) {
+                  check( false, camera.Name + ": a culled meshlet has a front-facing triangle" );
+                  break;
+               }
+            }
+         }
+         // Both sides see about half of the sphere, and the cones only cull what is clearly turned away.
+         check( culled_num > meshlets.size() / 10, camera.Name + ": only " + std::to_string( culled_num ) + " of " +
+            std::to_string( meshlets.size() ) + " meshlets are culled" );
+         check( shader_mismatch_num <= 2, camera.Name + ": the shader test differs for " +
+            std::to_string( shader_mismatch_num ) + " meshlets" );
+      }
+   }
+}
+
+int main()
+{
+   testEye();
+   testFrustum();
+   testBackFacing();
+   if (FailureNum > 0) {
+      std::cerr << FailureNum << " checks failed\n";
+      return 1;
+   }
+   std::cout << "All checks passed\n";
+   return 0;
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "obj_reader.h"
+
+// Checks that ObjReader gives the same attributes and corners whether it parses a file on one thread or splits it
+// into chunks for several, including negative indices that point into a preceding chunk.
+
+namespace
+{
+   int FailureNum = 0;
+
+   void check(bool condition, const std::string& message)
+   {
+      if (condition) return;
+      std::cerr << "FAILED: " << message << "\n";
+      ++FailureNum;
+   }
+
+   template<typename T, typename Equal>
+   void checkElements(
+      const std::vector<T>& serial,
+      const std::vector<T>& parallel,
+      Equal equal,
+      const std::string& name
+   )
+   {
+      check(
+         serial.size() == parallel.size(),
+         name + ": " + std::to_string( serial.size() ) + " elements on one thread, " +
+            std::to_string( parallel.size() ) + " in parallel"
+      );
+      for (size_t i = 0; i < std::min( serial.size(), parallel.size() ); ++i) {
+         if (!equal( serial[i], parallel[i] )) {
+            check( false, name + ": element " + std::to_string( i ) + " differs" );
+            return;
+         }
+      }
+   }
+
+   void compareReaders(const ObjReader& serial, const ObjReader& parallel, const std::string& name)
+   {
+      const auto same_corner = [](const ObjReader::Corner& a, const ObjReader::Corner& b) {
+         return a.Vertex == b.Vertex && a.Texture == b.Texture && a.Normal == b.Normal;
+      };
+      checkElements( serial.getPositions(), parallel.getPositions(), std::equal_to<glm::vec3>(), name + " positions" );
+      checkElements( serial.getNormals(), parallel.getNormals(), std::equal_to<glm::vec3>(), name + " normals" );
+      checkElements( serial.getTextures(), parallel.getTextures(), std::equal_to<glm::vec2>(), name + " textures" );
+      checkElements( serial.getCorners(), parallel.getCorners(), same_corner, name + " corners" );
+      check( serial.hasNormals() == parallel.hasNormals(), name + ": normal flags differ" );
+      check( serial.hasTextures() == parallel.hasTextures(), name + ": texture flags differ" );
+   }
+
+   // Rows of vertices, each followed by the faces to the previous row. The faces use negative indices in every
+   // corner form, and quads that are triangulated as fans. Each row also adds a face back to the first vertices,
+   // so that some relative indices reach across every chunk before them.
+   std::string getRelativeGrid(int width, int height)
+   {
+      std::stringstream obj;
+      obj << "# relative grid\n";
+      for (int y = 0; y < height; ++y) {
+         for (int x = 0; x < width; ++x) {
+            obj << "v " << x << " " << 0.001f * static_cast<float>(x * y) << " " << y << "\n";
+            obj << "vt " << static_cast<float>(x) / static_cast<float>(width) << " "
+               << static_cast<float>(y) / static_cast<float>(height) << "\n";
+            obj << "vn 0 1 " << 0.01f * static_cast<float>(x) << "\n";
+         }
+         if (y == 0) continue;
+
+         // The current row ends at -1, so the previous row starts at -2 * width.
+         const int count = (y + 1) * width;
+         for (int x = 0; x + 1 < width; ++x) {
+            const int a = x - 2 * width, b = a + 1, c = x - width, d = c + 1;
+            switch (x % 3) {
+               case 0:
+                  obj << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " "
+                     << d << "/" << d << "/" << d << " " << b << "/" << b << "/" << b << "\n";
+                  break;
+               case 1:
+                  obj << "f " << a << "//" << a << " " << c << "//" << c << " " << b << "//" << b << "\n";
+                  obj << "f " << b << "/" << b << " " << c << "/" << c << " " << d << "/" << d << "\n";
+                  break;
+               default:
+                  obj << "f " << a << " " << c << " " << b << "\n";
+                  obj << "f " << b + count + 1 << " " << c << " " << d << "\n";
+                  break;
+            }
+         }
+         obj << "f " << -count << "/" << -count << "/" << -count << " " << 1 - count << " -1/-1/-1\n";
+      }
+      return obj.str();
+   }
+
+   void testFile(const std::string& file_path, int thread_num)
+   {
+      ObjReader serial(1), parallel(thread_num);
+      check( serial.read( file_path ), "cannot read " + file_path + " on one thread" );
+      check( parallel.read( file_path ), "cannot read " + file_path + " in parallel" );
+      compareReaders( serial, parallel, file_path );
+   }
+
+   void testRelativeGrid(int thread_num)
+   {
+      constexpr size_t width = 200;
+      constexpr size_t height = 1000;
+      const std::string obj = getRelativeGrid( width, height );
+      const char* begin = obj.data();
+      const char* end = obj.data() + obj.size();
+      ObjReader serial(1), parallel(thread_num);
+      check( serial.read( begin, end ), "cannot read the relative grid on one thread" );
+      check( parallel.read( begin, end ), "cannot read the relative grid in parallel" );
+      check( obj.size() > (static_cast<size_t>(thread_num) << 20u), "the relative grid is too small to be split" );
+      const size_t triangle_num = ((width - 1) * 2 + 1) * (height - 1);
+      check( serial.getCorners().size() == triangle_num * 3, "the relative grid has the wrong corners" );
+      compareReaders( serial, parallel, "relative grid" );
+
+      // The first corner of the last face of each row is the first vertex, whatever chunk it was parsed in.
+      const std::vector<ObjReader::Corner>& corners = parallel.getCorners();
+      check( !corners.empty() && corners[corners.size() - 3].Vertex == 0, "a relative index was rebased wrongly" );
+   }
+}
+
+int main()
+{
+   constexpr int thread_num = 8;
+   testFile( std::string(CMAKE_SOURCE_DIR) + "/samples/Bunny/bunny.obj", thread_num );
+   testRelativeGrid( thread_num );
+   if (FailureNum > 0) {
+      std::cerr << FailureNum << " checks failed\n";
+      return 1;
+   }
+   std::cout << "All checks passed\n";
+   return 0;
+}
\ No newline at end of file
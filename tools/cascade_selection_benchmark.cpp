@@ -0,0 +1,414 @@
+#include "light.h"
+#include "material.h"
+#include "shader_permutations.h"
+#include "draw_list.h"
+#include "uniform_ring.h"
+
+// Times the scene passes of the parallel-split shadow maps in the layouts that RendererGL can draw them with: one
+// pass per split against one pass that selects the split per fragment, and that selection against one pass that
+// samples a fixed layer, which costs the same but for the selection math. The scene is a floor under a field of
+// spheres, drawn offscreen at 1920x1080 with 4 splits, and the images are compared against the one of the passes
+// per split. The shadow maps are drawn once, since they are the same in every layout.
+// Usage: CascadeSelectionBenchmark [--side=N] [--segments=N] [--pcf=1|3|5] [--frames=N]
+namespace
+{
+   constexpr int FrameWidth = 1920;
+   constexpr int FrameHeight = 1080;
+   constexpr int ShadowMapSize = 1024;
+   constexpr int SplitNum = 4;
+   constexpr int MaxSplitNum = 8;
+   constexpr float NearPlane = 1.0f;
+   constexpr float FarPlane = 300.0f;
+   constexpr float BlendRange = 0.1f;
+   constexpr GLuint PassBlockBinding = 1;
+   constexpr GLuint CascadeBlockBinding = 4;
+
+   // The values of LIGHT_TYPE and CASCADE_SELECTION in the scene shader.
+   constexpr int DirectionalLight = 2;
+   enum CascadeSelection { SelectByPass = 0, SelectPerFragment, BlendPerFragment, CascadeSelectionNum };
+
+   // The std140 layouts of PassBlock and CascadeBlock, as RendererGL writes them.
+   struct PassBlockData
+   {
+      glm::mat4 ViewProjectionMatrix;
+      glm::mat4 ViewMatrix;
+      glm::mat4 LightViewProjectionMatrix;
+      int32_t ShadowLayer;
+      int32_t Padding[3];
+   };
+
+   struct CascadeBlockData
+   {
+      std::array<glm::mat4, MaxSplitNum> CascadeMatrices;
+      std::array<glm::vec4, MaxSplitNum> CropScales;
+      std::array<glm::vec4, MaxSplitNum> CropOffsets;
+      std::array<glm::vec4, MaxSplitNum / 4> SplitFarPlanes;
+      int32_t CascadeNum;
+      float NearPlane;
+      float BlendRange;
+      int32_t Padding;
+   };
+
+   struct Options
+   {
+      int Side;
+      int Segments;
+      int PcfKernelSize;
+      int FrameNum;
+
+      Options() : Side( 40 ), Segments( 8 ), PcfKernelSize( 1 ), FrameNum( 5 ) {}
+   };
+
+   bool parseOptions(Options& options, int argc, char** argv)
+   {
+      for (int i = 1; i < argc; ++i) {
+         const std::string argument(argv[i]);
+         const size_t equal = argument.find( '=' );
+         if (equal == std::string::npos) return false;
+
+         const std::string name = argument.substr( 0, equal );
+         const int value = std::stoi( argument.substr( equal + 1 ) );
+         if (name == "--side") options.Side = value;
+         else if (name == "--segments") options.Segments = value;
+         else if (name == "--pcf") options.PcfKernelSize = value;
+         else if (name == "--frames") options.FrameNum = value;
+         else return false;
+      }
+      return options.Side > 0 && options.Segments > 2 && options.PcfKernelSize % 2 == 1 && options.FrameNum > 0;
+   }
+
+   void getSphere(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, int segments)
+   {
+      const auto get_point = [segments](int i, int j)
+      {
+         const float theta = glm::pi<float>() * static_cast<float>(i) / static_cast<float>(segments);
+         const float phi = glm::two_pi<float>() * static_cast<float>(j) / static_cast<float>(segments);
+         return glm::vec3(std::sin( theta ) * std::cos( phi ), std::cos( theta ), std::sin( theta ) * std::sin( phi ));
+      };
+      for (int i = 0; i < segments; ++i) {
+         for (int j = 0; j < segments; ++j) {
+            const glm::vec3 a = get_point( i, j ), b = get_point( i + 1, j );
+            const glm::vec3 c = get_point( i + 1, j + 1 ), d = get_point( i, j + 1 );
+            for (const auto& point : { a, b, c, a, c, d }) {
+               vertices.emplace_back( point );
+               normals.emplace_back( point );
+            }
+         }
+      }
+   }
+
+   glm::mat4 getProjection(float near, float far)
+   {
+      return glm::perspective(
+         glm::radians( 60.0f ), static_cast<float>(FrameWidth) / static_cast<float>(FrameHeight), near, far
+      );
+   }
+
+   // The crop of each split fits its frustum in the light view, like RendererGL without the tight crop.
+   void getCascadeData(
+      CascadeBlockData& data,
+      const std::array<float, SplitNum + 1>& splits,
+      const glm::mat4& view,
+      const glm::mat4& light_view_projection
+   )
+   {
+      data = CascadeBlockData{};
+      data.SplitFarPlanes.fill( glm::vec4(std::numeric_limits<float>::max()) );
+      for (int i = 0; i < SplitNum; ++i) {
+         const glm::mat4 to_world = glm::inverse( getProjection( splits[i], splits[i + 1] ) * view );
+         glm::vec3 min_point(std::numeric_limits<float>::max());
+         glm::vec3 max_point(std::numeric_limits<float>::lowest());
+         for (int c = 0; c < 8; ++c) {
+            glm::vec4 point = to_world * glm::vec4(
+               (c & 1) != 0 ? 1.0f : -1.0f, (c & 2) != 0 ? 1.0f : -1.0f, (c & 4) != 0 ? 1.0f : -1.0f, 1.0f
+            );
+            point = light_view_projection * (point / point.w);
+            min_point = glm::min( min_point, glm::vec3(point) / point.w );
+            max_point = glm::max( max_point, glm::vec3(point) / point.w );
+         }
+         // Casters in front of the split still have to reach the shadow map.
+         min_point.z = -1.0f;
+
+         glm::mat4 crop(1.0f);
+         crop[0][0] = 2.0f / (max_point.x - min_point.x);
+         crop[1][1] = 2.0f / (max_point.y - min_point.y);
+         crop[2][2] = 2.0f / (max_point.z - min_point.z);
+         crop[3][0] = -0.5f * (max_point.x + min_point.x) * crop[0][0];
+         crop[3][1] = -0.5f * (max_point.y + min_point.y) * crop[1][1];
+         crop[3][2] = -0.5f * (max_point.z + min_point.z) * crop[2][2];
+         data.CascadeMatrices[i] = crop * light_view_projection;
+         data.CropScales[i] = glm::vec4(crop[0][0], crop[1][1], crop[2][2], 1.0f);
+         data.CropOffsets[i] = glm::vec4(glm::vec3(crop[3]), 0.0f);
+         data.SplitFarPlanes[i / 4][i % 4] = splits[i + 1];
+      }
+      data.CascadeNum = SplitNum;
+      data.NearPlane = splits[0];
+      data.BlendRange = BlendRange;
+   }
+
+   // Counts the pixels that differ from the reference at all and by more than 8 of 255 in a channel.
+   void compareImages(const std::string& name, const std::vector<uint8_t>& reference, const std::vector<uint8_t>& image)
+   {
+      size_t different_num = 0, far_num = 0;
+      for (size_t i = 0; i < reference.size(); i += 4) {
+         int difference = 0;
+         for (size_t k = 0; k < 3; ++k) {
+            difference = std::max( difference, std::abs( static_cast<int>(reference[i + k]) - image[i + k] ) );
+         }
+         if (difference > 0) different_num++;
+         if (difference > 8) far_num++;
+      }
+      std::cout << " - " << name << ": " << different_num << " pixels differ, " << far_num << " by more than 8/255\n";
+   }
+}
+
+int main(int argc, char** argv)
+{
+   Options options;
+   if (!parseOptions( options, argc, argv )) {
+      std::cerr << "Usage: " << argv[0] << " [--side=N] [--segments=N] [--pcf=1|3|5] [--frames=N]\n";
+      return 1;
+   }
+   if (!glfwInit()) {
+      std::cerr << "Cannot Initialize OpenGL...\n";
+      return 1;
+   }
+   glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 4 );
+   glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 6 );
+   glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
+   glfwWindowHint( GLFW_VISIBLE, GLFW_FALSE );
+   GLFWwindow* window = glfwCreateWindow( 64, 64, "Cascade Selection Benchmark", nullptr, nullptr );
+   if (window == nullptr) {
+      std::cerr << "Cannot create a window\n";
+      glfwTerminate();
+      return 1;
+   }
+   glfwMakeContextCurrent( window );
+   if (!gladLoadGLLoader( (GLADloadproc)glfwGetProcAddress )) {
+      std::cerr << "Failed to initialize GLAD\n";
+      glfwTerminate();
+      return 1;
+   }
+
+   {
+      const std::string shader_directory_path = std::string(CMAKE_SOURCE_DIR) + "/shaders";
+      const bool vertex_layer = ShaderGL::isExtensionSupported( "GL_ARB_shader_viewport_layer_array" ) ||
+         ShaderGL::isExtensionSupported( "GL_AMD_vertex_shader_layer" );
+      ShaderGL light_view_shader;
+      light_view_shader.setShader(
+         std::string(shader_directory_path + "/light_view_generator.vert").c_str(),
+         std::string(shader_directory_path + "/light_view_generator.frag").c_str(),
+         vertex_layer ? nullptr : std::string(shader_directory_path + "/light_view_generator.geom").c_str()
+      );
+      light_view_shader.setLightViewUniformLocations();
+
+      ShaderPermutationsGL scene_shaders(
+         std::vector<ShaderPermutationsGL::Define>{
+            { "USE_TEXTURE", 1 }, { "LIGHT_TYPE", 3 }, { "PCF_KERNEL_SIZE", 3 }, { "CASCADE_SELECTION", 2 }
+         },
+         [](ShaderGL* shader) { shader->setSceneUniformLocations(); }
+      );
+      ShaderGL::ShaderSources scene_sources;
+      ShaderGL::readShaderSources(
+         scene_sources,
+         std::string(shader_directory_path + "/scene_shader.vert").c_str(),
+         std::string(shader_directory_path + "/scene_shader.frag").c_str()
+      );
+      scene_shaders.setSources( std::move( scene_sources ) );
+      std::array<GLuint, CascadeSelectionNum> scene_programs{};
+      for (int selection = 0; selection < CascadeSelectionNum; ++selection) {
+         ShaderGL* shader = scene_shaders.getVariant(
+            scene_shaders.getKey( { 0, DirectionalLight, options.PcfKernelSize, selection } )
+         );
+         shader->uniform1i( Uniform::LightIndex, 0 );
+         scene_programs[selection] = shader->getShaderProgram();
+      }
+
+      GLuint depth_texture = 0, depth_fbo = 0, color_texture = 0, scene_depth_texture = 0, scene_fbo = 0;
+      glCreateTextures( GL_TEXTURE_2D_ARRAY, 1, &depth_texture );
+      glTextureStorage3D( depth_texture, 1, GL_DEPTH_COMPONENT32F, ShadowMapSize, ShadowMapSize, SplitNum );
+      glTextureParameteri( depth_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+      glTextureParameteri( depth_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+      glTextureParameteri( depth_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
+      glTextureParameteri( depth_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
+      glTextureParameteri( depth_texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE );
+      glTextureParameteri( depth_texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+      glCreateFramebuffers( 1, &depth_fbo );
+      glNamedFramebufferTexture( depth_fbo, GL_DEPTH_ATTACHMENT, depth_texture, 0 );
+
+      glCreateTextures( GL_TEXTURE_2D, 1, &color_texture );
+      glTextureStorage2D( color_texture, 1, GL_RGBA8, FrameWidth, FrameHeight );
+      glCreateTextures( GL_TEXTURE_2D, 1, &scene_depth_texture );
+      glTextureStorage2D( scene_depth_texture, 1, GL_DEPTH_COMPONENT32F, FrameWidth, FrameHeight );
+      glCreateFramebuffers( 1, &scene_fbo );
+      glNamedFramebufferTexture( scene_fbo, GL_COLOR_ATTACHMENT0, color_texture, 0 );
+      glNamedFramebufferTexture( scene_fbo, GL_DEPTH_ATTACHMENT, scene_depth_texture, 0 );
+      glEnable( GL_DEPTH_TEST );
+
+      const glm::mat4 view = glm::lookAt( glm::vec3(0.0f, 12.0f, 60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f) );
+      LightGL lights;
+      lights.addLight(
+         glm::vec4(1.0f, 1.0f, 0.0f, 0.0f), glm::vec4(0.2f, 0.2f, 0.2f, 1.0f), glm::vec4(0.8f, 0.8f, 0.8f, 1.0f)
+      );
+      lights.updateLightBuffer( view );
+      MaterialLibraryGL materials;
+      std::array<int, 3> material_indices{};
+      for (int i = 0; i < 3; ++i) {
+         const float gray = 0.6f + 0.1f * static_cast<float>(i);
+         material_indices[i] = materials.addMaterial( Material( glm::vec4(gray, gray, gray, 1.0f) ) );
+         assert( material_indices[i] >= 0 );
+      }
+
+      GeometryArenaGL arena;
+      ObjectGL field, floor;
+      std::vector<glm::vec3> vertices, normals;
+      getSphere( vertices, normals, options.Segments );
+      field.setGeometryArena( &arena );
+      field.setPositionStream( true );
+      field.setObject( GL_TRIANGLES, vertices, normals );
+      std::vector<ObjectGL::Instance> instances;
+      for (int z = 0; z < options.Side; ++z) {
+         for (int x = 0; x < options.Side; ++x) {
+            const glm::vec3 position(
+               static_cast<float>(x - options.Side / 2) * 2.5f,
+               1.0f,
+               static_cast<float>(z - options.Side / 2) * 2.5f - 40.0f
+            );
+            instances.emplace_back( glm::translate( glm::mat4(1.0f), position ), material_indices[(x + z) % 3] );
+         }
+      }
+      field.setInstances( instances );
+
+      const float half = 256.0f;
+      const std::vector<glm::vec3> floor_vertices = {
+         { -half, 0.0f, -half }, { half, 0.0f, half }, { half, 0.0f, -half },
+         { -half, 0.0f, -half }, { -half, 0.0f, half }, { half, 0.0f, half }
+      };
+      floor.setGeometryArena( &arena );
+      floor.setPositionStream( true );
+      floor.setObject( GL_TRIANGLES, floor_vertices, std::vector<glm::vec3>(6, glm::vec3(0.0f, 1.0f, 0.0f)) );
+      floor.setInstances( { ObjectGL::Instance( glm::mat4(1.0f), material_indices[1] ) } );
+
+      // The practical split scheme, halfway between the uniform and the logarithmic one.
+      std::array<float, SplitNum + 1> splits{};
+      for (int i = 0; i <= SplitNum; ++i) {
+         const float ratio = static_cast<float>(i) / static_cast<float>(SplitNum);
+         splits[i] = glm::mix(
+            NearPlane + (FarPlane - NearPlane) * ratio, NearPlane * std::pow( FarPlane / NearPlane, ratio ), 0.5f
+         );
+      }
+      const glm::mat4 light_view_projection =
+         glm::ortho( -400.0f, 400.0f, -400.0f, 400.0f, 1.0f, 1000.0f ) *
+         glm::lookAt( glm::vec3(300.0f, 300.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f) );
+      CascadeBlockData cascade_data;
+      getCascadeData( cascade_data, splits, view, light_view_projection );
+
+      UniformRingGL ring;
+      DrawListGL draws;
+      const float one = 1.0f;
+      ring.beginFrame();
+      bool fits = ring.bind( GL_UNIFORM_BUFFER, CascadeBlockBinding, &cascade_data, sizeof( CascadeBlockData ) );
+      glBindFramebuffer( GL_FRAMEBUFFER, depth_fbo );
+      glViewport( 0, 0, ShadowMapSize, ShadowMapSize );
+      glClearNamedFramebufferfv( depth_fbo, GL_DEPTH, 0, &one );
+      glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+      draws.clear();
+      for (int i = 0; i < SplitNum; ++i) {
+         for (auto* object : { &field, &floor }) {
+            const GLuint program = light_view_shader.getShaderProgram();
+            draws.addObject( program, 0, object, cascade_data.CascadeMatrices[i], false, 0, true, i );
+         }
+      }
+      fits = draws.submit( &ring ) && fits;
+      glFinish();
+      ring.endFrame();
+      glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+
+      glBindFramebuffer( GL_FRAMEBUFFER, scene_fbo );
+      glViewport( 0, 0, FrameWidth, FrameHeight );
+      glBindTextureUnit( 1, depth_texture );
+      const auto draw_pass = [&](GLuint program, const glm::mat4& projection, int layer)
+      {
+         const PassBlockData pass{ projection * view, view, light_view_projection, layer, {} };
+         fits = ring.bind( GL_UNIFORM_BUFFER, PassBlockBinding, &pass, sizeof( PassBlockData ) ) && fits;
+         draws.clear();
+         for (auto* object : { &field, &floor }) {
+            draws.addObject( program, 0, object, projection * view, false, 0, false );
+         }
+         fits = draws.submit( &ring ) && fits;
+      };
+      const auto draw_split_passes = [&]()
+      {
+         // Each split writes its own slice of the depth range, as the passes per split of RendererGL do.
+         for (int i = 0; i < SplitNum; ++i) {
+            glDepthRange(
+               (splits[i] - NearPlane) / (FarPlane - NearPlane), (splits[i + 1] - NearPlane) / (FarPlane - NearPlane)
+            );
+            draw_pass( scene_programs[SelectByPass], getProjection( splits[i], splits[i + 1] ), i );
+         }
+         glDepthRange( 0.0, 1.0 );
+      };
+      const glm::mat4 projection = getProjection( NearPlane, FarPlane );
+      const auto measure = [&](const std::string& name, const std::function<void()>& draw, std::vector<uint8_t>& image)
+      {
+         const std::array<float, 4> background = { 0.1f, 0.1f, 0.1f, 1.0f };
+         double total = 0.0;
+         // The first frame is left out, since it may still compile or upload.
+         for (int frame = 0; frame <= options.FrameNum; ++frame) {
+            ring.beginFrame();
+            fits = ring.bind( GL_UNIFORM_BUFFER, CascadeBlockBinding, &cascade_data, sizeof( cascade_data ) ) && fits;
+            glClearNamedFramebufferfv( scene_fbo, GL_DEPTH, 0, &one );
+            glClearNamedFramebufferfv( scene_fbo, GL_COLOR, 0, background.data() );
+            glFinish();
+
+            const auto start = std::chrono::steady_clock::now();
+            draw();
+            glFinish();
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            ring.endFrame();
+            if (frame > 0) total += elapsed.count();
+         }
+         image.resize( static_cast<size_t>(FrameWidth) * FrameHeight * 4 );
+         glGetTextureImage(
+            color_texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei>(image.size()), image.data()
+         );
+         std::stringstream text;
+         text << std::fixed << std::setprecision( 2 ) << " - " << std::left << std::setw( 36 ) << name << std::right
+            << std::setw( 9 ) << total / options.FrameNum << " ms\n";
+         std::cout << text.str();
+      };
+
+      std::cout << options.Side * options.Side << " spheres of " << options.Segments << " segments, PCF "
+         << options.PcfKernelSize << ", " << SplitNum << " splits, " << FrameWidth << "x" << FrameHeight << "\n";
+      std::vector<uint8_t> split_image, fixed_image, selected_image, blended_image;
+      measure( "one pass per split", draw_split_passes, split_image );
+      measure(
+         "one pass, fixed layer 0",
+         [&]() { draw_pass( scene_programs[SelectByPass], projection, 0 ); },
+         fixed_image
+      );
+      measure(
+         "one pass, split per fragment",
+         [&]() { draw_pass( scene_programs[SelectPerFragment], projection, -1 ); },
+         selected_image
+      );
+      measure(
+         "one pass, blended split per fragment",
+         [&]() { draw_pass( scene_programs[BlendPerFragment], projection, -1 ); },
+         blended_image
+      );
+      std::cout << "Against one pass per split:\n";
+      compareImages( "split per fragment", split_image, selected_image );
+      compareImages( "blended split per fragment", split_image, blended_image );
+      if (!fits) std::cerr << "The uniform ring was too small, so some draws were skipped\n";
+
+      glDeleteFramebuffers( 1, &scene_fbo );
+      glDeleteFramebuffers( 1, &depth_fbo );
+      glDeleteTextures( 1, &scene_depth_texture );
+      glDeleteTextures( 1, &color_texture );
+      glDeleteTextures( 1, &depth_texture );
+   }
+   glfwDestroyWindow( window );
+   glfwTerminate();
+   return 0;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "mesh_cache.h"
+
+// Converts OBJ files into the binary mesh format that ObjectGL maps directly into a vertex buffer.
+// Usage: MeshConverter [--no-optimize] [--no-simplify] [--compact] [--position=float|half|unorm16]
+//                      [--normal=float|oct16|snorm10] [--uv=float|half] <input.obj> [output.mesh]
+int main(int argc, char** argv)
+{
+   bool optimize = true;
+   bool simplify = true;
+   bool valid = true;
+   VertexFormat format;
+   std::vector<std::string> paths;
+   for (int i = 1; i < argc; ++i) {
+      const std::string argument(argv[i]);
+      if (argument == "--no-optimize") optimize = false;
+      else if (argument == "--no-simplify") simplify = false;
+      else if (argument == "--compact") format = VertexFormat::getCompactFormat();
+      else if (argument == "--position=float") format.Position = VertexFormat::PositionType::Float32;
+      else if (argument == "--position=half") format.Position = VertexFormat::PositionType::Float16;
+      else if (argument == "--position=unorm16") format.Position = VertexFormat::PositionType::UNorm16;
+      else if (argument == "--normal=float") format.Normal = VertexFormat::NormalType::Float32;
+      else if (argument == "--normal=oct16") format.Normal = VertexFormat::NormalType::Octahedral16;
+      else if (argument == "--normal=snorm10") format.Normal = VertexFormat::NormalType::SNorm10;
+      else if (argument == "--uv=float") format.Texture = VertexFormat::TextureType::Float32;
+      else if (argument == "--uv=half") format.Texture = VertexFormat::TextureType::Float16;
+      else if (argument.rfind( "--", 0 ) == 0) valid = false;
+      else paths.emplace_back( argument );
+   }
+   if (!valid || paths.empty() || paths.size() > 2) {
+      std::cerr << "Usage: " << argv[0] << " [--no-optimize] [--no-simplify] [--compact] [--position=float|half|unorm16]"
+         " [--normal=float|oct16|snorm10] [--uv=float|half] <input.obj> [output.mesh]\n";
+      return 1;
+   }
+
+   const std::string& obj_file_path = paths[0];
+   const std::string cache_path = paths.size() == 2 ? paths[1] : MeshCache::getCachePath( obj_file_path );
+   const auto start = std::chrono::steady_clock::now();
+   if (!MeshCache::convert( obj_file_path, cache_path, optimize, simplify, format )) {
+      std::cerr << "Could not convert " << obj_file_path << "\n";
+      return 1;
+   }
+   const auto end = std::chrono::steady_clock::now();
+
+   const MeshCache cache(cache_path);
+   const MeshCache::Header& header = cache.getHeader();
+   std::cout << "Converted " << obj_file_path << " into " << cache_path << " in "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n"
+      << " - vertices: " << header.VertexNum << " (" << header.VertexStride << " bytes each)\n"
+      << " - bounds: (" << header.BoundsMin.x << ", " << header.BoundsMin.y << ", " << header.BoundsMin.z << ") ~ ("
+      << header.BoundsMax.x << ", " << header.BoundsMax.y << ", " << header.BoundsMax.z << ")\n";
+   return 0;
+}
\ No newline at end of file
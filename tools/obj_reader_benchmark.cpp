@@ -0,0 +1,183 @@
+#include "obj_reader.h"
+
+// Times ObjReader against the std::ifstream and std::regex reader that it replaced, which is kept below as the
+// reference, and checks that both give the same triangles.
+// Usage: ObjReaderBenchmark [--threads=N] [--grid=N] [--no-reference] [input.obj ...]
+// Without inputs, it reads the bunny and a generated grid of 2 * N * N triangles, 1000 by default.
+
+namespace
+{
+   // The reader before ObjReader, as it was in ObjectGL::readObjectFile. It only takes triangles whose corners
+   // have every attribute that the file defines before the face.
+   bool readReference(
+      std::vector<glm::vec3>& vertices,
+      std::vector<glm::vec3>& normals,
+      std::vector<glm::vec2>& textures,
+      const std::string& file_path
+   )
+   {
+      std::ifstream file(file_path);
+      if (!file.is_open()) return false;
+
+      bool found_normals = false, found_textures = false;
+      std::vector<glm::vec3> vertex_buffer, normal_buffer;
+      std::vector<glm::vec2> texture_buffer;
+      std::vector<int> vertex_indices, normal_indices, texture_indices;
+      while (!file.eof()) {
+         std::string word;
+         file >> word;
+
+         if (word == "v") {
+            glm::vec3 vertex;
+            file >> vertex.x >> vertex.y >> vertex.z;
+            vertex_buffer.emplace_back( vertex );
+         }
+         else if (word == "vt") {
+            glm::vec2 uv;
+            file >> uv.x >> uv.y;
+            texture_buffer.emplace_back( uv );
+            found_textures = true;
+         }
+         else if (word == "vn") {
+            glm::vec3 normal;
+            file >> normal.x >> normal.y >> normal.z;
+            normal_buffer.emplace_back( normal );
+            found_normals = true;
+         }
+         else if (word == "f") {
+            std::string face;
+            const std::regex delimiter("[/]");
+            for (int i = 0; i < 3; ++i) {
+               file >> face;
+               const std::sregex_token_iterator it(face.begin(), face.end(), delimiter, -1);
+               const std::vector<std::string> vtn(it, std::sregex_token_iterator());
+               vertex_indices.emplace_back( std::stoi( vtn[0] ) );
+               if (found_textures) texture_indices.emplace_back( std::stoi( vtn[1] ) );
+               if (found_normals) normal_indices.emplace_back( std::stoi( vtn[2] ) );
+            }
+         }
+         else std::getline( file, word );
+      }
+
+      for (size_t i = 0; i < vertex_indices.size(); ++i) {
+         vertices.emplace_back( vertex_buffer[vertex_indices[i] - 1] );
+         if (found_normals) normals.emplace_back( normal_buffer[normal_indices[i] - 1] );
+         if (found_textures) textures.emplace_back( texture_buffer[texture_indices[i] - 1] );
+      }
+      return true;
+   }
+
+   // A height field of grid_size by grid_size quads with normals and texture coordinates, in the v/t/n form that
+   // the reference reader takes.
+   bool writeGrid(const std::string& file_path, int grid_size)
+   {
+      std::ofstream file(file_path);
+      if (!file.is_open()) return false;
+
+      const int n = grid_size + 1;
+      const float step = 1.0f / static_cast<float>(grid_size);
+      for (int y = 0; y < n; ++y) {
+         for (int x = 0; x < n; ++x) {
+            const float u = static_cast<float>(x) * step;
+            const float v = static_cast<float>(y) * step;
+            const float height =
+               0.05f * std::sin( 0.1f * static_cast<float>(x) ) * std::cos( 0.1f * static_cast<float>(y) );
+            file << "v " << u << " " << height << " " << v << "\nvn 0 1 0\nvt " << u << " " << v << "\n";
+         }
+      }
+      const auto corner = [&file](int index) { file << " " << index << "/" << index << "/" << index; };
+      for (int y = 0; y < grid_size; ++y) {
+         for (int x = 0; x < grid_size; ++x) {
+            const int a = y * n + x + 1, b = a + 1, c = a + n, d = c + 1;
+            file << "f";
+            corner( a );
+            corner( c );
+            corner( b );
+            file << "\nf";
+            corner( b );
+            corner( c );
+            corner( d );
+            file << "\n";
+         }
+      }
+      return true;
+   }
+
+   template<typename T>
+   bool isEqual(const std::vector<T>& a, const std::vector<T>& b)
+   {
+      return a.size() == b.size() && std::equal( a.begin(), a.end(), b.begin() );
+   }
+
+   double getMilliseconds(std::chrono::steady_clock::time_point start)
+   {
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+   }
+}
+
+int main(int argc, char** argv)
+{
+   int thread_num = 0;
+   int grid_size = 1000;
+   bool compare = true;
+   bool valid = true;
+   std::vector<std::string> paths;
+   for (int i = 1; i < argc; ++i) {
+      const std::string argument(argv[i]);
+      if (argument.rfind( "--threads=", 0 ) == 0) thread_num = std::atoi( argument.c_str() + 10 );
+      else if (argument.rfind( "--grid=", 0 ) == 0) grid_size = std::atoi( argument.c_str() + 7 );
+      else if (argument == "--no-reference") compare = false;
+      else if (argument.rfind( "--", 0 ) == 0) valid = false;
+      else paths.emplace_back( argument );
+   }
+   if (!valid || grid_size <= 0) {
+      std::cerr << "Usage: " << argv[0] << " [--threads=N] [--grid=N] [--no-reference] [input.obj ...]\n";
+      return 1;
+   }
+
+   std::string grid_path;
+   if (paths.empty()) {
+      paths.emplace_back( std::string(CMAKE_SOURCE_DIR) + "/samples/Bunny/bunny.obj" );
+      grid_path = (std::filesystem::temp_directory_path() / "obj_reader_benchmark_grid.obj").string();
+      if (!writeGrid( grid_path, grid_size )) {
+         std::cerr << "Could not write " << grid_path << "\n";
+         return 1;
+      }
+      paths.emplace_back( grid_path );
+   }
+
+   bool identical = true;
+   ObjReader reader(thread_num);
+   std::cout << "ObjReader with " << reader.getThreadNum() << " threads, including the de-indexing\n";
+   for (const auto& path : paths) {
+      std::vector<glm::vec3> vertices, normals;
+      std::vector<glm::vec2> textures;
+      auto start = std::chrono::steady_clock::now();
+      if (!reader.read( path )) {
+         std::cerr << "Could not read " << path << "\n";
+         identical = false;
+         continue;
+      }
+      reader.getTriangles( vertices, normals, textures );
+      const double time = getMilliseconds( start );
+
+      std::stringstream text;
+      text << std::fixed << std::setprecision( 1 ) << path << " (" << vertices.size() / 3 << " triangles):\n";
+      text << " - ObjReader: " << time << " ms\n";
+      if (compare) {
+         std::vector<glm::vec3> reference_vertices, reference_normals;
+         std::vector<glm::vec2> reference_textures;
+         start = std::chrono::steady_clock::now();
+         const bool read = readReference( reference_vertices, reference_normals, reference_textures, path );
+         const double reference_time = getMilliseconds( start );
+         const bool same = read && isEqual( vertices, reference_vertices ) && isEqual( normals, reference_normals ) &&
+            isEqual( textures, reference_textures );
+         identical &= same;
+         text << " - reference: " << reference_time << " ms (" << reference_time / time << "x), output "
+            << (same ? "identical\n" : "DIFFERENT\n");
+      }
+      std::cout << text.str();
+   }
+   if (!grid_path.empty()) std::filesystem::remove( grid_path );
+   return identical ? 0 : 1;
+}
\ No newline at end of file
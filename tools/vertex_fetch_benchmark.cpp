@@ -0,0 +1,150 @@
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+
+// Models the memory traffic of the vertex fetches in a depth pass, which reads only the positions, from the
+// interleaved vertex buffer and from the position-only stream that ObjectGL::setPositionStream keeps.
+// The indices run through a FIFO post-transform cache; every miss fetches the position of its vertex through an
+// LRU cache of 64-byte lines, and every line that misses there is counted as traffic.
+// Usage: VertexFetchBenchmark [--grid=N] [obj files...]
+namespace
+{
+   constexpr size_t LineSize = 64;
+   constexpr size_t LineCacheSize = 16 * 1024;
+
+   struct Mesh
+   {
+      std::string Name;
+      std::vector<float> Vertices;
+      std::vector<uint32_t> Indices;
+      uint32_t LayoutFlags;
+
+      Mesh() : LayoutFlags( 0 ) {}
+   };
+
+   class LineCache final
+   {
+   public:
+      explicit LineCache(size_t line_num) : Time( 0 ), Lines(line_num, { std::numeric_limits<size_t>::max(), 0 }) {}
+
+      // Returns true if the line had to be loaded.
+      bool touch(size_t line)
+      {
+         Time++;
+         size_t oldest = 0;
+         for (size_t i = 0; i < Lines.size(); ++i) {
+            if (Lines[i].first == line) {
+               Lines[i].second = Time;
+               return false;
+            }
+            if (Lines[i].second < Lines[oldest].second) oldest = i;
+         }
+         Lines[oldest] = { line, Time };
+         return true;
+      }
+
+   private:
+      size_t Time;
+      std::vector<std::pair<size_t, size_t>> Lines; // line, last used time
+   };
+
+   size_t getFetchedBytes(const std::vector<uint32_t>& indices, size_t vertex_num, size_t stride, size_t fetch_size)
+   {
+      LineCache line_cache(LineCacheSize / LineSize);
+      std::vector<size_t> pushed_time(vertex_num, 0);
+      size_t time = MeshOptimizer::VertexCacheSize + 1;
+      size_t fetched_bytes = 0;
+      for (const auto& index : indices) {
+         if (time - pushed_time[index] <= static_cast<size_t>(MeshOptimizer::VertexCacheSize)) continue;
+         pushed_time[index] = time++;
+
+         const size_t begin = index * stride;
+         for (size_t line = begin / LineSize; line <= (begin + fetch_size - 1) / LineSize; ++line) {
+            if (line_cache.touch( line )) fetched_bytes += LineSize;
+         }
+      }
+      return fetched_bytes;
+   }
+
+   // A flat grid of grid_size x grid_size vertices with normals, in the optimized order the mesh cache would store.
+   void getGrid(Mesh& mesh, uint32_t grid_size)
+   {
+      mesh.Name = std::to_string( grid_size ) + "x" + std::to_string( grid_size ) + " grid";
+      mesh.LayoutFlags = MeshCache::HasNormals;
+      mesh.Vertices.clear();
+      mesh.Indices.clear();
+      for (uint32_t j = 0; j < grid_size; ++j) {
+         for (uint32_t i = 0; i < grid_size; ++i) {
+            mesh.Vertices.insert( mesh.Vertices.end(), { static_cast<float>(i), 0.0f, static_cast<float>(j) } );
+            mesh.Vertices.insert( mesh.Vertices.end(), { 0.0f, 1.0f, 0.0f } );
+         }
+      }
+      for (uint32_t j = 0; j + 1 < grid_size; ++j) {
+         for (uint32_t i = 0; i + 1 < grid_size; ++i) {
+            const uint32_t v = j * grid_size + i;
+            const uint32_t below = v + grid_size;
+            mesh.Indices.insert( mesh.Indices.end(), { v, below, v + 1, v + 1, below, below + 1 } );
+         }
+      }
+      const size_t floats_per_vertex = MeshCache::getVertexStride( mesh.LayoutFlags ) / sizeof( float );
+      MeshOptimizer::optimizeVertexCache( mesh.Indices, mesh.Vertices.size() / floats_per_vertex );
+      MeshOptimizer::optimizeVertexFetch( mesh.Vertices, mesh.Indices, floats_per_vertex );
+   }
+
+   std::string getKilobytes(size_t bytes)
+   {
+      std::stringstream text;
+      text << std::fixed << std::setprecision( 1 ) << static_cast<double>(bytes) / 1000.0 << " KB";
+      return text.str();
+   }
+}
+
+int main(int argc, char** argv)
+{
+   uint32_t grid_size = 1000;
+   std::vector<std::string> paths;
+   for (int i = 1; i < argc; ++i) {
+      const std::string argument(argv[i]);
+      if (argument.rfind( "--grid=", 0 ) == 0) grid_size = static_cast<uint32_t>(std::stoul( argument.substr( 7 ) ));
+      else if (argument.rfind( "--", 0 ) == 0) {
+         std::cerr << "Usage: " << argv[0] << " [--grid=N] [obj files...]\n";
+         return 1;
+      }
+      else paths.emplace_back( argument );
+   }
+   if (paths.empty()) paths.emplace_back( std::string(CMAKE_SOURCE_DIR) + "/samples/Bunny/bunny.obj" );
+
+   std::vector<Mesh> meshes(paths.size());
+   for (size_t i = 0; i < paths.size(); ++i) {
+      std::vector<MeshCache::LevelOfDetail> lods;
+      Mesh& mesh = meshes[i];
+      mesh.Name = paths[i];
+      if (!MeshCache::build( mesh.Vertices, mesh.Indices, lods, mesh.LayoutFlags, paths[i], true, false )) {
+         std::cerr << "Could not read " << paths[i] << "\n";
+         return 1;
+      }
+   }
+   if (grid_size > 1) {
+      meshes.emplace_back();
+      getGrid( meshes.back(), grid_size );
+   }
+
+   std::stringstream report;
+   report << std::fixed << std::setprecision( 1 );
+   for (const auto& mesh : meshes) {
+      const bool normals_exist = (mesh.LayoutFlags & MeshCache::HasNormals) != 0;
+      const bool textures_exist = (mesh.LayoutFlags & MeshCache::HasTextures) != 0;
+      const size_t vertex_num = mesh.Vertices.size() * sizeof( float ) / MeshCache::getVertexStride( mesh.LayoutFlags );
+      report << mesh.Name << ": " << vertex_num << " vertices, " << mesh.Indices.size() / 3 << " triangles\n";
+      for (const auto& format : { VertexFormat(), VertexFormat::getCompactFormat() }) {
+         const size_t stride = format.getStride( normals_exist, textures_exist );
+         const size_t position_size = format.getPositionSize();
+         const size_t interleaved = getFetchedBytes( mesh.Indices, vertex_num, stride, position_size );
+         const size_t separate = getFetchedBytes( mesh.Indices, vertex_num, position_size, position_size );
+         report << " - " << (format.isFloat32() ? "float" : "compact") << " (" << stride << " B -> "
+            << position_size << " B): " << getKilobytes( interleaved ) << " -> " << getKilobytes( separate )
+            << " (" << 100.0 * static_cast<double>(separate) / static_cast<double>(interleaved) << "%)\n";
+      }
+   }
+   std::cout << report.str();
+   return 0;
+}
\ No newline at end of file